@@ -0,0 +1,307 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QElapsedTimer>
+
+#include "argumentscanner.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ARGUMENTSCANNER_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+QAtomicInteger<qint64> ArgumentScanner::s_scannedBytes;
+QAtomicInteger<qint64> ArgumentScanner::s_scanningNs;
+
+namespace {
+
+// Characters the scanner has to look at once it is inside of an argument: brackets, separators,
+// starts of literals and comments. Everything else can be skipped in bulk.
+inline bool isDelimiter(ushort c)
+{
+    return c == '(' || c == ')' || c == '{' || c == '}' || c == '[' || c == ']' ||
+           c == ',' || c == '"' || c == '\'' || c == '/';
+}
+
+int findDelimiterScalar(const ushort* text, int length, int i)
+{
+    while (i < length && !isDelimiter(text[i])) i++;
+    return i;
+}
+
+#ifdef ARGUMENTSCANNER_X86_SIMD
+
+// Both kernels test the same way: '(' and ')' differ only in the lowest bit, '[' and ']' only in
+// the 0x20 bit from '{' and '}', the rest is compared directly.
+
+__attribute__((target("sse2")))
+inline __m128i delimiterMask128(__m128i chars)
+{
+    const __m128i parenthesis = _mm_cmpeq_epi16(_mm_and_si128(chars, _mm_set1_epi16(short(0xfffe))), _mm_set1_epi16('('));
+    const __m128i folded = _mm_or_si128(chars, _mm_set1_epi16(0x20));
+    const __m128i brace = _mm_or_si128(_mm_cmpeq_epi16(folded, _mm_set1_epi16('{')), _mm_cmpeq_epi16(folded, _mm_set1_epi16('}')));
+    const __m128i other = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(chars, _mm_set1_epi16(',')), _mm_cmpeq_epi16(chars, _mm_set1_epi16('"'))),
+                                       _mm_or_si128(_mm_cmpeq_epi16(chars, _mm_set1_epi16('\'')), _mm_cmpeq_epi16(chars, _mm_set1_epi16('/'))));
+    return _mm_or_si128(_mm_or_si128(parenthesis, brace), other);
+}
+
+__attribute__((target("sse2")))
+int findDelimiterSse2(const ushort* text, int length, int i)
+{
+    // 16 code units per iteration, two bits of the mask per code unit
+    for (; i + 16 <= length; i += 16) {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 8));
+        const uint mask = uint(_mm_movemask_epi8(delimiterMask128(low))) | (uint(_mm_movemask_epi8(delimiterMask128(high))) << 16);
+        if (mask) return i + __builtin_ctz(mask) / 2;
+    }
+    return findDelimiterScalar(text, length, i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i delimiterMask256(__m256i chars)
+{
+    const __m256i parenthesis = _mm256_cmpeq_epi16(_mm256_and_si256(chars, _mm256_set1_epi16(short(0xfffe))), _mm256_set1_epi16('('));
+    const __m256i folded = _mm256_or_si256(chars, _mm256_set1_epi16(0x20));
+    const __m256i brace = _mm256_or_si256(_mm256_cmpeq_epi16(folded, _mm256_set1_epi16('{')), _mm256_cmpeq_epi16(folded, _mm256_set1_epi16('}')));
+    const __m256i other = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi16(chars, _mm256_set1_epi16(',')), _mm256_cmpeq_epi16(chars, _mm256_set1_epi16('"'))),
+                                          _mm256_or_si256(_mm256_cmpeq_epi16(chars, _mm256_set1_epi16('\'')), _mm256_cmpeq_epi16(chars, _mm256_set1_epi16('/'))));
+    return _mm256_or_si256(_mm256_or_si256(parenthesis, brace), other);
+}
+
+__attribute__((target("avx2")))
+int findDelimiterAvx2(const ushort* text, int length, int i)
+{
+    // 32 code units per iteration, two bits of the mask per code unit
+    for (; i + 32 <= length; i += 32) {
+        const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + 16));
+        const quint64 mask = quint64(uint(_mm256_movemask_epi8(delimiterMask256(low)))) | (quint64(uint(_mm256_movemask_epi8(delimiterMask256(high)))) << 32);
+        if (mask) return i + __builtin_ctzll(mask) / 2;
+    }
+    return findDelimiterSse2(text, length, i);
+}
+
+#endif
+
+typedef int (*FindDelimiterFunction)(const ushort* text, int length, int i);
+
+struct FindDelimiterImplementation {
+    FindDelimiterFunction function;
+    const char* name;
+};
+
+// Fastest first
+QVector<FindDelimiterImplementation> supportedFindDelimiters()
+{
+    QVector<FindDelimiterImplementation> implementations;
+#ifdef ARGUMENTSCANNER_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) implementations.append({ findDelimiterAvx2, "avx2" });
+    if (__builtin_cpu_supports("sse2")) implementations.append({ findDelimiterSse2, "sse2" });
+#endif
+    implementations.append({ findDelimiterScalar, "scalar" });
+    return implementations;
+}
+
+FindDelimiterImplementation& findDelimiterImplementation()
+{
+    static FindDelimiterImplementation implementation = supportedFindDelimiters().first();
+    return implementation;
+}
+
+// Returns the offset of the first delimiter at or after i, or length if there is none
+int findDelimiter(const ushort* text, int length, int i)
+{
+    return findDelimiterImplementation().function(text, length, i);
+}
+
+// Skips whitespace and comments starting at i, returns the offset of the next other character
+int skipSpaceAndComments(const QChar* text, int length, int i)
+{
+    while (i < length) {
+        if (text[i].isSpace()) {
+            i++;
+        } else if (text[i] == '/' && i + 1 < length && text[i + 1] == '/') {
+            i += 2;
+            while (i < length && text[i] != '\n') i++;
+        } else if (text[i] == '/' && i + 1 < length && text[i + 1] == '*') {
+            i += 2;
+            while (i < length && !(text[i] == '*' && i + 1 < length && text[i + 1] == '/')) i++;
+            i += 2;
+        } else {
+            break;
+        }
+    }
+    return qMin(i, length);
+}
+
+// Whether the quote at i is a digit separator (1'000'000) rather than a start of character literal
+bool isDigitSeparator(const QChar* text, int i)
+{
+    int start = i;
+    while (start > 0 && (text[start - 1].isLetterOrNumber() || text[start - 1] == '_')) {
+        start--;
+    }
+    return start < i && text[start].isDigit();
+}
+
+// Whether the quote at i starts a raw string literal, R"delimiter(...)delimiter"
+bool isRawString(const QChar* text, int i)
+{
+    if (i == 0 || text[i - 1] != 'R') return false;
+
+    // Must not be just an identifier ending with R, only the encoding prefixes may precede it
+    int start = i - 1;
+    while (start > 0 && (text[start - 1].isLetterOrNumber() || text[start - 1] == '_')) {
+        start--;
+    }
+    const QString prefix = QString(text + start, i - 1 - start);
+    return prefix.isEmpty() || prefix == QLatin1String("u8") || prefix == QLatin1String("u") ||
+           prefix == QLatin1String("U") || prefix == QLatin1String("L");
+}
+
+// Skips the literal starting with the quote at i, returns the offset after it
+int skipLiteral(const QChar* text, int length, int i)
+{
+    const QChar quote = text[i];
+
+    if (quote == '"' && isRawString(text, i)) {
+        int delimiterEnd = i + 1;
+        while (delimiterEnd < length && text[delimiterEnd] != '(' && delimiterEnd - i <= 16) delimiterEnd++;
+        if (delimiterEnd >= length || text[delimiterEnd] != '(') return i + 1; // Malformed, treat the quote as ordinary character
+
+        const QString terminator = QLatin1Char(')') + QString(text + i + 1, delimiterEnd - i - 1) + QLatin1Char('"');
+        const int end = QString::fromRawData(text, length).indexOf(terminator, delimiterEnd + 1);
+        return (end < 0) ? length : end + terminator.size();
+    }
+
+    // Ordinary literals can not span lines, stop at the end of the line if the literal is not terminated
+    for (i++; i < length; i++) {
+        if (text[i] == '\\') {
+            i++;
+        } else if (text[i] == quote) {
+            return i + 1;
+        } else if (text[i] == '\n') {
+            return i;
+        }
+    }
+    return length;
+}
+
+}
+
+
+ArgumentScanner::Result ArgumentScanner::scan(const QString& input, int maxArguments)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Result result;
+
+    const QChar* text = input.constData();
+    const int length = input.size();
+
+    int i = skipSpaceAndComments(text, length, 0);
+    if (i < length && text[i] == '(') {
+        // Otherwise the use was not a function call (e.g. taking address of the function, nevermind)
+        result.isCall = true;
+
+        int depth = 0;
+        bool argumentPending = true;
+        for (i++; i < length && result.argumentStarts.size() < maxArguments; ) {
+            // Inside of an argument only the delimiters matter, the rest is skipped in bulk
+            if (argumentPending) {
+                i = skipSpaceAndComments(text, length, i);
+            } else {
+                i = ::findDelimiter(reinterpret_cast<const ushort*>(text), length, i);
+            }
+            if (i >= length) break;
+
+            const QChar c = text[i];
+            if ((c == ')' || c == '}' || c == ']') && depth == 0) {
+                if (c == ')') result.closingParenthesis = i;
+                break;
+            }
+
+            if (argumentPending) {
+                result.argumentStarts.append(i);
+                argumentPending = false;
+            }
+
+            if (c == '/') {
+                // Comment or division
+                const int next = skipSpaceAndComments(text, length, i);
+                i = (next > i) ? next : i + 1;
+                continue;
+            } else if (c == '(' || c == '{' || c == '[') {
+                depth++;
+            } else if (c == ')' || c == '}' || c == ']') {
+                depth--;
+            } else if (c == ',' && depth == 0) {
+                argumentPending = true;
+            } else if (c == '"' || (c == '\'' && !isDigitSeparator(text, i))) {
+                i = skipLiteral(text, length, i);
+                continue;
+            }
+            i++;
+        }
+    }
+
+    s_scannedBytes.fetchAndAddRelaxed(qint64(qMin(i, length)) * sizeof(QChar));
+    s_scanningNs.fetchAndAddRelaxed(timer.nsecsElapsed());
+
+    return result;
+}
+
+QString ArgumentScanner::throughput()
+{
+    const qint64 bytes = s_scannedBytes.load();
+    const qint64 ns = s_scanningNs.load();
+    const double megabytesPerSecond = ns ? (bytes * 1000.0) / ns : 0.0;
+
+    return QStringLiteral("%1 kB in %2 ms, %3 MB/s (%4)").arg(bytes / 1024).arg(ns / 1000000).arg(megabytesPerSecond, 0, 'f', 1)
+                                                          .arg(QLatin1String(findDelimiterImplementation().name));
+}
+
+QStringList ArgumentScanner::implementations()
+{
+    QStringList names;
+    for (const auto &implementation : supportedFindDelimiters()) {
+        names.append(QLatin1String(implementation.name));
+    }
+    return names;
+}
+
+bool ArgumentScanner::setImplementation(const QString& name)
+{
+    for (const auto &implementation : supportedFindDelimiters()) {
+        if (name == QLatin1String(implementation.name)) {
+            findDelimiterImplementation() = implementation;
+            return true;
+        }
+    }
+    return false;
+}
+
+int ArgumentScanner::findDelimiter(const ushort* text, int length, int from)
+{
+    return ::findDelimiter(text, length, from);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef ARGUMENTSCANNER_H
+#define ARGUMENTSCANNER_H
+
+#include <QAtomicInteger>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+
+/**
+ * Finds the arguments of a function call in the text that follows the use
+ * of the function.
+ *
+ * Only brackets are matched, so it is fooled by things like comparisons
+ * that look like template arguments, but it skips string and character
+ * literals (including raw strings) and comments, and never reads past the
+ * end of the text, so any input is safe.
+ *
+ * Depends only on Qt Core, so it can be exercised on arbitrary text outside
+ * of KDevelop, see argumentscannerbenchmark and argumentscannerfuzzer.
+ *
+ * The text inside of the arguments is skipped 16 or 32 characters at a time
+ * using SSE2 or AVX2, whichever the CPU supports.
+ */
+class ArgumentScanner
+{
+public:
+    struct Result {
+        bool isCall = false;             // The use is followed by an opening parenthesis
+        QVector<int> argumentStarts;     // Offsets of the first character of every argument
+        int closingParenthesis = -1;     // Offset of the parenthesis closing the call, -1 if it was not reached
+    };
+
+    /**
+     * Scan the text, stops after finding maxArguments arguments.
+     */
+    static Result scan(const QString& text, int maxArguments);
+
+    /**
+     * Amount of text scanned, the average throughput so far and the
+     * instruction set used, for debug output.
+     */
+    static QString throughput();
+
+    /**
+     * Names of the implementations of the delimiter search the CPU
+     * supports, the fastest one, which is used by default, first.
+     */
+    static QStringList implementations();
+
+    /**
+     * Use the named implementation from now on, for the benchmarks and
+     * tests. Not thread safe, must not be called while scanning.
+     *
+     * \return false if the CPU does not support it
+     */
+    static bool setImplementation(const QString& name);
+
+    /**
+     * Offset of the first character at or after from that the scanner has
+     * to look at inside of an argument, length if there is none.
+     */
+    static int findDelimiter(const ushort* text, int length, int from);
+
+private:
+    static QAtomicInteger<qint64> s_scannedBytes;
+    static QAtomicInteger<qint64> s_scanningNs;
+};
+
+#endif // ARGUMENTSCANNER_H
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <random>
+
+#include <QTest>
+
+#include "argumentcorpus.h"
+#include "argumentscanner.h"
+
+
+class ArgumentScannerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanup();
+
+    void testScan_data();
+    void testScan();
+    void testMaxArguments();
+    void testCorpus_data();
+    void testCorpus();
+    void testFindDelimiter_data();
+    void testFindDelimiter();
+};
+
+void ArgumentScannerTest::cleanup()
+{
+    ArgumentScanner::setImplementation(ArgumentScanner::implementations().first());
+}
+
+void ArgumentScannerTest::testScan_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("isCall");
+    QTest::addColumn<QVector<int>>("argumentStarts");
+    QTest::addColumn<int>("closingParenthesis");
+
+    QTest::newRow("no call") << QStringLiteral(";") << false << QVector<int>() << -1;
+    QTest::newRow("address") << QStringLiteral(" + 1") << false << QVector<int>() << -1;
+    QTest::newRow("empty") << QStringLiteral("()") << true << QVector<int>() << 1;
+    QTest::newRow("space before call") << QStringLiteral(" /* c */ (a)") << true << QVector<int>{ 10 } << 11;
+    QTest::newRow("arguments") << QStringLiteral("(a, b,  c)") << true << QVector<int>{ 1, 4, 8 } << 9;
+    QTest::newRow("nested") << QStringLiteral("(f(a, b), {c, d}, e[1, 2])") << true << QVector<int>{ 1, 10, 18 } << 25;
+    QTest::newRow("string") << QStringLiteral("(\"a, ) \\\" b\", c)") << true << QVector<int>{ 1, 14 } << 15;
+    QTest::newRow("character") << QStringLiteral("(',', ')', '\\'')") << true << QVector<int>{ 1, 6, 11 } << 15;
+    QTest::newRow("digit separator") << QStringLiteral("(1'000, 2)") << true << QVector<int>{ 1, 8 } << 9;
+    QTest::newRow("raw string") << QStringLiteral("(R\"x(a, )\" b)x\", c)") << true << QVector<int>{ 1, 17 } << 18;
+    QTest::newRow("identifier ending with R") << QStringLiteral("(FOOR\"a\", b)") << true << QVector<int>{ 1, 10 } << 11;
+    QTest::newRow("comments") << QStringLiteral("(a /* , ) */, // , )\n b)") << true << QVector<int>{ 1, 22 } << 23;
+    QTest::newRow("division") << QStringLiteral("(a / b, c)") << true << QVector<int>{ 1, 8 } << 9;
+    QTest::newRow("unterminated") << QStringLiteral("(a, \"b") << true << QVector<int>{ 1, 4 } << -1;
+    QTest::newRow("unterminated comment") << QStringLiteral("(a /* b") << true << QVector<int>{ 1 } << -1;
+    QTest::newRow("mismatched bracket") << QStringLiteral("(a, b]") << true << QVector<int>{ 1, 4 } << -1;
+}
+
+void ArgumentScannerTest::testScan()
+{
+    QFETCH(QString, text);
+    QFETCH(bool, isCall);
+    QFETCH(QVector<int>, argumentStarts);
+    QFETCH(int, closingParenthesis);
+
+    const ArgumentScanner::Result result = ArgumentScanner::scan(text, 10);
+    QCOMPARE(result.isCall, isCall);
+    QCOMPARE(result.argumentStarts, argumentStarts);
+    QCOMPARE(result.closingParenthesis, closingParenthesis);
+}
+
+void ArgumentScannerTest::testMaxArguments()
+{
+    const ArgumentScanner::Result result = ArgumentScanner::scan(QStringLiteral("(a, b, c)"), 2);
+    QVERIFY(result.isCall);
+    QCOMPARE(result.argumentStarts, (QVector<int>{ 1, 4 }));
+    QCOMPARE(result.closingParenthesis, -1);
+}
+
+void ArgumentScannerTest::testCorpus_data()
+{
+    QTest::addColumn<QString>("implementation");
+
+    for (const QString& implementation : ArgumentScanner::implementations()) {
+        QTest::newRow(qPrintable(implementation)) << implementation;
+    }
+}
+
+void ArgumentScannerTest::testCorpus()
+{
+    QFETCH(QString, implementation);
+    QVERIFY(ArgumentScanner::setImplementation(implementation));
+
+    for (const auto &sample : ArgumentCorpus::generate(2000, 1)) {
+        const ArgumentScanner::Result result = ArgumentScanner::scan(sample.text, sample.argumentStarts.size() + 1);
+        QVERIFY2(result.isCall, qPrintable(sample.text));
+        QVERIFY2(result.argumentStarts == sample.argumentStarts, qPrintable(sample.text));
+        QCOMPARE(result.closingParenthesis, sample.closingParenthesis);
+    }
+}
+
+void ArgumentScannerTest::testFindDelimiter_data()
+{
+    QTest::addColumn<QString>("implementation");
+    QTest::addColumn<int>("delimiterPercent");
+
+    for (const QString& implementation : ArgumentScanner::implementations()) {
+        if (implementation == QLatin1String("scalar")) continue;
+
+        for (int delimiterPercent : { 50, 5, 0 }) {
+            QTest::newRow(qPrintable(QStringLiteral("%1, %2% delimiters").arg(implementation).arg(delimiterPercent)))
+                << implementation << delimiterPercent;
+        }
+    }
+}
+
+void ArgumentScannerTest::testFindDelimiter()
+{
+    QFETCH(QString, implementation);
+    QFETCH(int, delimiterPercent);
+
+    // Longer than the vectors by enough to start at every alignment and end at every tail length
+    const int maxOffset = 32;
+    const int maxLength = 100;
+
+    const ushort delimiters[] = { '(', ')', '{', '}', '[', ']', ',', '"', '\'', '/' };
+    // Differ from the delimiters in the bits the vectorized search folds or in the high byte
+    const ushort lookalikes[] = { '&', '*', '.', ';', '\\', '^', '|', 0x0128, 0x0129, 0x015D, 0x017B, 0x2C2F, 0x8028, 0xFF22 };
+
+    std::mt19937 random(delimiterPercent);
+    for (int round = 0; round < 8; round++) {
+        QVector<ushort> text(maxOffset + maxLength);
+        for (ushort &c : text) {
+            const int kind = std::uniform_int_distribution<int>(0, 99)(random);
+            if (kind < delimiterPercent) {
+                c = delimiters[random() % (sizeof(delimiters) / sizeof(delimiters[0]))];
+            } else if (kind < delimiterPercent + 20) {
+                c = lookalikes[random() % (sizeof(lookalikes) / sizeof(lookalikes[0]))];
+            } else {
+                c = 'a' + random() % 26;
+            }
+        }
+
+        // Every search with the scalar implementation first, then the same ones with the tested one
+        QVector<int> expected;
+        QVERIFY(ArgumentScanner::setImplementation(QStringLiteral("scalar")));
+        for (int offset = 0; offset < maxOffset; offset++) {
+            for (int length = 0; length <= maxLength; length++) {
+                for (int from = 0; from <= length; from++) {
+                    expected.append(ArgumentScanner::findDelimiter(text.constData() + offset, length, from));
+                }
+            }
+        }
+
+        int search = 0;
+        QVERIFY(ArgumentScanner::setImplementation(implementation));
+        for (int offset = 0; offset < maxOffset; offset++) {
+            for (int length = 0; length <= maxLength; length++) {
+                for (int from = 0; from <= length; from++) {
+                    const int actual = ArgumentScanner::findDelimiter(text.constData() + offset, length, from);
+                    if (actual != expected[search++]) {
+                        QFAIL(qPrintable(QStringLiteral("Found %1 instead of %2 at offset %3, length %4, from %5")
+                                         .arg(actual).arg(expected[search - 1]).arg(offset).arg(length).arg(from)));
+                    }
+                }
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(ArgumentScannerTest)
+
+#include "argumentscannertest.moc"
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QTest>
+
+#include "notescanner.h"
+#include "textsource.h"
+
+
+class NoteScannerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testArgumentNamesAndCopies_data();
+    void testArgumentNamesAndCopies();
+};
+
+namespace {
+
+// Readable in the failure output, and easy to write down in the rows
+QStringList describe(const QVector<ScannedNote>& notes)
+{
+    QStringList descriptions;
+    for (const ScannedNote &note : notes) {
+        QString kind;
+        switch (note.kind) {
+        case ScannedNote::ArgumentName: kind = QStringLiteral("name"); break;
+        case ScannedNote::ArgumentCopy: kind = QStringLiteral("copy"); break;
+        default: kind = QString::number(note.kind); break;
+        }
+        descriptions.append(QStringLiteral("%1 %2:%3 %4").arg(kind).arg(note.position.line()).arg(note.position.column()).arg(note.text));
+    }
+    return descriptions;
+}
+
+}
+
+void NoteScannerTest::testArgumentNamesAndCopies_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QStringList>("argumentNames");
+    QTest::addColumn<QStringList>("argumentCopies");
+    QTest::addColumn<QStringList>("expected");
+
+    QTest::newRow("one line") << QStringLiteral("f(a, b, c);\n")
+                              << QStringList{ QStringLiteral("x"), QStringLiteral("y"), QStringLiteral("z") }
+                              << QStringList{ QStringLiteral("copy 1"), QString(), QStringLiteral("copy 3") }
+                              << QStringList{ QStringLiteral("name 0:2 x"), QStringLiteral("copy 0:2 copy 1"),
+                                              QStringLiteral("name 0:5 y"),
+                                              QStringLiteral("name 0:8 z"), QStringLiteral("copy 0:8 copy 3") };
+    QTest::newRow("lines") << QStringLiteral("f(a,\n  b,\n  c);\n")
+                           << QStringList{ QStringLiteral("x"), QStringLiteral("y"), QStringLiteral("z") }
+                           << QStringList{ QStringLiteral("copy 1"), QStringLiteral("copy 2"), QStringLiteral("copy 3") }
+                           << QStringList{ QStringLiteral("name 0:2 x"), QStringLiteral("copy 0:2 copy 1"),
+                                           QStringLiteral("name 1:2 y"), QStringLiteral("copy 1:2 copy 2"),
+                                           QStringLiteral("name 2:2 z"), QStringLiteral("copy 2:2 copy 3") };
+    QTest::newRow("unnamed") << QStringLiteral("f(a, b);\n")
+                             << QStringList{ QString(), QStringLiteral("y") }
+                             << QStringList{ QStringLiteral("copy 1"), QStringLiteral("copy 2") }
+                             << QStringList{ QStringLiteral("copy 0:2 copy 1"),
+                                             QStringLiteral("name 0:5 y"), QStringLiteral("copy 0:5 copy 2") };
+}
+
+void NoteScannerTest::testArgumentNamesAndCopies()
+{
+    QFETCH(QString, text);
+    QFETCH(QStringList, argumentNames);
+    QFETCH(QStringList, argumentCopies);
+    QFETCH(QStringList, expected);
+
+    FileTextSource source;
+    source.setText(text);
+
+    CallSiteRecord record;
+    record.start = KTextEditor::Cursor(0, 0);
+    record.position = KTextEditor::Cursor(0, 1);
+    record.argumentNames = argumentNames;
+    record.argumentCopies = argumentCopies;
+
+    NoteScanner scanner(source, true, false);
+    scanner.setRecords({}, { record });
+
+    QVector<ScannedNote> notes;
+    while (!scanner.atEnd()) {
+        scanner.scanNext(notes);
+    }
+    QCOMPARE(describe(notes), expected);
+}
+
+QTEST_GUILESS_MAIN(NoteScannerTest)
+
+#include "notescannertest.moc"
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "argumentcorpus.h"
+
+#include <random>
+
+
+namespace ArgumentCorpus {
+
+namespace {
+
+// Outside of Latin-1, but the low byte is one of the delimiters
+const ushort LOOKALIKES[] = { 0x0122, 0x0127, 0x0128, 0x0129, 0x012C, 0x012F, 0x015B, 0x015D, 0x017B, 0x017D };
+
+const char* const NAMES[] = { "value", "m_items", "size", "std::move", "qMax", "other", "x", "i" };
+const char* const OPERATORS[] = { "+", "-", "*", "/", "%", "<", ">", "==", "&&", "<<" };
+
+// Neither contains the closing sequence of the comments or literals they end up in
+const char* const COMMENTS[] = { "/* ( */", "/*, ) ] } */", "/**/", "/* \"' */", "// , )\n", "//\n" };
+const char* const CHARACTERS[] = { "'('", "')'", "','", "'\\''", "'\"'", "'\\\\'", "'/'", "'a'" };
+const char* const STRING_PIECES[] = { "text", ", ", ")", "(", "]", "}", "'", "\\\"", "\\\\", "/*", "//", " " };
+const char* const RAW_STRING_PIECES[] = { "(", ")", "\"", ", ", ")\"", "\\", "abc", "\n" };
+
+class Generator
+{
+public:
+    Generator(quint32 seed, int maxLength)
+        : m_random(seed)
+        , m_maxLength(maxLength)
+    {
+    }
+
+    Sample sample()
+    {
+        Sample sample;
+        m_text.clear();
+
+        if (pick(4) == 0) separator();
+        append("(");
+
+        const int arguments = pick(6);
+        for (int i = 0; i < arguments; i++) {
+            if (i > 0) append(",");
+            if (i > 0 || pick(4) == 0) separator();
+            sample.argumentStarts.append(m_text.size());
+            expression(0);
+            if (pick(6) == 0) separator();
+        }
+
+        sample.closingParenthesis = m_text.size();
+        append((pick(2) == 0) ? ");\n    return other(1, 2);\n" : ") + x[i]; }\n");
+
+        sample.text = m_text;
+        return sample;
+    }
+
+private:
+    template<typename T, int N>
+    const T& pick(const T (&values)[N])
+    {
+        return values[pick(N)];
+    }
+
+    int pick(int n)
+    {
+        return std::uniform_int_distribution<int>(0, n - 1)(m_random);
+    }
+
+    void append(const char* text)
+    {
+        m_text += QLatin1String(text);
+    }
+
+    bool full() const
+    {
+        return m_text.size() >= m_maxLength;
+    }
+
+    // Whitespace or comment between arguments
+    void separator()
+    {
+        switch (pick(4)) {
+            case 0: append(" "); break;
+            case 1: append("\n        "); break;
+            case 2: append(" "); append(pick(COMMENTS)); append(" "); break;
+            default: append("\t "); break;
+        }
+    }
+
+    void expression(int depth)
+    {
+        operand(depth);
+        while (!full() && pick(3) == 0) {
+            append(" ");
+            if (pick(5) == 0) {
+                append(pick(COMMENTS));
+                append(" ");
+            }
+            append(pick(OPERATORS));
+            append(" ");
+            operand(depth);
+        }
+    }
+
+    void list(int depth)
+    {
+        const int count = pick(4);
+        for (int i = 0; i < count; i++) {
+            if (i > 0) append(", ");
+            expression(depth);
+        }
+    }
+
+    void operand(int depth)
+    {
+        const bool leaf = depth >= 3 || full();
+        switch (pick(leaf ? 6 : 12)) {
+            case 0: identifier(); break;
+            case 1: number(); break;
+            case 2: stringLiteral(); break;
+            case 3: append(pick(CHARACTERS)); break;
+            case 4: rawString(); break;
+            case 5: lookalikeIdentifier(); break;
+            case 6:
+                identifier();
+                if (pick(3) == 0) append("<int>");
+                append("(");
+                list(depth + 1);
+                append(")");
+                break;
+            case 7:
+                append("{");
+                list(depth + 1);
+                append("}");
+                break;
+            case 8:
+                identifier();
+                append("[");
+                expression(depth + 1);
+                append("]");
+                break;
+            case 9:
+                append("[&](int a, int b) { return ");
+                expression(depth + 1);
+                append("; }");
+                break;
+            case 10:
+                append("static_cast<long>(");
+                expression(depth + 1);
+                append(")");
+                break;
+            default:
+                // Long stretch without any delimiter
+                for (int i = pick(8) + 1; i > 0; i--) {
+                    identifier();
+                    append((pick(2) == 0) ? "->" : ".");
+                }
+                identifier();
+                break;
+        }
+    }
+
+    void identifier()
+    {
+        append(pick(NAMES));
+    }
+
+    void lookalikeIdentifier()
+    {
+        append("name");
+        for (int i = pick(4) + 1; i > 0; i--) {
+            m_text += QChar(pick(LOOKALIKES));
+        }
+    }
+
+    void number()
+    {
+        switch (pick(4)) {
+            case 0: append("42"); break;
+            case 1: append("1'000'000"); break;
+            case 2: append("0x7f'ff"); break;
+            default: append("3.14f"); break;
+        }
+    }
+
+    void stringLiteral()
+    {
+        if (pick(4) == 0) append("u8");
+        append("\"");
+        for (int i = pick(24); i > 0; i--) {
+            if (pick(8) == 0) {
+                m_text += QChar(pick(LOOKALIKES));
+            } else {
+                append(pick(STRING_PIECES));
+            }
+        }
+        append("\"");
+    }
+
+    void rawString()
+    {
+        // The pieces contain no 'd', so they can not terminate the literal
+        const char* delimiter = "ddd" + pick(3);
+        append("R\"");
+        append(delimiter);
+        append("(");
+        for (int i = pick(8); i > 0; i--) {
+            append(pick(RAW_STRING_PIECES));
+        }
+        append(")");
+        append(delimiter);
+        append("\"");
+    }
+
+    std::mt19937 m_random;
+    const int m_maxLength;
+    QString m_text;
+};
+
+}
+
+QVector<Sample> generate(int count, quint32 seed, int maxLength)
+{
+    Generator generator(seed, maxLength);
+
+    QVector<Sample> samples;
+    samples.reserve(count);
+    for (int i = 0; i < count; i++) {
+        samples.append(generator.sample());
+    }
+    return samples;
+}
+
+}
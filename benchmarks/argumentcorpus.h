@@ -0,0 +1,55 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef ARGUMENTCORPUS_H
+#define ARGUMENTCORPUS_H
+
+#include <QString>
+#include <QVector>
+
+
+/**
+ * Generates synthetic text following uses of functions, for exercising
+ * ArgumentScanner without real sources.
+ *
+ * The arguments mix identifiers, numbers with digit separators, string,
+ * character and raw string literals, comments, nested calls, lambdas and
+ * characters outside of Latin-1 whose low byte looks like a delimiter, each
+ * of them possibly hiding brackets and commas. Because the text is built
+ * piece by piece, the expected result of the scan is known.
+ */
+namespace ArgumentCorpus {
+
+struct Sample {
+    QString text;                    // Text following the name of the function, starting with the call
+    QVector<int> argumentStarts;     // Offsets ArgumentScanner should find
+    int closingParenthesis = -1;
+};
+
+/**
+ * Generate count samples, the same ones for the same seed.
+ *
+ * \param maxLength approximate limit of the length of one sample, longer arguments give the
+ *                  vectorized delimiter search more to skip
+ */
+QVector<Sample> generate(int count, quint32 seed, int maxLength = 400);
+
+}
+
+#endif // ARGUMENTCORPUS_H
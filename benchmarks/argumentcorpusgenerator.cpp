@@ -0,0 +1,68 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+
+#include "argumentcorpus.h"
+
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("argumentcorpusgenerator"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Writes synthetic call sites as UTF-16 files, the seed corpus of argumentscannerfuzzer"));
+    parser.addHelpOption();
+    parser.addOption({ QStringLiteral("samples"), QStringLiteral("Number of call sites to generate"), QStringLiteral("count"), QStringLiteral("1000") });
+    parser.addOption({ QStringLiteral("length"), QStringLiteral("Approximate maximum length of one call site"), QStringLiteral("characters"), QStringLiteral("400") });
+    parser.addOption({ QStringLiteral("seed"), QStringLiteral("Seed of the generator"), QStringLiteral("number"), QStringLiteral("1") });
+    parser.addPositionalArgument(QStringLiteral("directory"), QStringLiteral("Directory to write the files into"));
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+
+    const QDir directory(parser.positionalArguments().first());
+    if (!directory.mkpath(QStringLiteral("."))) {
+        fprintf(stderr, "Failed to create %s\n", directory.path().toLocal8Bit().constData());
+        return 1;
+    }
+
+    const QVector<ArgumentCorpus::Sample> samples = ArgumentCorpus::generate(parser.value(QStringLiteral("samples")).toInt(),
+                                                                             parser.value(QStringLiteral("seed")).toUInt(),
+                                                                             parser.value(QStringLiteral("length")).toInt());
+    for (int i = 0; i < samples.size(); i++) {
+        QFile file(directory.filePath(QStringLiteral("sample-%1").arg(i)));
+        if (!file.open(QIODevice::WriteOnly)) {
+            fprintf(stderr, "%s\n", file.errorString().toLocal8Bit().constData());
+            return 1;
+        }
+        // In the byte order of the machine, the fuzzer reads it back the same way
+        file.write(reinterpret_cast<const char*>(samples[i].text.utf16()), samples[i].text.size() * sizeof(QChar));
+    }
+
+    return 0;
+}
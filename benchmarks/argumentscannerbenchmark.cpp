@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include "argumentcorpus.h"
+#include "argumentscanner.h"
+
+
+namespace {
+
+// Long enough to make the timer resolution and the warm up irrelevant
+constexpr qint64 MIN_DURATION_NS = 1000000000;
+
+// Returns the number of samples whose scan does not match the expectation
+int verify(const QVector<ArgumentCorpus::Sample>& samples)
+{
+    int mismatches = 0;
+    for (const auto &sample : samples) {
+        const ArgumentScanner::Result result = ArgumentScanner::scan(sample.text, sample.argumentStarts.size() + 1);
+        if (!result.isCall || result.argumentStarts != sample.argumentStarts || result.closingParenthesis != sample.closingParenthesis) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// Scans all samples repeatedly, returns MB/s of the text scanned
+double measure(const QVector<ArgumentCorpus::Sample>& samples)
+{
+    qint64 bytes = 0;
+    int checksum = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        for (const auto &sample : samples) {
+            const ArgumentScanner::Result result = ArgumentScanner::scan(sample.text, sample.argumentStarts.size() + 1);
+            checksum += result.closingParenthesis;
+            bytes += (result.closingParenthesis + 1) * sizeof(QChar);
+        }
+    } while (timer.nsecsElapsed() < MIN_DURATION_NS);
+    const qint64 ns = timer.nsecsElapsed();
+
+    // Keeps the compiler from dropping the scans
+    if (checksum == 42) fprintf(stderr, " ");
+
+    return (bytes * 1000.0) / ns;
+}
+
+}
+
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("argumentscannerbenchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the throughput of ArgumentScanner on synthetic call sites with every implementation of the delimiter search"));
+    parser.addHelpOption();
+    parser.addOption({ QStringLiteral("samples"), QStringLiteral("Number of call sites to generate"), QStringLiteral("count"), QStringLiteral("20000") });
+    parser.addOption({ QStringLiteral("length"), QStringLiteral("Approximate maximum length of one call site"), QStringLiteral("characters"), QStringLiteral("400") });
+    parser.addOption({ QStringLiteral("seed"), QStringLiteral("Seed of the generator"), QStringLiteral("number"), QStringLiteral("1") });
+    parser.process(app);
+
+    const QVector<ArgumentCorpus::Sample> samples = ArgumentCorpus::generate(parser.value(QStringLiteral("samples")).toInt(),
+                                                                             parser.value(QStringLiteral("seed")).toUInt(),
+                                                                             parser.value(QStringLiteral("length")).toInt());
+
+    qint64 corpusBytes = 0;
+    for (const auto &sample : samples) {
+        corpusBytes += sample.text.size() * sizeof(QChar);
+    }
+    fprintf(stdout, "%d call sites, %lld kB\n", samples.size(), corpusBytes / 1024);
+
+    // Scalar against the vectorized delimiter searches the CPU supports
+    for (const QString& implementation : ArgumentScanner::implementations()) {
+        ArgumentScanner::setImplementation(implementation);
+
+        const int mismatches = verify(samples);
+        if (mismatches) {
+            fprintf(stderr, "%s: %d call sites scanned wrong\n", qPrintable(implementation), mismatches);
+            return 1;
+        }
+
+        fprintf(stdout, "%-8s %8.1f MB/s\n", qPrintable(implementation), measure(samples));
+    }
+    return 0;
+}
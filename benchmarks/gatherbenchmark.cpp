@@ -0,0 +1,146 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <QUrl>
+
+#include <language/duchain/duchain.h>
+#include <language/duchain/topducontext.h>
+#include <serialization/indexedstring.h>
+
+#include "headlesscore.h"
+#include "notebuilder.h"
+#include "sourceinfoconfig.h"
+#include "textsource.h"
+#include "typestringcache.h"
+
+
+using namespace KDevelop;
+
+
+namespace {
+
+// Gathers the file with the given number of threads, 0 walks it sequentially in chunks like the editor does.
+// Returns the duration in microseconds, -1 if the DUChain changed in the meantime.
+qint64 gather(const IndexedString& url, const SourceInfoSettings& settings, const TextSource& text, int threads)
+{
+    // Cold, like the first build of a file
+    TypeStringCache typeStrings;
+
+    NoteBuilder builder(settings, typeStrings, text);
+    builder.setDeferScanning(true);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!builder.start(url)) return -1;
+    if (threads > 0 && !builder.gatherParallel(threads)) return -1;
+
+    NoteBuilder::Status status;
+    do {
+        status = builder.step(std::numeric_limits<qint64>::max());
+    } while (status == NoteBuilder::Status::InProgress);
+
+    return (status == NoteBuilder::Status::Finished) ? timer.nsecsElapsed() / 1000 : -1;
+}
+
+}
+
+
+int main(int argc, char** argv)
+{
+    // The KDevelop core needs a QApplication even when running without UI
+    QApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("gatherbenchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures how gathering the notes of a parsed file scales with the number of threads"));
+    parser.addHelpOption();
+    parser.addOption({ QStringLiteral("session"), QStringLiteral("KDevelop session whose projects provide the include paths"), QStringLiteral("name") });
+    parser.addOption({ QStringLiteral("threads"), QStringLiteral("Largest number of threads to try"), QStringLiteral("count"),
+                       QString::number(QThread::idealThreadCount()) });
+    parser.addOption({ QStringLiteral("runs"), QStringLiteral("Runs per thread count, the median is reported"), QStringLiteral("count"), QStringLiteral("5") });
+    parser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("Source file to gather, a large one shows the scaling best"));
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+
+    const QString path = QFileInfo(parser.positionalArguments().first()).absoluteFilePath();
+    FileTextSource text;
+    if (!text.load(path)) {
+        fprintf(stderr, "Failed to read %s\n", qPrintable(path));
+        return 1;
+    }
+
+    if (!HeadlessCore::initialize(parser.value(QStringLiteral("session")))) {
+        fprintf(stderr, "Failed to start the KDevelop core\n");
+        return 1;
+    }
+
+    const IndexedString url(QUrl::fromLocalFile(path));
+    DUChain::self()->waitForUpdate(url, TopDUContext::AllDeclarationsContextsAndUses);
+
+    // Measure the walk itself, not its degradation
+    SourceInfoSettings settings;
+    settings.passBudgetMs = std::numeric_limits<int>::max() / 1000;
+
+    const int maxThreads = parser.value(QStringLiteral("threads")).toInt();
+    const int runs = qMax(parser.value(QStringLiteral("runs")).toInt(), 1);
+    NoteBuilder::gatherPool().setMaxThreadCount(qMax(maxThreads, 1));
+
+    int result = 0;
+    qint64 single = 0;
+    fprintf(stdout, "%s, %d lines\n", qPrintable(path), text.lineCount());
+    for (int threads = 0; threads <= maxThreads; threads = threads ? threads * 2 : 1) {
+        QVector<qint64> durations;
+        for (int run = 0; run < runs; run++) {
+            durations.append(gather(url, settings, text, threads));
+        }
+        std::sort(durations.begin(), durations.end());
+        if (durations.first() < 0) {
+            fprintf(stderr, "The file has no DUChain or it changed while gathering\n");
+            result = 1;
+            break;
+        }
+
+        const qint64 median = durations.at(runs / 2);
+        if (threads == 1) single = median;
+
+        if (threads == 0) {
+            fprintf(stdout, "sequential   %8.1f ms\n", median / 1000.0);
+        } else {
+            fprintf(stdout, "%2d threads   %8.1f ms   %5.2fx\n", threads, median / 1000.0, single / double(median));
+        }
+    }
+    fprintf(stdout, "Read lock held: %s\n", qPrintable(NoteBuilder::lockHoldHistogram().toString()));
+
+    HeadlessCore::shutdown();
+    return result;
+}
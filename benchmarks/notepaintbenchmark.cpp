@@ -0,0 +1,145 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+
+#include <QElapsedTimer>
+#include <QFont>
+#include <QFontMetricsF>
+#include <QGuiApplication>
+#include <QImage>
+#include <QPainter>
+#include <QVector>
+
+#include "notes/generictextnote.h"
+#include "notes/notestyle.h"
+
+
+namespace {
+
+constexpr int VISIBLE_LINES = 60;
+constexpr int WIDTH = 1600;
+
+// Long enough to make the timer resolution irrelevant
+constexpr qint64 MIN_DURATION_NS = 1000000000;
+
+typedef QVector<QVector<GenericTextNote*>> Lines;
+
+// The kinds of text notes a file with all passes enabled shows, a few per line
+Lines createNotes()
+{
+    Lines lines(VISIBLE_LINES);
+    for (int line = 0; line < VISIBLE_LINES; line++) {
+        QVector<GenericTextNote*> &notes = lines[line];
+
+        auto *argument = new GenericTextNote(8, QStringLiteral("count:"), QColor(0x808080), QBrush(QColor(0xf0f0f0)), true, 4.0);
+        argument->setSpaceRight(true);
+        notes.append(argument);
+
+        auto *defaults = new GenericTextNote(40, QStringLiteral(", flags: 0"), QColor(0x808080), QBrush(), false, 0.0);
+        notes.append(defaults);
+
+        if (line % 3 == 0) {
+            auto *coverage = new GenericTextNote(0, QStringLiteral("1.2k×"), QColor(0x808080), QBrush(QColor(0xeef6ee)), true, 4.0, 3.0);
+            coverage->setSpaceRight(true);
+            notes.append(coverage);
+        }
+        if (line % 5 == 0) {
+            auto *profile = new GenericTextNote(60, QStringLiteral("12.5%"), QColor(0x803020), QBrush(QColor::fromHsvF(0.05, 0.1 + 0.01 * line, 1.0)), true, 4.0);
+            profile->setSpaceLeft(true);
+            notes.append(profile);
+        }
+    }
+    return lines;
+}
+
+int noteCount(const Lines& lines)
+{
+    int count = 0;
+    for (const auto &notes : lines) {
+        count += notes.size();
+    }
+    return count;
+}
+
+// Paints the notes the way the editor does, each translated to its place in its line
+void paintFrame(QPainter& painter, const Lines& lines, qreal lineHeight, const QFontMetricsF& fontMetrics, const QFont& font)
+{
+    for (int line = 0; line < lines.size(); line++) {
+        qreal x = 0;
+        for (const GenericTextNote *note : lines.at(line)) {
+            painter.save();
+            painter.translate(x, line * lineHeight);
+            note->paint(lineHeight, fontMetrics, font, painter);
+            painter.restore();
+
+            x += note->width(lineHeight, fontMetrics) + 40;
+        }
+    }
+}
+
+void benchmark(const Lines& lines, qreal devicePixelRatio)
+{
+    const QFont font(QStringLiteral("Monospace"), 10);
+    const QFontMetricsF fontMetrics(font);
+    const qreal lineHeight = fontMetrics.height();
+
+    QImage image(QSize(WIDTH, int((VISIBLE_LINES + 1) * lineHeight)) * devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(devicePixelRatio);
+
+    qint64 frames = 0;
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        image.fill(Qt::white);
+
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setRenderHint(QPainter::TextAntialiasing);
+        paintFrame(painter, lines, lineHeight, fontMetrics, font);
+        frames++;
+    } while (timer.nsecsElapsed() < MIN_DURATION_NS);
+    const qint64 ns = timer.nsecsElapsed();
+
+    fprintf(stdout, "device pixel ratio %.0f: %.0f us per frame of %d lines, %.0f ns per note\n",
+            devicePixelRatio, double(ns) / frames / 1000, VISIBLE_LINES, double(ns) / (frames * noteCount(lines)));
+}
+
+}
+
+
+int main(int argc, char** argv)
+{
+    // Painting into an image needs no display, only the fonts
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    const Lines lines = createNotes();
+    fprintf(stdout, "%d notes, %d note styles\n", noteCount(lines), NoteStyles::count());
+
+    benchmark(lines, 1.0);
+    benchmark(lines, 2.0);
+
+    for (const auto &notes : lines) {
+        qDeleteAll(notes);
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFontMetricsF>
+#include <QPainter>
+
+#include "notes/notestore.h"
+
+
+namespace {
+
+constexpr int LINES = 10000;
+constexpr int VISIBLE_LINES = 60;
+
+// Long enough to make the timer resolution irrelevant
+constexpr qint64 MIN_DURATION_NS = 1000000000;
+
+QAtomicInt s_allocations;
+bool s_countAllocations = false;
+
+// Only the lookups are measured, nothing is painted
+class BenchmarkNote : public InlineNoteBase
+{
+public:
+    explicit BenchmarkNote(int column)
+        : m_column(column)
+    {
+    }
+
+    int column() const override { return m_column; }
+    qreal width(qreal height, const QFontMetricsF&) const override { return height; }
+    void paint(qreal, const QFontMetricsF&, const QFont&, QPainter&) const override {}
+    size_t memoryUsage() const override { return sizeof(*this); }
+
+private:
+    int m_column;
+};
+
+// What the editor asks for when the view shows the lines from the given one on
+int showLines(const NoteStore& store, int first)
+{
+    int checksum = 0;
+    for (int line = first; line < first + VISIBLE_LINES; line++) {
+        const QVector<int> columns = store.columns(line);
+        for (int column : columns) {
+            checksum += store.find(KTextEditor::Cursor(line, column))->column();
+        }
+    }
+    return checksum;
+}
+
+}
+
+
+// Counts the allocations while scrolling, there should be none
+void* operator new(size_t size)
+{
+    if (s_countAllocations) s_allocations.fetchAndAddRelaxed(1);
+
+    void* memory = malloc(size ? size : 1);
+    if (!memory) abort();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+
+int main()
+{
+    // Zero to three notes per line, like a file with many calls
+    NoteStore store;
+    for (int line = 0; line < LINES; line++) {
+        for (int i = 0; i < line % 4; i++) {
+            store.insert(KTextEditor::Cursor(line, 4 + 8 * i), new BenchmarkNote(4 + 8 * i));
+        }
+    }
+    fprintf(stdout, "%d lines, %d notes, %zu kB\n", LINES, store.count(), store.memoryUsage() / 1024);
+
+    // Scroll through the whole file line by line, again and again
+    qint64 frames = 0;
+    int checksum = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    s_countAllocations = true;
+    do {
+        for (int first = 0; first + VISIBLE_LINES <= LINES; first++) {
+            checksum += showLines(store, first);
+            frames++;
+        }
+    } while (timer.nsecsElapsed() < MIN_DURATION_NS);
+    s_countAllocations = false;
+    const qint64 ns = timer.nsecsElapsed();
+
+    // Keeps the compiler from dropping the lookups
+    if (checksum == 42) fprintf(stderr, " ");
+
+    fprintf(stdout, "%.0f ns per frame of %d lines, %.1f ns per line\n", double(ns) / frames, VISIBLE_LINES, double(ns) / (frames * VISIBLE_LINES));
+    fprintf(stdout, "%.2f allocations per frame\n", double(s_allocations.load()) / frames);
+
+    return 0;
+}
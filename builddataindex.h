@@ -0,0 +1,70 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef BUILDDATAINDEX_H
+#define BUILDDATAINDEX_H
+
+#include <QAtomicInt>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+
+/**
+ * Index of data files the build wrote into a directory tree, like coverage
+ * data or optimization records.
+ *
+ * Immutable once built and usable from any thread. Changed data files are
+ * picked up by building a refreshed copy, which only rereads the data files
+ * in the directories that changed. Maintained by BuildDataIndexer.
+ */
+class BuildDataIndex
+{
+public:
+    /**
+     * Builds the index of the directory and its subdirectories. Blocking,
+     * meant to run in a worker thread.
+     *
+     * \param cancelled checked periodically, scanning stops once it is set
+     *
+     * \return the index or null if the directory can not be read or
+     *         scanning was cancelled
+     */
+    using ScanFunction = QSharedPointer<BuildDataIndex> (*)(const QString& directory, const QAtomicInt& cancelled, QString* error);
+
+    virtual ~BuildDataIndex() = default;
+
+    /**
+     * Copy of this index with the data files directly in the given
+     * directories read again. Blocking, meant to run in a worker thread.
+     *
+     * \return the refreshed index or null if cancelled
+     */
+    virtual QSharedPointer<BuildDataIndex> refreshed(const QSet<QString>& directories, const QAtomicInt& cancelled) const = 0;
+
+    virtual QString directory() const = 0;
+
+    /**
+     * The directories that contain data files, for watching them.
+     */
+    virtual QStringList dataDirectories() const = 0;
+};
+
+#endif // BUILDDATAINDEX_H
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QAtomicInt>
+#include <QRunnable>
+
+#include "builddataindexer.h"
+
+
+constexpr int BuildDataIndexer::POLL_INTERVAL_MS;
+constexpr int BuildDataIndexer::REFRESH_DELAY_MS;
+
+
+// Shared with the task, which keeps running for a while after the job is cancelled
+struct BuildDataIndexer::Job {
+    BuildDataIndex::ScanFunction scan = nullptr;
+    QString directory;
+
+    // Refreshing the directories of an existing index if set, scanning the whole directory otherwise
+    QSharedPointer<const BuildDataIndex> base;
+    QSet<QString> changedDirectories;
+
+    QAtomicInt cancelled;
+    QAtomicInt finished;
+
+    // Written by the task before finished is set
+    QSharedPointer<BuildDataIndex> result;
+    QString error;
+};
+
+class BuildDataIndexer::IndexTask : public QRunnable
+{
+public:
+    explicit IndexTask(QSharedPointer<Job> job)
+        : m_job(job)
+    {
+    }
+
+    void run() override
+    {
+        if (m_job->base) {
+            m_job->result = m_job->base->refreshed(m_job->changedDirectories, m_job->cancelled);
+        } else {
+            m_job->result = m_job->scan(m_job->directory, m_job->cancelled, &m_job->error);
+        }
+        m_job->finished.storeRelease(1);
+    }
+
+private:
+    QSharedPointer<Job> m_job;
+};
+
+
+BuildDataIndexer::BuildDataIndexer(BuildDataIndex::ScanFunction scan, QObject* parent)
+    : QObject(parent)
+    , m_scan(scan)
+{
+    m_pool.setMaxThreadCount(1);
+
+    m_pollTimer.setInterval(POLL_INTERVAL_MS);
+    connect(&m_pollTimer, &QTimer::timeout, this, &BuildDataIndexer::poll);
+
+    m_refreshTimer.setSingleShot(true);
+    m_refreshTimer.setInterval(REFRESH_DELAY_MS);
+    connect(&m_refreshTimer, &QTimer::timeout, this, &BuildDataIndexer::refresh);
+
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &BuildDataIndexer::directoryChanged);
+}
+
+BuildDataIndexer::~BuildDataIndexer()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void BuildDataIndexer::setDirectory(const QString& directory)
+{
+    clear();
+    m_directory = directory;
+
+    auto job = QSharedPointer<Job>::create();
+    job->scan = m_scan;
+    job->directory = directory;
+    start(job);
+}
+
+void BuildDataIndexer::clear()
+{
+    cancel();
+    m_directory.clear();
+    m_index.reset();
+    m_changedDirectories.clear();
+    m_refreshTimer.stop();
+    updateWatchedDirectories();
+}
+
+bool BuildDataIndexer::isIndexing() const
+{
+    return !m_job.isNull();
+}
+
+void BuildDataIndexer::start(QSharedPointer<Job> job)
+{
+    m_job = job;
+    m_pool.start(new IndexTask(m_job));
+    m_pollTimer.start();
+}
+
+void BuildDataIndexer::cancel()
+{
+    if (!m_job) return;
+
+    m_job->cancelled.storeRelease(1);
+    m_job.reset();
+    m_pollTimer.stop();
+}
+
+void BuildDataIndexer::poll()
+{
+    if (!m_job->finished.loadAcquire()) return;
+
+    const QSharedPointer<Job> job = m_job;
+    m_job.reset();
+    m_pollTimer.stop();
+
+    if (!job->result) {
+        // Refreshing is only cancelled by setDirectory() or clear(), so this was a scan
+        emit failed(job->error);
+        return;
+    }
+
+    m_index = job->result;
+    updateWatchedDirectories();
+    emit indexed(m_index);
+}
+
+void BuildDataIndexer::directoryChanged(const QString& directory)
+{
+    if (!m_index) return;
+
+    m_changedDirectories.insert(directory);
+    m_refreshTimer.start();
+}
+
+void BuildDataIndexer::refresh()
+{
+    if (!m_index || m_changedDirectories.isEmpty()) return;
+
+    // One at a time, the next one has to start from the result of this one
+    if (m_job) {
+        m_refreshTimer.start();
+        return;
+    }
+
+    auto job = QSharedPointer<Job>::create();
+    job->scan = m_scan;
+    job->directory = m_directory;
+    job->base = m_index;
+    job->changedDirectories = m_changedDirectories;
+    m_changedDirectories.clear();
+    start(job);
+}
+
+void BuildDataIndexer::updateWatchedDirectories()
+{
+    QSet<QString> wanted;
+    if (m_index) {
+        for (const QString& directory : m_index->dataDirectories()) {
+            wanted.insert(directory);
+        }
+        wanted.insert(m_index->directory());
+    }
+
+    const QStringList watched = m_watcher.directories();
+    QStringList removed;
+    for (const QString& directory : watched) {
+        if (!wanted.remove(directory)) {
+            removed.append(directory);
+        }
+    }
+
+    if (!removed.isEmpty()) {
+        m_watcher.removePaths(removed);
+    }
+    if (!wanted.isEmpty()) {
+        m_watcher.addPaths(wanted.values());
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef BUILDDATAINDEXER_H
+#define BUILDDATAINDEXER_H
+
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "builddataindex.h"
+
+
+/**
+ * Indexes the data files of a build directory in a background thread and
+ * keeps the index up to date when they change.
+ *
+ * Only the directories that contain data files are watched, changes to them
+ * are collected for a moment and then only those directories are read
+ * again.
+ */
+class BuildDataIndexer : public QObject
+{
+    Q_OBJECT
+
+    static constexpr int POLL_INTERVAL_MS = 100;
+    static constexpr int REFRESH_DELAY_MS = 1000; // Running the tests rewrites many data files in a row
+
+public:
+    /**
+     * \param scan builds the index of the kind of data this indexer handles
+     */
+    explicit BuildDataIndexer(BuildDataIndex::ScanFunction scan, QObject* parent = nullptr);
+    ~BuildDataIndexer() override;
+
+    void setDirectory(const QString& directory);
+    void clear();
+
+    bool isIndexing() const;
+
+Q_SIGNALS:
+    void indexed(QSharedPointer<const BuildDataIndex> index);
+    void failed(const QString& error);
+
+private Q_SLOTS:
+    void poll();
+    void directoryChanged(const QString& directory);
+    void refresh();
+
+private:
+    struct Job;
+    class IndexTask;
+
+    void start(QSharedPointer<Job> job);
+    void cancel();
+    void updateWatchedDirectories();
+
+    BuildDataIndex::ScanFunction m_scan;
+
+    QString m_directory;
+    QSharedPointer<const BuildDataIndex> m_index;
+
+    QSharedPointer<Job> m_job;
+    QThreadPool m_pool;
+    QTimer m_pollTimer;
+
+    QFileSystemWatcher m_watcher;
+    QSet<QString> m_changedDirectories;
+    QTimer m_refreshTimer;
+};
+
+#endif // BUILDDATAINDEXER_H
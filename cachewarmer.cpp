@@ -0,0 +1,185 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QRunnable>
+#include <QThread>
+
+#include <interfaces/icore.h>
+#include <interfaces/ilanguagecontroller.h>
+#include <interfaces/iproject.h>
+#include <language/backgroundparser/backgroundparser.h>
+#include <language/duchain/duchainlock.h>
+#include <language/duchain/duchainutils.h>
+#include <language/duchain/parsingenvironment.h>
+#include <language/duchain/topducontext.h>
+
+#include "cachewarmer.h"
+#include "notebuilder.h"
+#include "notecache.h"
+#include "sourceinfoconfig.h"
+#include "textsource.h"
+
+#include <debug.h>
+
+
+using namespace KDevelop;
+
+
+namespace {
+
+class WarmFileTask : public QRunnable
+{
+public:
+    WarmFileTask(const IndexedString& url, QSharedPointer<const SourceInfoSettings> settings, QSharedPointer<TypeStringCache> typeStrings, QSharedPointer<NoteCache> noteCache, QSharedPointer<QAtomicInt> cancelled)
+        : m_url(url)
+        , m_settings(settings)
+        , m_typeStrings(typeStrings)
+        , m_noteCache(noteCache)
+        , m_cancelled(cancelled)
+        , m_generation(noteCache->generation())
+    {}
+
+    void run() override
+    {
+        QThread::currentThread()->setPriority(QThread::IdlePriority);
+
+        if (m_cancelled->load()) return;
+
+        // Skip files that were not parsed or are already cached before bothering with reading them
+        {
+            DUChainReadLocker lock;
+            TopDUContext* topContext = DUChainUtils::standardContextForUrl(m_url.toUrl());
+            if (!topContext || !topContext->parsingEnvironmentFile()) return;
+            if (m_noteCache->contains(m_url, topContext->parsingEnvironmentFile()->modificationRevision())) return;
+        }
+
+        FileTextSource text;
+        if (!text.load(m_url.toUrl().toLocalFile())) return;
+
+        NoteBuilder builder(*m_settings, *m_typeStrings, text);
+        auto notes = builder.build(m_url, m_cancelled.data());
+
+        // Incomplete notes of files too expensive for the pass budget would be shown as if they were complete
+        if (notes && !builder.isDegraded()) {
+            m_noteCache->insert(m_url, builder.revision(), notes, m_generation);
+        }
+    }
+
+private:
+    IndexedString m_url;
+    QSharedPointer<const SourceInfoSettings> m_settings;
+    QSharedPointer<TypeStringCache> m_typeStrings;
+    QSharedPointer<NoteCache> m_noteCache;
+    QSharedPointer<QAtomicInt> m_cancelled;
+    uint m_generation;
+};
+
+}
+
+
+CacheWarmer::CacheWarmer(QSharedPointer<SourceInfoConfig> config, QSharedPointer<TypeStringCache> typeStrings, QSharedPointer<NoteCache> noteCache, QObject* parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_typeStrings(typeStrings)
+    , m_noteCache(noteCache)
+    , m_cancelled(QSharedPointer<QAtomicInt>::create(0))
+{
+    m_pool.setMaxThreadCount(m_config->warmCacheMaxThreads);
+
+    m_scheduleTimer.setInterval(SCHEDULE_INTERVAL_MS);
+    connect(&m_scheduleTimer, &QTimer::timeout, this, &CacheWarmer::scheduleMore);
+}
+
+CacheWarmer::~CacheWarmer()
+{
+    stop();
+}
+
+void CacheWarmer::warmProject(IProject* project)
+{
+    const auto files = project->fileSet();
+    for (const auto &url : files) {
+        m_pending.append(url);
+    }
+
+    qCDebug(KDEV_SOURCEINFO) << "Precomputing notes for" << files.size() << "files of project" << project->name();
+
+    if (!m_pending.isEmpty()) {
+        m_scheduleTimer.start();
+    }
+}
+
+void CacheWarmer::forgetProject(IProject* project)
+{
+    const auto files = project->fileSet();
+    for (const auto &url : files) {
+        m_pending.removeAll(url);
+    }
+}
+
+void CacheWarmer::setMaxThreadCount(int maxThreadCount)
+{
+    m_pool.setMaxThreadCount(maxThreadCount);
+}
+
+void CacheWarmer::cancel()
+{
+    m_pending.clear();
+    m_scheduleTimer.stop();
+    m_pool.clear();
+
+    // The running tasks drain on their own, tasks scheduled from now on get a fresh flag
+    m_cancelled->store(1);
+    m_cancelled = QSharedPointer<QAtomicInt>::create(0);
+}
+
+void CacheWarmer::stop()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void CacheWarmer::scheduleMore()
+{
+    if (m_pending.isEmpty()) {
+        m_scheduleTimer.stop();
+        return;
+    }
+
+    if (m_noteCache->memoryUsage() >= m_noteCache->budget()) {
+        qCDebug(KDEV_SOURCEINFO) << "Note cache budget reached, not precomputing remaining" << m_pending.size() << "files";
+        m_pending.clear();
+        m_scheduleTimer.stop();
+        return;
+    }
+
+    // Leave the CPU to the parser while it has work to do
+    if (ICore::self()->languageController()->backgroundParser()->queuedCount() > 0) {
+        return;
+    }
+
+    // Keep just one task queued per thread, so that cancel() or config changes take effect quickly
+    QSharedPointer<const SourceInfoSettings> settings;
+    while (!m_pending.isEmpty() && m_pool.activeThreadCount() < m_pool.maxThreadCount()) {
+        if (!settings) {
+            settings = QSharedPointer<const SourceInfoSettings>::create(*m_config);
+        }
+        m_pool.start(new WarmFileTask(m_pending.takeFirst(), settings, m_typeStrings, m_noteCache, m_cancelled));
+    }
+}
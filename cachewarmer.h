@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef CACHEWARMER_H
+#define CACHEWARMER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <serialization/indexedstring.h>
+
+
+namespace KDevelop {
+class IProject;
+}
+
+class NoteCache;
+class SourceInfoConfig;
+struct SourceInfoSettings;
+class TypeStringCache;
+
+
+/**
+ * Precomputes notes of all project files in the background.
+ *
+ * Files are handed to a small pool of low priority threads, only while the
+ * background parser has nothing queued and until the memory budget of the
+ * note cache is reached. Each task computes the notes with a snapshot of the
+ * settings taken when it was scheduled.
+ */
+class CacheWarmer : public QObject
+{
+    Q_OBJECT
+
+    static constexpr int SCHEDULE_INTERVAL_MS = 250;
+
+public:
+    CacheWarmer(QSharedPointer<SourceInfoConfig> config, QSharedPointer<TypeStringCache> typeStrings, QSharedPointer<NoteCache> noteCache, QObject* parent = nullptr);
+    ~CacheWarmer() override;
+
+    void warmProject(KDevelop::IProject* project);
+    void forgetProject(KDevelop::IProject* project);
+
+    void setMaxThreadCount(int maxThreadCount);
+
+    /**
+     * Drop all pending files and let the running computations stop at their
+     * next step, without waiting for them.
+     */
+    void cancel();
+
+    /**
+     * Cancel and wait for the running computations.
+     */
+    void stop();
+
+private Q_SLOTS:
+    void scheduleMore();
+
+private:
+    QSharedPointer<SourceInfoConfig> m_config;
+    QSharedPointer<TypeStringCache> m_typeStrings;
+    QSharedPointer<NoteCache> m_noteCache;
+
+    QThreadPool m_pool;
+    QTimer m_scheduleTimer;
+    QList<KDevelop::IndexedString> m_pending;
+
+    // Set once the tasks scheduled so far are cancelled, replaced for the following ones
+    QSharedPointer<QAtomicInt> m_cancelled;
+};
+
+#endif // CACHEWARMER_H
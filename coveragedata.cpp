@@ -0,0 +1,462 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <KLocalizedString>
+
+#include "coveragedata.h"
+
+#include <debug.h>
+
+
+namespace {
+
+// How often the cancellation is checked while reading a tracefile
+constexpr int CANCEL_CHECK_INTERVAL_LINES = 4096;
+
+QString canonicalSource(const QDir& base, const QString& name)
+{
+    const QString absolute = base.absoluteFilePath(name);
+    const QString canonical = QFileInfo(absolute).canonicalFilePath();
+    return canonical.isEmpty() ? QDir::cleanPath(absolute) : canonical;
+}
+
+QByteArray readLine(QFile& file)
+{
+    QByteArray line = file.readLine();
+    while (line.endsWith('\n') || line.endsWith('\r')) {
+        line.chop(1);
+    }
+    return line;
+}
+
+bool detectFormat(const QFileInfo& info, CoverageData::Format* format)
+{
+    const QString suffix = info.suffix();
+    if (suffix == QLatin1String("gcov")) {
+        *format = CoverageData::Format::Gcov;
+        return true;
+    }
+    if (suffix == QLatin1String("info")) {
+        *format = CoverageData::Format::Lcov;
+        return true;
+    }
+    if (suffix != QLatin1String("json")) {
+        return false;
+    }
+
+    // Build directories are full of other JSON files, compile_commands.json for one
+    QFile file(info.filePath());
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QByteArray head = file.read(64);
+    head = head.simplified().replace(' ', QByteArray());
+    *format = CoverageData::Format::LlvmCovJson;
+    return head.startsWith("{\"data\":[");
+}
+
+// A line of gcov output is "count:line:text", both numbers padded with spaces
+bool splitGcovLine(const QByteArray& line, QByteArray* count, int* lineNumber, QByteArray* text)
+{
+    const int first = line.indexOf(':');
+    if (first < 0) return false;
+    const int second = line.indexOf(':', first + 1);
+    if (second < 0) return false;
+
+    bool ok = false;
+    *lineNumber = line.mid(first + 1, second - first - 1).trimmed().toInt(&ok);
+    if (!ok) return false;
+
+    *count = line.left(first).trimmed();
+    *text = line.mid(second + 1);
+    return true;
+}
+
+// The source file is named by the "Source:" header, relative to where gcov ran, which is where it writes its output
+bool readGcov(const QFileInfo& info, QHash<QString, CoverageData::LineCounts>& sources)
+{
+    QFile file(info.filePath());
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QString source;
+    CoverageData::LineCounts counts;
+    QByteArray count, text;
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        if (!splitGcovLine(readLine(file), &count, &lineNumber, &text)) continue;
+
+        if (lineNumber == 0) {
+            if (source.isEmpty() && text.startsWith("Source:")) {
+                source = canonicalSource(info.dir(), QString::fromUtf8(text.mid(7)));
+            }
+            continue;
+        }
+        if (lineNumber < 0) continue;
+
+        // Lines of templates are repeated per instantiation after the totals, keep the totals
+        if (counts.contains(lineNumber - 1)) continue;
+
+        // "-" marks lines without code, "#####" and "=====" lines that never ran, "*" blocks that ran partially
+        if (count == "-") continue;
+        if (count == "#####" || count == "=====") {
+            counts.insert(lineNumber - 1, 0);
+            continue;
+        }
+        if (count.endsWith('*')) {
+            count.chop(1);
+        }
+
+        bool ok = false;
+        const quint64 value = count.toULongLong(&ok);
+        if (ok) {
+            counts.insert(lineNumber - 1, value);
+        }
+    }
+
+    if (source.isEmpty()) return false;
+    sources.insert(source, counts);
+    return true;
+}
+
+bool readLcov(const QFileInfo& info, const QAtomicInt& cancelled, QHash<QString, CoverageData::LineCounts>& sources)
+{
+    QFile file(info.filePath());
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    CoverageData::LineCounts* current = nullptr;
+    int lines = 0;
+    while (!file.atEnd()) {
+        if (++lines % CANCEL_CHECK_INTERVAL_LINES == 0 && cancelled.loadAcquire()) return false;
+
+        const QByteArray line = readLine(file);
+        if (line.startsWith("SF:")) {
+            current = &sources[canonicalSource(info.dir(), QString::fromUtf8(line.mid(3)))];
+        } else if (line.startsWith("DA:") && current) {
+            // DA:<line>,<count>[,<checksum>]
+            const QList<QByteArray> fields = line.mid(3).split(',');
+            if (fields.size() < 2) continue;
+
+            bool lineOk = false, countOk = false;
+            const int lineNumber = fields.at(0).toInt(&lineOk);
+            const quint64 count = fields.at(1).toULongLong(&countOk);
+            if (lineOk && countOk && lineNumber > 0) {
+                (*current)[lineNumber - 1] += count;
+            }
+        } else if (line == "end_of_record") {
+            current = nullptr;
+        }
+    }
+    return true;
+}
+
+// Same as llvm-cov does for its line view: a line has the highest count of the regions starting on it, or the count of
+// the region it is wrapped in if none starts there
+CoverageData::LineCounts segmentsToLines(const QJsonArray& segments)
+{
+    CoverageData::LineCounts counts;
+
+    // Segment: [line, column, count, hasCount, isRegionEntry, isGapRegion], lines starting at 1
+    bool wrappedMapped = false;
+    quint64 wrappedCount = 0;
+
+    int i = 0;
+    while (i < segments.size()) {
+        const int line = segments.at(i).toArray().at(0).toInt();
+
+        bool mapped = wrappedMapped;
+        quint64 count = wrappedMapped ? wrappedCount : 0;
+        for (; i < segments.size(); i++) {
+            const QJsonArray segment = segments.at(i).toArray();
+            if (segment.size() < 5 || segment.at(0).toInt() != line) break;
+
+            const quint64 segmentCount = quint64(segment.at(2).toDouble());
+            const bool hasCount = segment.at(3).toBool();
+            const bool isRegionEntry = segment.at(4).toBool();
+            const bool isGapRegion = segment.size() > 5 && segment.at(5).toBool();
+
+            if (hasCount && isRegionEntry && !isGapRegion) {
+                count = mapped ? qMax(count, segmentCount) : segmentCount;
+                mapped = true;
+            }
+
+            wrappedMapped = hasCount && !isGapRegion;
+            wrappedCount = segmentCount;
+        }
+
+        if (line > 0 && mapped) {
+            counts.insert(line - 1, count);
+        }
+
+        // The lines until the next segment belong to the last region
+        const int nextLine = i < segments.size() ? segments.at(i).toArray().at(0).toInt() : line + 1;
+        if (wrappedMapped) {
+            for (int wrapped = line + 1; wrapped < nextLine; wrapped++) {
+                counts.insert(wrapped - 1, wrappedCount);
+            }
+        }
+
+        // Malformed input, segments out of order
+        if (nextLine <= line) {
+            i++;
+        }
+    }
+    return counts;
+}
+
+bool readLlvmCovJson(const QFileInfo& info, QHash<QString, CoverageData::LineCounts>& sources)
+{
+    QFile file(info.filePath());
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (document.isNull()) {
+        qCDebug(KDEV_SOURCEINFO) << "Failed to parse" << info.filePath() << ":" << error.errorString();
+        return false;
+    }
+
+    const QJsonObject root = document.object();
+    if (root.value(QStringLiteral("type")).toString() != QLatin1String("llvm.coverage.json.export")) return false;
+
+    for (const QJsonValue& exported : root.value(QStringLiteral("data")).toArray()) {
+        for (const QJsonValue& fileValue : exported.toObject().value(QStringLiteral("files")).toArray()) {
+            const QJsonObject fileObject = fileValue.toObject();
+            const QString source = canonicalSource(info.dir(), fileObject.value(QStringLiteral("filename")).toString());
+
+            CoverageData::LineCounts& counts = sources[source];
+            const CoverageData::LineCounts fileCounts = segmentsToLines(fileObject.value(QStringLiteral("segments")).toArray());
+            for (auto iter = fileCounts.constBegin(); iter != fileCounts.constEnd(); ++iter) {
+                counts[iter.key()] += iter.value();
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+
+QSharedPointer<BuildDataIndex> CoverageData::scan(const QString& directory, const QAtomicInt& cancelled, QString* error)
+{
+    const QDir dir(directory);
+    if (!dir.exists() || !dir.isReadable()) {
+        if (error) *error = i18n("Can not read %1", directory);
+        return QSharedPointer<BuildDataIndex>();
+    }
+
+    auto data = QSharedPointer<CoverageData>::create();
+    data->m_directory = dir.absolutePath();
+
+    QDirIterator iter(data->m_directory,
+                      { QStringLiteral("*.gcov"), QStringLiteral("*.info"), QStringLiteral("*.json") },
+                      QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+    while (iter.hasNext()) {
+        if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+        iter.next();
+        const QFileInfo info = iter.fileInfo();
+
+        Format format;
+        if (detectFormat(info, &format)) {
+            data->addDataFile(info, format, cancelled);
+        }
+    }
+    if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+    data->merge(data->m_dataFilesBySource.keys());
+
+    qCDebug(KDEV_SOURCEINFO) << "Indexed" << data->m_dataFiles.size() << "coverage data files covering"
+                             << data->m_dataFilesBySource.size() << "files in" << data->m_directory;
+    return data;
+}
+
+QSharedPointer<BuildDataIndex> CoverageData::refreshed(const QSet<QString>& directories, const QAtomicInt& cancelled) const
+{
+    auto data = QSharedPointer<CoverageData>::create();
+    data->m_directory = m_directory;
+    data->m_dataFiles = m_dataFiles;
+    data->m_dataFilesBySource = m_dataFilesBySource;
+    data->m_dataFilesByDirectory = m_dataFilesByDirectory;
+    data->m_merged = m_merged;
+
+    QStringList changedSources;
+    for (const QString& directory : directories) {
+        if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+        QSet<QString> present;
+        const QFileInfoList entries = QDir(directory).entryInfoList({ QStringLiteral("*.gcov"), QStringLiteral("*.info"), QStringLiteral("*.json") },
+                                                                    QDir::Files | QDir::Readable);
+        for (const QFileInfo& info : entries) {
+            const QString path = info.filePath();
+            present.insert(path);
+
+            auto known = data->m_dataFiles.constFind(path);
+            if (known != data->m_dataFiles.constEnd() && known->lastModified == info.lastModified()) continue;
+
+            Format format;
+            if (!detectFormat(info, &format)) continue;
+
+            changedSources += data->removeDataFile(path);
+            changedSources += data->addDataFile(info, format, cancelled);
+        }
+
+        // Deleted ones
+        const QSet<QString> known = data->m_dataFilesByDirectory.value(directory);
+        for (const QString& path : known) {
+            if (!present.contains(path)) {
+                changedSources += data->removeDataFile(path);
+            }
+        }
+    }
+
+    // A tracefile may have been read only partially
+    if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+    changedSources.removeDuplicates();
+    data->merge(changedSources);
+
+    qCDebug(KDEV_SOURCEINFO) << "Refreshed coverage of" << changedSources.size() << "files in" << directories.size() << "directories";
+    return data;
+}
+
+QStringList CoverageData::addDataFile(const QFileInfo& info, Format format, const QAtomicInt& cancelled)
+{
+    DataFile dataFile;
+    dataFile.format = format;
+    dataFile.lastModified = info.lastModified();
+
+    QHash<QString, LineCounts> sources;
+    switch (format) {
+        case Format::Gcov:
+            readGcov(info, sources);
+            break;
+        case Format::Lcov:
+            readLcov(info, cancelled, sources);
+            break;
+        case Format::LlvmCovJson:
+            readLlvmCovJson(info, sources);
+            break;
+    }
+
+    for (auto iter = sources.constBegin(); iter != sources.constEnd(); ++iter) {
+        dataFile.sources.append(iter.key());
+        dataFile.counts.insert(iter.key(), QSharedPointer<const LineCounts>::create(iter.value()));
+    }
+
+    // Remembered even if it covers nothing, so it is not read again until it changes
+    const QString path = info.filePath();
+    for (const QString& source : dataFile.sources) {
+        m_dataFilesBySource[source].append(path);
+    }
+    m_dataFilesByDirectory[info.path()].insert(path);
+    const QStringList changed = dataFile.sources;
+    m_dataFiles.insert(path, dataFile);
+    return changed;
+}
+
+QStringList CoverageData::removeDataFile(const QString& path)
+{
+    auto iter = m_dataFiles.find(path);
+    if (iter == m_dataFiles.end()) return QStringList();
+
+    const QStringList sources = iter->sources;
+    for (const QString& source : sources) {
+        QStringList& dataFiles = m_dataFilesBySource[source];
+        dataFiles.removeAll(path);
+        if (dataFiles.isEmpty()) {
+            m_dataFilesBySource.remove(source);
+        }
+    }
+
+    const QString directory = QFileInfo(path).path();
+    QSet<QString>& inDirectory = m_dataFilesByDirectory[directory];
+    inDirectory.remove(path);
+    if (inDirectory.isEmpty()) {
+        m_dataFilesByDirectory.remove(directory);
+    }
+
+    m_dataFiles.erase(iter);
+    return sources;
+}
+
+QString CoverageData::directory() const
+{
+    return m_directory;
+}
+
+QStringList CoverageData::dataDirectories() const
+{
+    return m_dataFilesByDirectory.keys();
+}
+
+void CoverageData::merge(const QStringList& sources)
+{
+    for (const QString& source : sources) {
+        const QStringList dataFilePaths = m_dataFilesBySource.value(source);
+        if (dataFilePaths.isEmpty()) {
+            m_merged.remove(source);
+            continue;
+        }
+
+        // Most sources are covered by a single data file, share its counts
+        if (dataFilePaths.size() == 1) {
+            m_merged.insert(source, m_dataFiles.value(dataFilePaths.first()).counts.value(source));
+            continue;
+        }
+
+        // Every translation unit that includes a header has its own counts for it
+        auto merged = QSharedPointer<LineCounts>::create();
+        for (const QString& dataFilePath : dataFilePaths) {
+            const auto counts = m_dataFiles.value(dataFilePath).counts.value(source);
+            if (!counts) continue;
+
+            for (auto iter = counts->constBegin(); iter != counts->constEnd(); ++iter) {
+                (*merged)[iter.key()] += iter.value();
+            }
+        }
+        m_merged.insert(source, merged);
+    }
+}
+
+CoverageData::LineCounts CoverageData::lines(const QString& path) const
+{
+    auto iter = m_merged.constFind(path);
+    if (iter == m_merged.constEnd()) {
+        iter = m_merged.constFind(canonicalSource(QDir(), path));
+    }
+
+    if (iter == m_merged.constEnd() || !*iter) return LineCounts();
+    return **iter;
+}
+
+int CoverageData::fileCount() const
+{
+    return m_dataFilesBySource.size();
+}
+
+int CoverageData::dataFileCount() const
+{
+    return m_dataFiles.size();
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COVERAGEDATA_H
+#define COVERAGEDATA_H
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+
+#include "builddataindex.h"
+
+
+/**
+ * Execution counts of source lines, for the coverage notes.
+ *
+ * Indexes the coverage data found in a build directory: `.gcov` text files,
+ * lcov tracefiles (`.info`) and the JSON written by `llvm-cov export`.
+ *
+ * All data files are read while scanning in the background, and the counts
+ * of every source file are merged then, so looking them up does not touch
+ * the disk. Builds with coverage produce one `.gcov` file per source file
+ * and translation unit, refreshing reads only the ones that changed.
+ */
+class CoverageData : public BuildDataIndex
+{
+public:
+    enum class Format {
+        Gcov,
+        Lcov,
+        LlvmCovJson,
+    };
+
+    using LineCounts = QHash<int, quint64>; // By line number starting at 0
+
+    /**
+     * Index the coverage data in the directory, see BuildDataIndex::ScanFunction.
+     */
+    static QSharedPointer<BuildDataIndex> scan(const QString& directory, const QAtomicInt& cancelled, QString* error);
+
+    QSharedPointer<BuildDataIndex> refreshed(const QSet<QString>& directories, const QAtomicInt& cancelled) const override;
+    QString directory() const override;
+    QStringList dataDirectories() const override;
+
+    /**
+     * Execution counts of the lines of the file, summed over all data files
+     * that cover it. Lines that do not contain any code have no count.
+     *
+     * Files are matched by canonical path. Only a lookup, safe to call from
+     * the main thread.
+     */
+    LineCounts lines(const QString& path) const;
+
+    int fileCount() const;
+    int dataFileCount() const;
+
+private:
+    struct DataFile {
+        Format format = Format::Gcov;
+        QDateTime lastModified;
+        QStringList sources; // Canonical paths
+
+        QHash<QString, QSharedPointer<const LineCounts>> counts; // By source
+    };
+
+    // Both return the sources whose counts changed
+    QStringList addDataFile(const QFileInfo& info, Format format, const QAtomicInt& cancelled);
+    QStringList removeDataFile(const QString& path);
+
+    // Recomputes the merged counts of the sources
+    void merge(const QStringList& sources);
+
+    QString m_directory;
+
+    QHash<QString, DataFile> m_dataFiles; // By path
+    QHash<QString, QStringList> m_dataFilesBySource; // By canonical path of the source
+    QHash<QString, QSet<QString>> m_dataFilesByDirectory;
+
+    // Counts of the source files, merged from all of their data files
+    QHash<QString, QSharedPointer<const LineCounts>> m_merged;
+};
+
+#endif // COVERAGEDATA_H
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include <cxxabi.h>
+
+#include "demangle.h"
+
+
+QString demangle(const char* name)
+{
+    if (std::strncmp(name, "_Z", 2) != 0) return QString::fromLatin1(name);
+
+    int status = 0;
+    std::unique_ptr<char, decltype(&std::free)> demangled(abi::__cxa_demangle(name, nullptr, nullptr, &status), &std::free);
+    return status == 0 && demangled ? QString::fromLatin1(demangled.get()) : QString::fromLatin1(name);
+}
+
+QString demangle(const QString& name)
+{
+    if (!name.startsWith(QLatin1String("_Z"))) return name;
+
+    return demangle(name.toLatin1().constData());
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DEMANGLE_H
+#define DEMANGLE_H
+
+#include <QString>
+
+
+/**
+ * Demangle a C++ symbol name of the Itanium ABI, names that are not mangled
+ * or can not be demangled are returned as they are.
+ */
+QString demangle(const char* name);
+QString demangle(const QString& name);
+
+#endif // DEMANGLE_H
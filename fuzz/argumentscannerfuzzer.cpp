@@ -0,0 +1,74 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <QString>
+
+#include "argumentscanner.h"
+
+
+namespace {
+
+// Enough to reach the end of most inputs, but also stop inside of some
+constexpr int MAX_ARGUMENTS = 64;
+
+void check(bool condition)
+{
+    if (!condition) abort();
+}
+
+}
+
+
+/**
+ * libFuzzer entry point, the input is taken as UTF-16 code units in the byte order of the machine,
+ * see argumentcorpusgenerator for the seed corpus.
+ *
+ * Beyond not crashing or reading out of bounds, checks that the offsets found are within the text
+ * and ordered and that stopping earlier gives the same beginning.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    QString text(int(size / sizeof(QChar)), Qt::Uninitialized);
+    memcpy(text.data(), data, text.size() * sizeof(QChar));
+
+    const ArgumentScanner::Result result = ArgumentScanner::scan(text, MAX_ARGUMENTS);
+
+    check(result.isCall || (result.argumentStarts.isEmpty() && result.closingParenthesis == -1));
+    int previous = 0;
+    for (int start : result.argumentStarts) {
+        check(start > previous && start < text.size());
+        previous = start;
+    }
+    if (result.closingParenthesis != -1) {
+        check(result.closingParenthesis >= previous && result.closingParenthesis < text.size());
+        check(text[result.closingParenthesis] == QLatin1Char(')'));
+    }
+
+    if (!result.argumentStarts.isEmpty()) {
+        const int limit = result.argumentStarts.size() - 1;
+        const ArgumentScanner::Result limited = ArgumentScanner::scan(text, limit);
+        check(limited.isCall && limited.argumentStarts == result.argumentStarts.mid(0, limit) && limited.closingParenthesis == -1);
+    }
+
+    return 0;
+}
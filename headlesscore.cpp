@@ -0,0 +1,127 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QCoreApplication>
+#include <QList>
+#include <QUrl>
+
+#include <KConfigGroup>
+#include <KLocalizedString>
+#include <KSharedConfig>
+
+#include <interfaces/iproject.h>
+#include <interfaces/iprojectcontroller.h>
+#include <interfaces/isession.h>
+#include <shell/core.h>
+#include <shell/shellextension.h>
+#include <util/path.h>
+
+#include "headlesscore.h"
+
+#include <debug.h>
+
+
+using namespace KDevelop;
+
+
+namespace {
+
+class HeadlessShellExtension : public ShellExtension
+{
+public:
+    static void init()
+    {
+        s_instance = new HeadlessShellExtension;
+    }
+
+    QString xmlFile() override
+    {
+        return QStringLiteral("kdevelopui.rc");
+    }
+
+    QString executableFilePath() override
+    {
+        return QCoreApplication::applicationFilePath();
+    }
+
+    AreaParams defaultArea() override
+    {
+        AreaParams params;
+        params.name = QStringLiteral("code");
+        params.title = i18n("Code");
+        return params;
+    }
+
+    QString projectFileExtension() override
+    {
+        return QStringLiteral("kdev4");
+    }
+
+    QString projectFileDescription() override
+    {
+        return i18n("KDevelop Project Files");
+    }
+
+    // Empty loads the plugins the session enables, like KDevelop does
+    QStringList defaultPlugins() override
+    {
+        return QStringList();
+    }
+};
+
+void openSessionProjects()
+{
+    // XXX: Whether the project controller reopens the projects of the session depends on the setup mode, make sure they are open
+    const KConfigGroup group = Core::self()->activeSession()->config()->group("General Options");
+    const auto projectFiles = group.readEntry("Open Projects", QList<QUrl>());
+
+    IProjectController* projectController = Core::self()->projectController();
+    for (const QUrl& projectFile : projectFiles) {
+        bool open = false;
+        for (IProject* project : projectController->projects()) {
+            if (project->projectFile().toUrl() == projectFile) open = true;
+        }
+        if (open) continue;
+
+        qCDebug(KDEV_SOURCEINFO) << "Opening project" << projectFile;
+        projectController->openProject(projectFile);
+    }
+}
+
+}
+
+
+bool HeadlessCore::initialize(const QString& session)
+{
+    HeadlessShellExtension::init();
+
+    if (!Core::initialize(nullptr, Core::NoUi, session)) {
+        return false;
+    }
+
+    if (!session.isEmpty()) {
+        openSessionProjects();
+    }
+    return true;
+}
+
+void HeadlessCore::shutdown()
+{
+    Core::self()->shutdown();
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef HEADLESSCORE_H
+#define HEADLESSCORE_H
+
+#include <QString>
+
+
+/**
+ * Runs the KDevelop core without UI, for the command line tools.
+ *
+ * The core is set up the way KDevelop sets it up, just without the main
+ * window: all plugins enabled in the session are loaded, so the language
+ * supports and the project managers are there, and the projects the
+ * session had open are opened, so the parser gets their include paths and
+ * defines. Without a session a temporary one is used, files are then
+ * parsed without any project configuration.
+ *
+ * Requires a QApplication.
+ */
+namespace HeadlessCore {
+
+/**
+ * \param session name or id of the KDevelop session, empty for none
+ * \return false if the core could not be started, for example because
+ *         the session is in use by a running KDevelop
+ */
+bool initialize(const QString& session);
+
+void shutdown();
+
+}
+
+#endif // HEADLESSCORE_H
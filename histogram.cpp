@@ -0,0 +1,61 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QStringList>
+
+#include "histogram.h"
+
+
+void Histogram::record(qint64 microseconds)
+{
+    int bucket = 0;
+    while (microseconds > 0 && bucket < BUCKETS - 1) {
+        microseconds >>= 1;
+        bucket++;
+    }
+
+    m_buckets[bucket].fetchAndAddRelaxed(1);
+}
+
+int Histogram::count() const
+{
+    int total = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        total += bucketCount(i);
+    }
+    return total;
+}
+
+int Histogram::bucketCount(int bucket) const
+{
+    return m_buckets[bucket].load();
+}
+
+QString Histogram::toString() const
+{
+    QStringList parts;
+    for (int i = 0; i < BUCKETS; i++) {
+        const int count = bucketCount(i);
+        if (count == 0) continue;
+
+        const QString upperBound = (i == BUCKETS - 1) ? QStringLiteral("inf") : QString::number(1ll << i) + QStringLiteral("us");
+        parts.append(QStringLiteral("<%1: %2").arg(upperBound).arg(count));
+    }
+    return parts.join(QStringLiteral(", "));
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <QAtomicInt>
+#include <QString>
+
+
+/**
+ * Histogram of durations with power of two buckets.
+ *
+ * Bucket 0 counts durations below 1 microsecond, bucket n counts durations
+ * from 2^(n-1) up to 2^n microseconds and the last bucket everything longer.
+ *
+ * Thread safe.
+ */
+class Histogram
+{
+public:
+    static constexpr int BUCKETS = 24;
+
+    void record(qint64 microseconds);
+
+    int count() const;
+    int bucketCount(int bucket) const;
+
+    /**
+     * Human readable summary of the non-empty buckets, for debug output.
+     */
+    QString toString() const;
+
+private:
+    QAtomicInt m_buckets[BUCKETS];
+};
+
+#endif // HISTOGRAM_H
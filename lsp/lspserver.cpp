@@ -0,0 +1,416 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <unistd.h>
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSocketNotifier>
+#include <QUrl>
+
+#include <interfaces/icore.h>
+#include <interfaces/ilanguagecontroller.h>
+#include <language/backgroundparser/backgroundparser.h>
+#include <language/duchain/duchain.h>
+#include <language/duchain/topducontext.h>
+#include <serialization/indexedstring.h>
+
+#include "lspserver.h"
+#include "notebuilder.h"
+#include "notes/generictextnote.h"
+#include "notes/notestore.h"
+
+#include <debug.h>
+
+
+using namespace KDevelop;
+
+
+namespace {
+
+// JSON-RPC error code of requests the server does not implement
+constexpr int METHOD_NOT_FOUND = -32601;
+
+// TextDocumentSyncKind.Incremental
+constexpr int INCREMENTAL_SYNC = 2;
+
+KTextEditor::Cursor toCursor(const QJsonValue& position)
+{
+    const QJsonObject object = position.toObject();
+    return KTextEditor::Cursor(object.value(QStringLiteral("line")).toInt(), object.value(QStringLiteral("character")).toInt());
+}
+
+KTextEditor::Range toRange(const QJsonValue& range)
+{
+    const QJsonObject object = range.toObject();
+    return KTextEditor::Range(toCursor(object.value(QStringLiteral("start"))), toCursor(object.value(QStringLiteral("end"))));
+}
+
+QJsonObject fromCursor(const KTextEditor::Cursor& cursor)
+{
+    return QJsonObject{ { QStringLiteral("line"), cursor.line() }, { QStringLiteral("character"), cursor.column() } };
+}
+
+QString documentUri(const QJsonObject& params)
+{
+    return params.value(QStringLiteral("textDocument")).toObject().value(QStringLiteral("uri")).toString();
+}
+
+}
+
+
+LspServer::LspServer(QObject* parent)
+    : QObject(parent)
+{
+    m_rebuildTimer.setSingleShot(true);
+    connect(&m_rebuildTimer, &QTimer::timeout, this, &LspServer::continueRebuilds);
+
+    connect(DUChain::self(), &DUChain::updateReady, this, &LspServer::updateReady);
+}
+
+LspServer::~LspServer()
+{
+    qDeleteAll(m_documents);
+}
+
+void LspServer::start()
+{
+    // Anything else written to stdout would corrupt the stream, the debug output goes to stderr
+    m_output.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+
+    m_inputNotifier = new QSocketNotifier(STDIN_FILENO, QSocketNotifier::Read, this);
+    connect(m_inputNotifier, &QSocketNotifier::activated, this, &LspServer::readInput);
+}
+
+void LspServer::readInput()
+{
+    char buffer[65536];
+    const ssize_t size = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (size <= 0) {
+        // The client is gone
+        m_inputNotifier->setEnabled(false);
+        QCoreApplication::exit(m_shutdown ? 0 : 1);
+        return;
+    }
+    m_input.append(buffer, size);
+
+    // Every message is preceded by headers, of which only Content-Length matters
+    for (;;) {
+        const int headerEnd = m_input.indexOf("\r\n\r\n");
+        if (headerEnd < 0) return;
+
+        int contentLength = -1;
+        for (const QByteArray &header : m_input.left(headerEnd).split('\n')) {
+            const QByteArray trimmed = header.trimmed();
+            if (trimmed.toLower().startsWith("content-length:")) {
+                contentLength = trimmed.mid(int(sizeof("content-length:")) - 1).trimmed().toInt();
+            }
+        }
+
+        const int contentStart = headerEnd + 4;
+        if (contentLength < 0) {
+            qCDebug(KDEV_SOURCEINFO) << "LSP message without Content-Length, skipped";
+            m_input.remove(0, contentStart);
+            continue;
+        }
+        if (m_input.size() < contentStart + contentLength) return;
+
+        const QJsonDocument json = QJsonDocument::fromJson(m_input.mid(contentStart, contentLength));
+        m_input.remove(0, contentStart + contentLength);
+
+        if (json.isObject()) {
+            handleMessage(json.object());
+        } else {
+            qCDebug(KDEV_SOURCEINFO) << "Malformed LSP message skipped";
+        }
+    }
+}
+
+void LspServer::handleMessage(const QJsonObject& message)
+{
+    const QString method = message.value(QStringLiteral("method")).toString();
+    const QJsonValue id = message.value(QStringLiteral("id"));
+    const QJsonObject params = message.value(QStringLiteral("params")).toObject();
+
+    // Responses to our own requests, nothing to do with them
+    if (method.isEmpty()) return;
+
+    QJsonValue result;
+    if (method == QLatin1String("initialize")) {
+        result = initialize(params);
+    } else if (method == QLatin1String("shutdown")) {
+        m_shutdown = true;
+    } else if (method == QLatin1String("exit")) {
+        QCoreApplication::exit(m_shutdown ? 0 : 1);
+    } else if (method == QLatin1String("textDocument/didOpen")) {
+        didOpen(params);
+    } else if (method == QLatin1String("textDocument/didChange")) {
+        didChange(params);
+    } else if (method == QLatin1String("textDocument/didSave")) {
+        didSave(params);
+    } else if (method == QLatin1String("textDocument/didClose")) {
+        didClose(params);
+    } else if (method == QLatin1String("textDocument/inlayHint")) {
+        result = inlayHint(params);
+    } else if (!id.isUndefined()) {
+        const QJsonObject error{
+            { QStringLiteral("code"), METHOD_NOT_FOUND },
+            { QStringLiteral("message"), QStringLiteral("Unsupported method %1").arg(method) },
+        };
+        send({ { QStringLiteral("id"), id }, { QStringLiteral("error"), error } });
+        return;
+    }
+
+    // Notifications are not answered
+    if (id.isUndefined()) return;
+
+    send({ { QStringLiteral("id"), id }, { QStringLiteral("result"), result } });
+}
+
+QJsonValue LspServer::initialize(const QJsonObject& params)
+{
+    const QJsonObject workspace = params.value(QStringLiteral("capabilities")).toObject().value(QStringLiteral("workspace")).toObject();
+    m_refreshSupported = workspace.value(QStringLiteral("inlayHint")).toObject().value(QStringLiteral("refreshSupport")).toBool();
+
+    const QJsonObject textDocumentSync{
+        { QStringLiteral("openClose"), true },
+        { QStringLiteral("change"), INCREMENTAL_SYNC },
+        { QStringLiteral("save"), true },
+    };
+    const QJsonObject capabilities{
+        { QStringLiteral("textDocumentSync"), textDocumentSync },
+        { QStringLiteral("inlayHintProvider"), true },
+    };
+    return QJsonObject{
+        { QStringLiteral("capabilities"), capabilities },
+        { QStringLiteral("serverInfo"), QJsonObject{ { QStringLiteral("name"), QStringLiteral("kdevsourceinfo-lsp") } } },
+    };
+}
+
+void LspServer::didOpen(const QJsonObject& params)
+{
+    const QString uri = documentUri(params);
+
+    Document *&document = m_documents[uri];
+    if (!document) {
+        document = new Document;
+    }
+    document->text.setText(params.value(QStringLiteral("textDocument")).toObject().value(QStringLiteral("text")).toString());
+    document->hints.clear();
+
+    // Use what the DUChain already knows about the file until it is parsed again
+    rebuild(document, IndexedString(QUrl(uri)));
+    parse(uri);
+}
+
+void LspServer::didChange(const QJsonObject& params)
+{
+    Document *document = m_documents.value(documentUri(params));
+    if (!document) return;
+
+    // The DUChain is only updated on save, until then the hints just move with the text
+    for (const QJsonValue &change : params.value(QStringLiteral("contentChanges")).toArray()) {
+        const QJsonObject object = change.toObject();
+        const QString text = object.value(QStringLiteral("text")).toString();
+        if (object.contains(QStringLiteral("range"))) {
+            applyEdit(document, toRange(object.value(QStringLiteral("range"))), text);
+        } else {
+            // Nothing the builder finds can be placed in a replaced text
+            document->text.setText(text);
+            document->hints.clear();
+            document->builder.reset();
+        }
+    }
+}
+
+void LspServer::didSave(const QJsonObject& params)
+{
+    const QString uri = documentUri(params);
+    if (m_documents.contains(uri)) {
+        parse(uri);
+    }
+}
+
+void LspServer::didClose(const QJsonObject& params)
+{
+    delete m_documents.take(documentUri(params));
+}
+
+QJsonValue LspServer::inlayHint(const QJsonObject& params)
+{
+    QJsonArray result;
+
+    Document *document = m_documents.value(documentUri(params));
+    if (!document) return result;
+
+    const KTextEditor::Range range = toRange(params.value(QStringLiteral("range")));
+    document->requestedLines = KTextEditor::Range(range.start().line(), 0, range.end().line(), 0);
+
+    for (auto iter = document->hints.lowerBound(range.start()); iter != document->hints.end() && iter.key() <= range.end(); ++iter) {
+        QJsonObject hint{
+            { QStringLiteral("position"), fromCursor(iter.key()) },
+            { QStringLiteral("label"), iter->label },
+            { QStringLiteral("paddingLeft"), iter->paddingLeft },
+            { QStringLiteral("paddingRight"), iter->paddingRight },
+        };
+        if (!iter->toolTip.isEmpty()) {
+            hint.insert(QStringLiteral("tooltip"), iter->toolTip);
+        }
+        result.append(hint);
+    }
+    return result;
+}
+
+void LspServer::updateReady(const IndexedString& url, const ReferencedTopDUContext& /*topContext*/)
+{
+    for (auto iter = m_documents.begin(); iter != m_documents.end(); ++iter) {
+        if (IndexedString(QUrl(iter.key())) == url) {
+            rebuild(*iter, url);
+        }
+    }
+}
+
+void LspServer::continueRebuilds()
+{
+    bool inProgress = false;
+    bool hintsChanged = false;
+
+    for (Document *document : qAsConst(m_documents)) {
+        if (!document->builder) continue;
+
+        switch (document->builder->step(m_config.rebuildStepBudgetUs)) {
+        case NoteBuilder::Status::Aborted:
+            // The top context changed, the update arrives next
+            document->builder.reset();
+            break;
+
+        case NoteBuilder::Status::Finished:
+            setHints(document, *document->builder->notes());
+            for (const auto &edit : qAsConst(document->builderEdits)) {
+                shiftHints(document->hints, edit.range, edit.text);
+            }
+            document->builder.reset();
+            hintsChanged = true;
+            break;
+
+        case NoteBuilder::Status::InProgress:
+            inProgress = true;
+            break;
+        }
+    }
+
+    if (hintsChanged && m_refreshSupported) {
+        send({ { QStringLiteral("id"), m_nextRequestId++ }, { QStringLiteral("method"), QStringLiteral("workspace/inlayHint/refresh") } });
+    }
+    if (inProgress) {
+        m_rebuildTimer.start(0);
+    }
+}
+
+void LspServer::parse(const QString& uri)
+{
+    // The parser reads the file from the disk, unsaved changes are not seen
+    ICore::self()->languageController()->backgroundParser()->addDocument(IndexedString(QUrl(uri)),
+                                                                         TopDUContext::AllDeclarationsContextsAndUses,
+                                                                         BackgroundParser::BestPriority);
+}
+
+void LspServer::rebuild(Document* document, const IndexedString& url)
+{
+    document->builder.reset();
+    document->builderText = document->text;
+    document->builderEdits.clear();
+
+    document->builder.reset(new NoteBuilder(m_config, m_typeStrings, document->builderText));
+    document->builder->setPriorityLines(document->requestedLines);
+    if (!document->builder->start(url)) {
+        document->builder.reset();
+        return;
+    }
+    m_rebuildTimer.start(0);
+}
+
+void LspServer::applyEdit(Document* document, const KTextEditor::Range& range, const QString& text)
+{
+    document->text.replace(range, text);
+    shiftHints(document->hints, range, text);
+
+    if (document->builder) {
+        document->builderEdits.append({ range, text });
+    }
+}
+
+void LspServer::shiftHints(QMap<KTextEditor::Cursor, Hint>& hints, const KTextEditor::Range& range, const QString& text)
+{
+    const int insertedLines = text.count(QLatin1Char('\n'));
+    const int lastLineLength = text.size() - text.lastIndexOf(QLatin1Char('\n')) - 1;
+    const int lineDelta = insertedLines - (range.end().line() - range.start().line());
+
+    // Hints in the replaced text are dropped, the following ones shifted
+    QVector<QPair<KTextEditor::Cursor, Hint>> moved;
+    auto iter = hints.lowerBound(range.start());
+    while (iter != hints.end()) {
+        KTextEditor::Cursor position = iter.key();
+        if (position >= range.end()) {
+            if (position.line() == range.end().line()) {
+                const int column = position.column() - range.end().column() + lastLineLength;
+                position = KTextEditor::Cursor(range.start().line() + insertedLines, insertedLines ? column : column + range.start().column());
+            } else {
+                position.setLine(position.line() + lineDelta);
+            }
+            moved.append(qMakePair(position, iter.value()));
+        }
+        iter = hints.erase(iter);
+    }
+    for (const auto &hint : qAsConst(moved)) {
+        hints.insert(hint.first, hint.second);
+    }
+}
+
+void LspServer::setHints(Document* document, const NoteStore& notes)
+{
+    document->hints.clear();
+    for (const auto &position : notes.positions()) {
+        const InlineNoteBase *note = notes.find(position);
+        Hint hint{ note->text(), note->toolTip(), false, false };
+        if (hint.label.isEmpty()) continue; // Purely graphical notes can not be shown as hints
+
+        // The padding comes from the outer notes of a group
+        const QVector<const InlineNoteBase*> grouped = notes.findAll(position);
+        if (const GenericTextNote *first = dynamic_cast<const GenericTextNote*>(grouped.first())) {
+            hint.paddingLeft = first->spaceLeft();
+        }
+        if (const GenericTextNote *last = dynamic_cast<const GenericTextNote*>(grouped.last())) {
+            hint.paddingRight = last->spaceRight();
+        }
+        document->hints.insert(position, hint);
+    }
+}
+
+void LspServer::send(const QJsonObject& message)
+{
+    QJsonObject object = message;
+    object.insert(QStringLiteral("jsonrpc"), QStringLiteral("2.0"));
+
+    const QByteArray content = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    m_output.write("Content-Length: " + QByteArray::number(content.size()) + "\r\n\r\n");
+    m_output.write(content);
+    m_output.flush();
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef LSPSERVER_H
+#define LSPSERVER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+#include <QMap>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVector>
+
+#include <KTextEditor/Cursor>
+#include <KTextEditor/Range>
+
+#include "sourceinfoconfig.h"
+#include "textsource.h"
+#include "typestringcache.h"
+
+
+class QSocketNotifier;
+
+class NoteBuilder;
+class NoteStore;
+
+namespace KDevelop {
+class IndexedString;
+class ReferencedTopDUContext;
+}
+
+
+/**
+ * Language server answering textDocument/inlayHint with the same notes the
+ * plugin shows in KDevelop, over stdin and stdout.
+ *
+ * The DUChain comes from the KDevelop core running without UI in the same
+ * process, see HeadlessCore, so documents are parsed from disk when they
+ * are opened and saved. Edits in between are applied to the text and the
+ * hints kept for every document, so range requests while typing and
+ * scrolling are only a lookup. The hints are recomputed in steps from the
+ * event loop once the parse finishes, passes that exceed their budget are
+ * limited to the range requested last.
+ *
+ * The builder works with a copy of the text taken when it started, edits
+ * made while it runs are applied to its hints once it finishes.
+ */
+class LspServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LspServer(QObject* parent = nullptr);
+    ~LspServer() override;
+
+    void start();
+
+private Q_SLOTS:
+    void readInput();
+    void updateReady(const KDevelop::IndexedString& url, const KDevelop::ReferencedTopDUContext& topContext);
+    void continueRebuilds();
+
+private:
+    struct Hint {
+        QString label;
+        QString toolTip;
+        bool paddingLeft;
+        bool paddingRight;
+    };
+
+    struct Edit {
+        KTextEditor::Range range;
+        QString text;
+    };
+
+    struct Document {
+        FileTextSource text;
+        QMap<KTextEditor::Cursor, Hint> hints;
+        KTextEditor::Range requestedLines = KTextEditor::Range::invalid(); // Of the last inlayHint request
+
+        QSharedPointer<NoteBuilder> builder;
+        FileTextSource builderText; // The text when the builder started
+        QVector<Edit> builderEdits; // Made since the builder started
+    };
+
+    void handleMessage(const QJsonObject& message);
+
+    QJsonValue initialize(const QJsonObject& params);
+    void didOpen(const QJsonObject& params);
+    void didChange(const QJsonObject& params);
+    void didSave(const QJsonObject& params);
+    void didClose(const QJsonObject& params);
+    QJsonValue inlayHint(const QJsonObject& params);
+
+    void parse(const QString& uri);
+    void rebuild(Document* document, const KDevelop::IndexedString& url);
+    void applyEdit(Document* document, const KTextEditor::Range& range, const QString& text);
+    static void shiftHints(QMap<KTextEditor::Cursor, Hint>& hints, const KTextEditor::Range& range, const QString& text);
+    void setHints(Document* document, const NoteStore& notes);
+
+    void send(const QJsonObject& message);
+
+private:
+    QSocketNotifier* m_inputNotifier = nullptr;
+    QByteArray m_input;
+    QFile m_output;
+
+    QHash<QString, Document*> m_documents; // By uri
+    bool m_refreshSupported = false;
+    bool m_shutdown = false;
+    int m_nextRequestId = 1;
+
+    SourceInfoConfig m_config;
+    TypeStringCache m_typeStrings;
+    QTimer m_rebuildTimer;
+};
+
+#endif // LSPSERVER_H
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+
+#include <QApplication>
+#include <QCommandLineParser>
+
+#include "headlesscore.h"
+#include "lspserver.h"
+
+
+int main(int argc, char** argv)
+{
+    // The KDevelop core needs a QApplication even when running without UI
+    QApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("kdevsourceinfo-lsp"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Language server providing the inlay hints of the KDevelop source info plugin over stdio"));
+    parser.addHelpOption();
+    parser.addOption({ QStringLiteral("session"), QStringLiteral("KDevelop session whose projects provide the include paths, without it files are parsed without any project configuration"), QStringLiteral("name") });
+    parser.process(app);
+
+    if (!HeadlessCore::initialize(parser.value(QStringLiteral("session")))) {
+        fprintf(stderr, "Failed to start the KDevelop core\n");
+        return 1;
+    }
+
+    int result;
+    {
+        LspServer server;
+        server.start();
+        result = app.exec();
+    }
+
+    HeadlessCore::shutdown();
+    return result;
+}
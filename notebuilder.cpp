@@ -0,0 +1,1463 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <language/duchain/duchainlock.h>
+#include <language/duchain/duchainutils.h>
+#include <language/duchain/indexeddeclaration.h>
+#include <language/duchain/parsingenvironment.h>
+#include <language/duchain/topducontext.h>
+#include <language/duchain/ducontext.h>
+#include <language/duchain/declaration.h>
+#include <language/duchain/classdeclaration.h>
+#include <language/duchain/classfunctiondeclaration.h>
+#include <language/duchain/classmemberdeclaration.h>
+#include <language/duchain/functiondeclaration.h>
+#include <language/duchain/functiondefinition.h>
+#include <language/duchain/use.h>
+#include <language/duchain/types/enumeratortype.h>
+#include <language/duchain/types/functiontype.h>
+#include <language/duchain/types/indexedtype.h>
+#include <language/duchain/types/arraytype.h>
+#include <language/duchain/types/referencetype.h>
+#include <language/duchain/types/structuretype.h>
+#include <language/duchain/types/typealiastype.h>
+#include <language/duchain/types/typeutils.h>
+
+#include <KLocalizedString>
+#include <KTextEditor/Range>
+
+#include "coveragedata.h"
+#include "notebuilder.h"
+#include "notescanner.h"
+#include "optremarkdata.h"
+#include "profiledata.h"
+#include "sourceinfoconfig.h"
+#include "symbolsizedata.h"
+#include "textsource.h"
+#include "typestringcache.h"
+
+#include "notes/allocationnote.h"
+#include "notes/generictextnote.h"
+#include "notes/membersizenote.h"
+
+#include <debug.h>
+
+
+using namespace KDevelop;
+
+
+namespace {
+
+// Compact execution count, 1234567 becomes 1.2M
+QString formatCount(quint64 count)
+{
+    static const char suffixes[] = { 'k', 'M', 'G', 'T', 'P' };
+
+    if (count < 1000) {
+        return QString::number(count);
+    }
+
+    double value = count;
+    int suffix = -1;
+    while (value >= 999.95 && suffix + 1 < int(sizeof(suffixes))) {
+        value /= 1000.0;
+        suffix++;
+    }
+    return QString::number(value, 'f', value < 10.0 ? 1 : 0) + QLatin1Char(suffixes[suffix]);
+}
+
+// Compact size in bytes, 12345 becomes 12.1 KiB
+QString formatBytes(quint64 bytes)
+{
+    if (bytes < 1024) {
+        return i18nc("size in bytes", "%1 B", bytes);
+    }
+    if (bytes < 1024 * 1024) {
+        return i18nc("size in kibibytes", "%1 KiB", QString::number(bytes / 1024.0, 'f', 1));
+    }
+    return i18nc("size in mebibytes", "%1 MiB", QString::number(bytes / (1024.0 * 1024.0), 'f', 1));
+}
+
+// Components of the qualified name without template arguments, anonymous and inline namespaces
+QStringList qualifiedName(const Declaration* declaration)
+{
+    QStringList name;
+    const QualifiedIdentifier qualifiedIdentifier = declaration->qualifiedIdentifier();
+    for (int i = 0; i < qualifiedIdentifier.count(); i++) {
+        const QString component = qualifiedIdentifier.at(i).identifier().str();
+        if (component.isEmpty() || component == QLatin1String("__1") || component == QLatin1String("__cxx11")) continue;
+        name.append(component);
+    }
+    return name;
+}
+
+// Headers of the standard library have no suffix
+bool isHeader(const QString& path)
+{
+    static const QStringList suffixes = {
+        QString(), QStringLiteral("h"), QStringLiteral("hh"), QStringLiteral("hpp"), QStringLiteral("hxx"), QStringLiteral("inl")
+    };
+    return suffixes.contains(QFileInfo(path).suffix(), Qt::CaseInsensitive);
+}
+
+// Body of a function definition. Depending on the language plugin the internal context of the definition is
+// either the body itself, or the argument context that the body is nested in or imports it.
+const DUContext* functionBody(const Declaration* definition)
+{
+    const DUContext* context = definition->internalContext();
+    if (!context || context->type() != DUContext::Function) return context;
+
+    for (const DUContext* child : context->childContexts()) {
+        if (child->type() == DUContext::Other) return child;
+    }
+    for (const DUContext* importer : context->importers()) {
+        if (importer->type() == DUContext::Other) return importer;
+    }
+    return nullptr;
+}
+
+// Uses in the context and all the contexts nested in it
+int nestedUseCount(const DUContext* ctx)
+{
+    int count = ctx->usesCount();
+    for (const DUContext* child : ctx->childContexts()) {
+        count += nestedUseCount(child);
+    }
+    return count;
+}
+
+}
+
+
+constexpr qint64 NoteBuilder::MAX_LOCK_HOLD_US;
+constexpr double NoteBuilder::PROFILE_MIN_PERCENT;
+constexpr int NoteBuilder::PROFILE_HEAT_STEPS;
+constexpr int NoteBuilder::MAX_REMARK_MESSAGES;
+constexpr int NoteBuilder::MAX_COPY_CHECK_DEPTH;
+
+
+// State shared by the threads gathering one file in gatherParallel()
+struct NoteBuilder::ParallelGather {
+    NoteBuilder* owner = nullptr;
+
+    QVector<IndexedDUContext> units; // Subtrees to gather
+    QSet<IndexedDUContext> splitContexts; // Units whose children are units of their own
+    QAtomicInt nextUnit;
+    QSharedPointer<const QAtomicInt> cancelled;
+
+    // Summed over the threads, so that the budgets apply to the file as a whole
+    QAtomicInteger<qint64> passCostsNs[PassCount];
+    QAtomicInt passModes[PassCount];
+
+    QMutex mutex;
+    QWaitCondition idle;
+    int active = 0; // Threads that took part and did not finish yet
+    bool aborted = false;
+
+    // By unit, so they are merged in the same order whichever thread gathered them. Sized before the threads
+    // start, every unit is written only by the thread that gathered it.
+    struct UnitResult {
+        QSharedPointer<NoteStore> notes;
+        QVector<EnumeratorRecord> enumerators;
+        QVector<CallSiteRecord> callSites;
+    };
+    QVector<UnitResult> results;
+
+    bool isCancelled() const
+    {
+        return cancelled && cancelled->loadAcquire();
+    }
+};
+
+class NoteBuilder::GatherTask : public QRunnable
+{
+public:
+    explicit GatherTask(QSharedPointer<ParallelGather> shared)
+        : m_shared(shared)
+    {
+    }
+
+    void run() override
+    {
+        NoteBuilder::gatherUnits(*m_shared);
+    }
+
+private:
+    // Tasks that start after all units were taken may outlive the builder, but not the shared state
+    QSharedPointer<ParallelGather> m_shared;
+};
+
+
+NoteBuilder::NoteBuilder(const SourceInfoSettings& config, TypeStringCache& typeStrings, const TextSource& text)
+    : m_config(config)
+    , m_typeStrings(typeStrings)
+    , m_text(text)
+    , m_passModes(PassCount, PassMode::Full)
+    , m_passCostsNs(PassCount, 0)
+{
+}
+
+NoteBuilder::~NoteBuilder()
+{
+}
+
+bool NoteBuilder::start(const IndexedString& url)
+{
+    m_notes = QSharedPointer<NoteStore>::create();
+    m_url = url;
+
+    DUChainReadLocker lock;
+    TopDUContext* top = DUChainUtils::standardContextForUrl(url.toUrl());
+    if (!top || !top->parsingEnvironmentFile()) {
+        return false;
+    }
+
+    m_top = IndexedTopDUContext(top);
+    m_revision = top->parsingEnvironmentFile()->modificationRevision();
+    m_pendingContexts = { IndexedDUContext(top) };
+    m_deferredContexts.clear();
+    m_hasCurrentContext = false;
+    m_prioritizing = m_priorityLines.isValid();
+    m_passCostsNs.fill(0);
+    lock.unlock();
+
+    // Does not depend on the DUChain, done right away
+    addProfileNotes();
+    addCoverageNotes();
+    addOptRemarkNotes();
+
+    return true;
+}
+
+NoteBuilder::Status NoteBuilder::step(qint64 budgetUs)
+{
+    if (!isGatheringFinished()) {
+        const bool prioritizing = m_prioritizing;
+        if (!gatherChunk(qMin(budgetUs, MAX_LOCK_HOLD_US))) {
+            qCDebug(KDEV_SOURCEINFO) << "Top context of" << m_url.str() << "changed while computing notes";
+            return Status::Aborted;
+        }
+
+        // Notes on the priority lines are shown right away, the rest is matched with the text in one sweep once everything is gathered
+        if (prioritizing && !m_deferScanning) {
+            scanGathered(-1);
+        }
+    } else if (!m_deferScanning) {
+        scanGathered(budgetUs);
+    }
+
+    return isFinished() ? Status::Finished : Status::InProgress;
+}
+
+bool NoteBuilder::gatherParallel(int threads, QSharedPointer<const QAtomicInt> cancelled)
+{
+    auto shared = QSharedPointer<ParallelGather>::create();
+    shared->owner = this;
+    shared->cancelled = cancelled;
+    if (shared->isCancelled()) {
+        return false;
+    }
+
+    for (int pass = 0; pass < PassCount; pass++) {
+        shared->passCostsNs[pass].store(m_passCostsNs[pass]);
+        shared->passModes[pass].store(int(m_passModes[pass]));
+    }
+
+    {
+        DUChainReadLocker lock;
+
+        TopDUContext* top = m_top.data();
+        if (!top || !top->parsingEnvironmentFile() || top->parsingEnvironmentFile()->modificationRevision() != m_revision) {
+            return false;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // Split the tree level by level until there are enough subtrees. Only the structure is walked here, the
+        // declarations and uses of the contexts that get split are gathered by the threads too.
+        QVector<DUContext*> units = { top };
+        while (units.size() < threads * UNITS_PER_THREAD) {
+            QVector<DUContext*> nextLevel;
+            bool split = false;
+            for (DUContext* ctx : units) {
+                const auto &childContexts = ctx->childContexts();
+                if (childContexts.isEmpty()) {
+                    nextLevel.append(ctx);
+                    continue;
+                }
+
+                shared->units.append(IndexedDUContext(ctx));
+                shared->splitContexts.insert(IndexedDUContext(ctx));
+                for (DUContext* child : childContexts) {
+                    nextLevel.append(child);
+                }
+                split = true;
+            }
+            units = nextLevel;
+            if (!split) break;
+        }
+
+        for (DUContext* ctx : units) {
+            shared->units.append(IndexedDUContext(ctx));
+        }
+        shared->results.resize(shared->units.size());
+
+        lock.unlock();
+        lockHoldHistogram().record(timer.nsecsElapsed() / 1000);
+    }
+
+    // The calling thread takes part too, so the gathering progresses even if the pool is busy
+    for (int i = 1; i < threads; i++) {
+        gatherPool().start(new GatherTask(shared));
+    }
+    gatherUnits(*shared);
+
+    QMutexLocker lock(&shared->mutex);
+    while (shared->active > 0) {
+        shared->idle.wait(&shared->mutex);
+    }
+
+    if (shared->aborted) {
+        return false;
+    }
+
+    // Notes are merged in position order by the store, notes at the same position are grouped in unit order. Records
+    // are sorted before matching them with the text.
+    for (const auto &result : qAsConst(shared->results)) {
+        m_notes->merge(*result.notes);
+        m_enumerators += result.enumerators;
+        m_callSites += result.callSites;
+    }
+    for (int pass = 0; pass < PassCount; pass++) {
+        m_passCostsNs[pass] = shared->passCostsNs[pass].load();
+        m_passModes[pass] = PassMode(shared->passModes[pass].load());
+    }
+
+    m_pendingContexts.clear();
+    m_deferredContexts.clear();
+    m_hasCurrentContext = false;
+    m_prioritizing = false;
+
+    return true;
+}
+
+void NoteBuilder::gatherUnits(ParallelGather& shared)
+{
+    {
+        QMutexLocker lock(&shared.mutex);
+        if (shared.nextUnit.load() >= shared.units.size()) return;
+        shared.active++;
+    }
+
+    // The owner waits for all active threads, so it can be used from here on
+    const NoteBuilder* owner = shared.owner;
+    NoteBuilder worker(owner->m_config, owner->m_typeStrings, owner->m_text);
+    worker.m_url = owner->m_url;
+    worker.m_top = owner->m_top;
+    worker.m_revision = owner->m_revision;
+    worker.m_priorityLines = owner->m_priorityLines;
+    worker.m_passModes = owner->m_passModes;
+    worker.m_parallelGather = &shared;
+
+    ParallelGather::UnitResult* results = shared.results.data();
+    bool aborted = false;
+    for (int i = shared.nextUnit.fetchAndAddRelaxed(1); i < shared.units.size(); i = shared.nextUnit.fetchAndAddRelaxed(1)) {
+        worker.m_notes = QSharedPointer<NoteStore>::create();
+        if (!worker.gatherSubtree(shared.units.at(i))) {
+            aborted = true;
+            shared.nextUnit.fetchAndStoreRelaxed(shared.units.size());
+            break;
+        }
+
+        results[i].notes = worker.m_notes;
+        results[i].enumerators.swap(worker.m_enumerators);
+        results[i].callSites.swap(worker.m_callSites);
+    }
+
+    QMutexLocker lock(&shared.mutex);
+    shared.aborted |= aborted;
+    shared.active--;
+    shared.idle.wakeAll();
+}
+
+bool NoteBuilder::gatherSubtree(const IndexedDUContext& root)
+{
+    m_pendingContexts = { root };
+    m_hasCurrentContext = false;
+
+    // In the same bounded chunks as a sequential walk, parse jobs waiting for the write lock get it in between
+    while (!isGatheringFinished()) {
+        if (m_parallelGather->isCancelled() || !gatherChunk(MAX_LOCK_HOLD_US)) {
+            return false;
+        }
+        QThread::yieldCurrentThread();
+    }
+
+    return true;
+}
+
+QSharedPointer<NoteStore> NoteBuilder::build(const IndexedString& url, const QAtomicInt* cancelled)
+{
+    if (!start(url)) {
+        return QSharedPointer<NoteStore>();
+    }
+
+    Status status;
+    do {
+        if (cancelled && cancelled->load()) {
+            return QSharedPointer<NoteStore>();
+        }
+        status = step(MAX_LOCK_HOLD_US);
+    } while (status == Status::InProgress);
+
+    return (status == Status::Finished) ? m_notes : QSharedPointer<NoteStore>();
+}
+
+void NoteBuilder::setPriorityLines(const KTextEditor::Range& lines)
+{
+    m_priorityLines = lines;
+}
+
+KTextEditor::Range NoteBuilder::priorityLines() const
+{
+    return m_priorityLines;
+}
+
+bool NoteBuilder::priorityLinesDone() const
+{
+    return !m_prioritizing || isFinished();
+}
+
+void NoteBuilder::setDeferScanning(bool defer)
+{
+    m_deferScanning = defer;
+}
+
+void NoteBuilder::takeRecords(QVector<EnumeratorRecord>& enumerators, QVector<CallSiteRecord>& callSites)
+{
+    enumerators.clear();
+    callSites.clear();
+
+    // The passes may have been limited since the records were gathered
+    for (const auto &record : qAsConst(m_enumerators)) {
+        if (isPassEnabledOnLine(EnumValuesPass, record.position.line())) enumerators.append(record);
+    }
+    for (const auto &record : qAsConst(m_callSites)) {
+        if (isPassEnabledOnLine(CallSiteArgumentsPass, record.position.line())) callSites.append(record);
+    }
+    m_enumerators.clear();
+    m_callSites.clear();
+
+    NoteScanner::sortRecords(enumerators, callSites);
+}
+
+void NoteBuilder::addScannedNotes(const QVector<ScannedNote>& notes)
+{
+    for (const auto &note : notes) {
+        m_notes->insert(note.position, createNote(note));
+    }
+}
+
+InlineNoteBase* NoteBuilder::createNote(const ScannedNote& note)
+{
+    const int column = note.position.column();
+    switch (note.kind) {
+        case ScannedNote::EnumValue:
+            return new GenericTextNote(column, QString::fromUtf8(" = ") + note.text, Qt::gray, QBrush(), false, 0.0);
+        case ScannedNote::ArgumentName: {
+            GenericTextNote *textNote = new GenericTextNote(column, note.text + ":", QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0);
+            textNote->setSpaceRight(true);
+            return textNote;
+        }
+        case ScannedNote::DefaultValues:
+            return new GenericTextNote(column, note.text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0);
+        case ScannedNote::ArgumentCopy: {
+            GenericTextNote *textNote = new GenericTextNote(column, note.text, QColor(0x8a5a00), QBrush(QColor(0xfff3d6)), true, 4.0);
+            textNote->setSpaceRight(true);
+            return textNote;
+        }
+        case ScannedNote::VirtualCall: {
+            GenericTextNote *textNote = new GenericTextNote(column, i18nc("marker of a virtual call", "virt"), QColor(0x806090), QBrush(QColor(0xf3eef8)), true, 4.0);
+            textNote->setToolTip(i18n("Virtual call, dispatched at run time"));
+            textNote->setSpaceRight(true);
+            return textNote;
+        }
+        case ScannedNote::FinalCall: {
+            GenericTextNote *textNote = new GenericTextNote(column, i18nc("marker of a virtual call of a final method", "final"), QColor(0x407040), QBrush(QColor(0xeef6ee)), true, 4.0);
+            textNote->setToolTip(i18n("Virtual call of a final method, the compiler can call it directly"));
+            textNote->setSpaceRight(true);
+            return textNote;
+        }
+        case ScannedNote::Allocation:
+            return new AllocationNote(column, note.text, note.loopDepth);
+        case ScannedNote::CalleeSize: {
+            GenericTextNote *textNote = new GenericTextNote(column, note.text, QColor(0x708070), QBrush(QColor(0xf2f5f2)), true, 4.0);
+            textNote->setToolTip(i18n("Size of the called function and where it is defined"));
+            return textNote;
+        }
+    }
+    return nullptr;
+}
+
+void NoteBuilder::setPassModes(const QVector<PassMode>& modes)
+{
+    Q_ASSERT(modes.size() == PassCount);
+    m_passModes = modes;
+}
+
+QVector<NoteBuilder::PassMode> NoteBuilder::passModes() const
+{
+    return m_passModes;
+}
+
+qint64 NoteBuilder::passCostUs(Pass pass) const
+{
+    return m_passCostsNs[pass] / 1000;
+}
+
+bool NoteBuilder::isDegraded() const
+{
+    return m_passModes.count(PassMode::Full) != PassCount;
+}
+
+QString NoteBuilder::passName(Pass pass)
+{
+    switch (pass) {
+        case EnumValuesPass:              return i18n("Enum values");
+        case AutoTypePass:                return i18n("Auto types");
+        case CallSiteArgumentsPass:       return i18n("Argument names at call sites");
+        case DefinitionDefaultValuesPass: return i18n("Default values at definitions");
+        case ProfilePass:                 return i18n("Profile hotspots");
+        case CoveragePass:                return i18n("Execution counts");
+        case OptRemarkPass:               return i18n("Optimization remarks");
+        case SymbolSizePass:              return i18n("Code size");
+        case PassCount:                   break;
+    }
+    return QString();
+}
+
+QSharedPointer<NoteStore> NoteBuilder::notes() const
+{
+    return m_notes;
+}
+
+IndexedString NoteBuilder::url() const
+{
+    return m_url;
+}
+
+ModificationRevision NoteBuilder::revision() const
+{
+    return m_revision;
+}
+
+Histogram& NoteBuilder::lockHoldHistogram()
+{
+    static Histogram histogram;
+    return histogram;
+}
+
+QThreadPool& NoteBuilder::gatherPool()
+{
+    static QThreadPool pool;
+    return pool;
+}
+
+bool NoteBuilder::isFinished() const
+{
+    return isGatheringFinished() && (m_deferScanning || (m_enumerators.isEmpty() && m_callSites.isEmpty() && !m_scanner));
+}
+
+bool NoteBuilder::isGatheringFinished() const
+{
+    return !m_hasCurrentContext && m_pendingContexts.isEmpty() && m_deferredContexts.isEmpty();
+}
+
+bool NoteBuilder::isPassEnabled(Pass pass) const
+{
+    return m_passModes[pass] != PassMode::Disabled;
+}
+
+bool NoteBuilder::needsWholeTree() const
+{
+    for (int pass = 0; pass < PassCount; pass++) {
+        // Computed from the build data in start()
+        if (pass == ProfilePass || pass == CoveragePass || pass == OptRemarkPass) continue;
+
+        if (m_passModes[pass] == PassMode::Full) return true;
+    }
+    return false;
+}
+
+bool NoteBuilder::isPassEnabledOnLine(Pass pass, int line) const
+{
+    switch (m_passModes[pass]) {
+        case PassMode::Full:              return true;
+        case PassMode::PriorityLinesOnly: return line >= m_priorityLines.start().line() && line <= m_priorityLines.end().line();
+        case PassMode::Disabled:          return false;
+    }
+    return false;
+}
+
+void NoteBuilder::addPassCost(Pass pass, qint64 nanoseconds)
+{
+    qint64 costNs;
+    if (m_parallelGather) {
+        // Degradations by the other threads gathering the file apply here too
+        costNs = m_parallelGather->passCostsNs[pass].fetchAndAddRelaxed(nanoseconds) + nanoseconds;
+        m_passModes[pass] = qMax(m_passModes[pass], PassMode(m_parallelGather->passModes[pass].loadAcquire()));
+    } else {
+        m_passCostsNs[pass] += nanoseconds;
+        costNs = m_passCostsNs[pass];
+    }
+
+    const qint64 budgetUs = m_config.passBudgetMs * 1000;
+    const qint64 costUs = costNs / 1000;
+    PassMode &mode = m_passModes[pass];
+
+    // Limiting the pass to the priority lines should make it cheap, give it a second budget before giving up completely
+    if (mode == PassMode::Full && costUs > budgetUs) {
+        mode = m_priorityLines.isValid() ? PassMode::PriorityLinesOnly : PassMode::Disabled;
+        qCDebug(KDEV_SOURCEINFO) << "Pass" << pass << "took" << costUs << "us in" << m_url.str() << ", degraded to" << (int) mode;
+    } else if (mode == PassMode::PriorityLinesOnly && costUs > 2 * budgetUs) {
+        mode = PassMode::Disabled;
+        qCDebug(KDEV_SOURCEINFO) << "Pass" << pass << "took" << costUs << "us in" << m_url.str() << ", disabled";
+    }
+
+    if (m_parallelGather) {
+        int shared = m_parallelGather->passModes[pass].loadAcquire();
+        while (shared < int(mode) && !m_parallelGather->passModes[pass].testAndSetOrdered(shared, int(mode), shared)) {
+        }
+    }
+}
+
+void NoteBuilder::addProfileNotes()
+{
+    const QSharedPointer<const ProfileData> profile = m_config.profile;
+    if (!profile || !m_config.showProfile || !isPassEnabled(ProfilePass)) return;
+
+    QElapsedTimer passTimer;
+    passTimer.start();
+
+    const auto lines = profile->lines(m_url.str());
+    qint64 hottest = 0;
+    for (const auto &cost : lines) {
+        hottest = qMax(hottest, cost.inclusive);
+    }
+
+    const double total = profile->totalCost();
+    const int lineCount = m_text.lineCount();
+    for (auto iter = lines.constBegin(); iter != lines.constEnd(); ++iter) {
+        const int line = iter.key();
+        const double inclusive = 100.0 * iter->inclusive / total;
+        if (inclusive < PROFILE_MIN_PERCENT || line >= lineCount) continue;
+        if (!isPassEnabledOnLine(ProfilePass, line)) continue;
+
+        const double self = 100.0 * iter->self / total;
+        const QString text = i18nc("profile note, percentages of samples", "%1% self, %2% total",
+                                   QString::number(self, 'f', 1), QString::number(inclusive, 'f', 1));
+
+        // From pale yellow for the coldest lines to red for the hottest line of the file, in steps so that the lines share few note styles
+        const qreal heat = qRound(PROFILE_HEAT_STEPS * qreal(iter->inclusive) / hottest) / qreal(PROFILE_HEAT_STEPS);
+        const QColor background = QColor::fromHsvF((1.0 - heat) / 6.0, 0.15 + 0.45 * heat, 1.0);
+
+        // Behind the end of the line, where it does not get in the way of the other notes
+        const int column = m_text.line(line).size();
+        GenericTextNote *note = new GenericTextNote(column, text, QColor(0x604030), QBrush(background), true, 4.0, 6.0);
+        note->setSpaceLeft(true);
+        m_notes->insert(KTextEditor::Cursor(line, column), note);
+    }
+
+    addPassCost(ProfilePass, passTimer.nsecsElapsed());
+}
+
+void NoteBuilder::addCoverageNotes()
+{
+    const QSharedPointer<const CoverageData> coverage = m_config.coverage;
+    if (!coverage || !m_config.showCoverage || !isPassEnabled(CoveragePass)) return;
+
+    QElapsedTimer passTimer;
+    passTimer.start();
+
+    const CoverageData::LineCounts lines = coverage->lines(m_url.str());
+    const int lineCount = m_text.lineCount();
+    for (auto iter = lines.constBegin(); iter != lines.constEnd(); ++iter) {
+        const int line = iter.key();
+        if (line >= lineCount || !isPassEnabledOnLine(CoveragePass, line)) continue;
+
+        const quint64 count = iter.value();
+        const QString text = i18nc("coverage note, number of times the line ran", "%1×", formatCount(count));
+
+        // Lines that never ran stand out, the others stay in the background
+        GenericTextNote *note = count == 0
+            ? new GenericTextNote(0, text, QColor(0xb05050), QBrush(QColor(0xfbecec)), true, 4.0, 3.0)
+            : new GenericTextNote(0, text, QColor(0x808080), QBrush(QColor(0xeef6ee)), true, 4.0, 3.0);
+        note->setToolTip(i18np("Ran once", "Ran %1 times", count));
+        note->setSpaceRight(true);
+        m_notes->insert(KTextEditor::Cursor(line, 0), note);
+    }
+
+    addPassCost(CoveragePass, passTimer.nsecsElapsed());
+}
+
+void NoteBuilder::addOptRemarkNotes()
+{
+    const QSharedPointer<const OptRemarkData> optRemarks = m_config.optRemarks;
+    if (!optRemarks || !m_config.showOptRemarks || !isPassEnabled(OptRemarkPass)) return;
+
+    QElapsedTimer passTimer;
+    passTimer.start();
+
+    const QVector<OptRemarkData::Remark> remarks = optRemarks->remarks(m_url.str());
+    const int lineCount = m_text.lineCount();
+
+    // Sorted, so the remarks of one kind from one pass at one position follow each other and become one note
+    int i = 0;
+    while (i < remarks.size()) {
+        const OptRemarkData::Remark& first = remarks.at(i);
+
+        QStringList messages;
+        int count = 0;
+        for (; i < remarks.size(); i++) {
+            const OptRemarkData::Remark& remark = remarks.at(i);
+            if (remark.line != first.line || remark.column != first.column || remark.kind != first.kind ||
+                remark.pass != first.pass || remark.name != first.name) break;
+
+            if (++count <= MAX_REMARK_MESSAGES) {
+                messages.append(remark.function.isEmpty() ? remark.message : i18nc("optimization remark message in function", "%1 (in %2)", remark.message, remark.function));
+            }
+        }
+
+        if (first.line >= lineCount || !isPassEnabledOnLine(OptRemarkPass, first.line)) continue;
+        if (first.kind == OptRemarkData::Kind::Passed && !m_config.showPassedOptRemarks) continue;
+        if (!m_config.optRemarkPasses.isEmpty() && !m_config.optRemarkPasses.contains(first.pass)) continue;
+
+        if (count > MAX_REMARK_MESSAGES) {
+            messages.append(i18np("...and 1 more", "...and %1 more", count - MAX_REMARK_MESSAGES));
+        }
+
+        QColor textColor, background;
+        switch (first.kind) {
+            case OptRemarkData::Kind::Passed:   textColor = QColor(0x407040); background = QColor(0xeef6ee); break;
+            case OptRemarkData::Kind::Missed:   textColor = QColor(0xb05050); background = QColor(0xfbecec); break;
+            case OptRemarkData::Kind::Analysis: textColor = QColor(0x606080); background = QColor(0xeeeef6); break;
+        }
+
+        const int column = qBound(0, first.column, m_text.line(first.line).size());
+        const QString text = i18nc("optimization remark, pass and remark name", "%1: %2", first.pass, first.name);
+        GenericTextNote *note = new GenericTextNote(column, text, textColor, QBrush(background), true, 4.0, 3.0);
+        note->setToolTip(messages.join(QLatin1Char('\n')));
+        note->setSpaceRight(true);
+        m_notes->insert(KTextEditor::Cursor(first.line, column), note);
+    }
+
+    addPassCost(OptRemarkPass, passTimer.nsecsElapsed());
+}
+
+bool NoteBuilder::gatherChunk(qint64 budgetUs)
+{
+    DUChainReadLocker lock;
+
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 deadline = budgetUs * 1000;
+
+    // The lock was released since the last chunk, make sure the contexts we are about to walk still belong to the same revision
+    TopDUContext* top = m_top.data();
+    if (!top || !top->parsingEnvironmentFile() || top->parsingEnvironmentFile()->modificationRevision() != m_revision) {
+        return false;
+    }
+
+    // Always make some progress, even if the budget was already spent waiting for the lock
+    do {
+        if (!m_hasCurrentContext) {
+            if (m_pendingContexts.isEmpty()) {
+                if (m_deferredContexts.isEmpty()) break;
+
+                // Passes limited to the priority lines have nothing to do in the rest of the file
+                if (!needsWholeTree()) {
+                    m_prioritizing = false;
+                    m_deferredContexts.clear();
+                    break;
+                }
+
+                // Everything around the priority lines is done, continue with the rest in the original order
+                m_prioritizing = false;
+                std::reverse(m_deferredContexts.begin(), m_deferredContexts.end());
+                m_pendingContexts = m_deferredContexts;
+                m_deferredContexts.clear();
+            }
+
+            m_currentContext = m_pendingContexts.takeLast();
+            DUContext* ctx = m_currentContext.context();
+            if (!ctx) continue;
+
+            if (m_prioritizing) {
+                const auto &range = ctx->range();
+                if (range.end.line < m_priorityLines.start().line() || range.start.line > m_priorityLines.end().line()) {
+                    m_deferredContexts.append(m_currentContext);
+                    continue;
+                }
+            }
+
+            m_hasCurrentContext = true;
+            m_nextUse = 0;
+            gatherDeclarations(ctx, top);
+        }
+
+        DUContext* ctx = m_currentContext.context();
+        if (ctx) {
+            m_nextUse = gatherUses(ctx, top, m_nextUse, timer, deadline);
+            if (m_nextUse < ctx->usesCount()) break; // Out of time in the middle of the uses
+
+            // Children of the contexts split by gatherParallel() are walked as separate units
+            if (!m_parallelGather || !m_parallelGather->splitContexts.contains(m_currentContext)) {
+                const auto &childContexts = ctx->childContexts();
+                for (int i = childContexts.size() - 1; i >= 0; i--) {
+                    m_pendingContexts.append(IndexedDUContext(childContexts[i]));
+                }
+            }
+        }
+        m_hasCurrentContext = false;
+    } while (timer.nsecsElapsed() < deadline);
+
+    lock.unlock();
+    lockHoldHistogram().record(timer.nsecsElapsed() / 1000);
+
+    return true;
+}
+
+void NoteBuilder::gatherDeclarations(KDevelop::DUContext* ctx, KDevelop::TopDUContext* top)
+{
+    QElapsedTimer passTimer;
+
+    if (m_config.showEnumConstValues && isPassEnabled(EnumValuesPass)) {
+        // Add " = 123" notes after enums that do not have explicit value.
+        if (ctx->type() == DUContext::ContextType::Enum) {
+            passTimer.start();
+            foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
+                const CursorInRevision &pos = declaration->range().end;
+                if (!isPassEnabledOnLine(EnumValuesPass, pos.line)) continue;
+
+                if(EnumeratorType::Ptr enumerator = declaration->type<EnumeratorType>()) {
+                    m_enumerators.append({pos.castToSimpleCursor(), enumerator->valueAsString()});
+                }
+            }
+            addPassCost(EnumValuesPass, passTimer.nsecsElapsed());
+        }
+    }
+
+    if (m_config.showAutoType && isPassEnabled(AutoTypePass)) {
+        // Add notes with the derived type of auto declarations
+        passTimer.start();
+        foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
+            if (declaration->kind() != Declaration::Instance) continue;
+
+            const CursorInRevision &pos = declaration->range().start;
+            if (!isPassEnabledOnLine(AutoTypePass, pos.line)) continue;
+
+            // Only show this for implicitly typed declarations
+            if (declaration->isExplicitlyTyped()) continue;
+
+            const IndexedType indexedType = declaration->indexedType();
+            if (!indexedType.isValid()) continue;
+
+            // Converting deeply nested template types to string is expensive, reuse the result for every declaration of the same type
+            const auto typeString = m_typeStrings.lookup(indexedType, m_config.abbreviateAutoType, m_config.autoTypeMaxDepth);
+            if (typeString.full.isEmpty()) continue;
+
+            QString text = "= " + typeString.abbreviated;
+
+            // Size is known only for complete types, usually not for templates that were not instantiated
+            const bool showSize = m_config.showAutoTypeSize && typeString.sizeOf >= 0;
+            if (showSize) {
+                text += i18nc("size of the deduced type, appended to the auto type note", " · %1 B", typeString.sizeOf);
+                if (typeString.alignOf > 0) {
+                    text += i18nc("alignment of the deduced type, appended after its size", ", align %1", typeString.alignOf);
+                }
+            }
+
+            GenericTextNote *note;
+            if (showSize && typeString.sizeOf > m_config.autoTypeSizeHighlightBytes) {
+                note = new GenericTextNote(pos.column, text, QColor(0xb05050), QBrush(QColor(0xfbecec)), true, 4.0, 6.0);
+            } else {
+                note = new GenericTextNote(pos.column, text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0, 6.0);
+            }
+            if (typeString.abbreviated != typeString.full) {
+                note->setToolTip(typeString.full);
+            }
+            m_notes->insert(pos.castToSimpleCursor(), note);
+        }
+        addPassCost(AutoTypePass, passTimer.nsecsElapsed());
+    }
+
+    // Disabled for now
+#if 0
+    if (m_config.showStructFieldSize) {
+        // Add member size and offset notes behind struct fields
+        if (ctx->type() == DUContext::ContextType::Class) {
+            QVector<MemberSizeNote*> memberNotes;
+            MemberSizeNote *previousNote = nullptr;
+            uint64_t previousBytesOffsetOf = 0;
+            int maxColumn = 0;
+            foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
+                if (declaration->kind() != Declaration::Instance) continue;
+                if (declaration->isFunctionDeclaration()) continue;
+
+                const ClassMemberDeclaration* classMemberDeclaration = dynamic_cast<const ClassMemberDeclaration*>(declaration);
+                if (!classMemberDeclaration) continue;
+                if (classMemberDeclaration->isStatic()) continue;
+
+                const CursorInRevision &pos = declaration->range().end;
+
+                uint64_t bytesOffsetOf = classMemberDeclaration->bitOffsetOf() / 8; // TODO: Display somehow bit offets?
+
+                MemberSizeNote *note = new MemberSizeNote(
+                    0,
+                    classMemberDeclaration->sizeOf(),
+                    0,
+                    bytesOffsetOf,
+                    4 /* TODO: Configurable */
+                );
+                if (previousNote) {
+                    previousNote->setPadding(bytesOffsetOf - previousBytesOffsetOf - previousNote->size());
+                }
+                previousNote = note;
+                previousBytesOffsetOf = bytesOffsetOf;
+                m_notes[pos.line].push_back(note);
+
+                memberNotes.push_back(note);
+
+                // XXX: Ugly, slow and unreliable way to find the end of line
+                const auto range = KTextEditor::Range(pos.line, pos.column, pos.line, pos.column + 500 /* xxx */);
+                int endColumn = pos.column + m_doc->text(range).length() + 1;
+                if (endColumn > maxColumn) {
+                    maxColumn = endColumn;
+                }
+            }
+            foreach (MemberSizeNote* memberNote, memberNotes) {
+                memberNote->setColumn(memberNote->column() + maxColumn);
+            }
+        }
+    }
+#endif
+
+    const QSharedPointer<const SymbolSizeData> symbolSizes = m_config.symbolSizes;
+    if (symbolSizes && m_config.showSymbolSizes && isPassEnabled(SymbolSizePass)) {
+        // Machine code size of function definitions, summed over all their instantiations in the build
+        passTimer.start();
+        foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
+            if (!declaration->isFunctionDeclaration() || !declaration->isDefinition()) continue;
+
+            const CursorInRevision &pos = declaration->range().end;
+            if (!isPassEnabledOnLine(SymbolSizePass, pos.line)) continue;
+
+            const SymbolSizeData::Size size = symbolSizes->size(qualifiedName(declaration).join(QStringLiteral("::")));
+            if (size.symbols == 0) continue;
+
+            const QString text = size.symbols == 1 ? formatBytes(size.bytes)
+                : i18nc("code size of a function, number of its instantiations", "%1 in %2", formatBytes(size.bytes), size.symbols);
+            GenericTextNote *note = new GenericTextNote(pos.column, text, QColor(0x606080), QBrush(QColor(0xeeeef6)), true, 4.0);
+            note->setToolTip(i18np("Machine code of 1 symbol in the build",
+                                   "Machine code of %1 symbols in the build, like template instantiations, overloads and clones",
+                                   size.symbols));
+            m_notes->insert(pos.castToSimpleCursor(), note);
+        }
+        addPassCost(SymbolSizePass, passTimer.nsecsElapsed());
+    }
+
+    if (m_config.showFunctionArgumentDefaultValues && isPassEnabled(DefinitionDefaultValuesPass)) {
+        // Display default argument values at function definition
+        passTimer.start();
+        foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
+            if (declaration->kind() != Declaration::Instance) continue;
+            if (!isPassEnabledOnLine(DefinitionDefaultValuesPass, declaration->range().start.line)) continue;
+
+            if (const FunctionDefinition* functionDefinition = dynamic_cast<const FunctionDefinition*>(declaration)) {
+                if (!functionDefinition->isDefinition()) continue; // Only definitions, declarations already have the default parameters
+
+                const FunctionDeclaration* functionDeclaration = dynamic_cast<const FunctionDeclaration*>(functionDefinition->declaration());
+                if (!functionDeclaration) continue;
+                if (functionDeclaration->defaultParametersSize() == 0) continue;
+
+                auto *argumentContext = functionDefinition->internalContext();
+                if (!argumentContext) continue;
+
+                int argumentIndex = 0;
+                foreach (const Declaration* argumentDeclaration, argumentContext->localDeclarations(top)) {
+                    if (argumentDeclaration->kind() != Declaration::Instance) continue;
+
+                    const auto identifier = functionDeclaration->defaultParameterForArgument(argumentIndex);
+                    if (!identifier.isEmpty()) {
+                        const CursorInRevision &pos = argumentDeclaration->range().end;
+                        QString text = " = " + identifier.str();
+                        GenericTextNote *note = new GenericTextNote(pos.column, text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0);
+                        m_notes->insert(pos.castToSimpleCursor(), note);
+                    }
+
+                    argumentIndex++;
+                }
+            }
+        }
+        addPassCost(DefinitionDefaultValuesPass, passTimer.nsecsElapsed());
+    }
+
+#if 0
+    // Make every use fully qualified
+    {
+        CursorInRevision lastPosEnd;
+        for (int i = 0; i < ctx->usesCount(); i++) {
+            const auto &use = ctx->uses()[i];
+            Declaration* declaration = top->usedDeclarationForIndex(use.m_declarationIndex);
+            if (!declaration) continue;
+
+            const CursorInRevision &pos = use.m_range.start;
+
+            bool separatedByDoubleColon = false;
+            if (lastPosEnd.column != 0 && lastPosEnd.line != 0) {
+                // XXX: Ugly, slow and unreliable way to determine if the previous and this use of something are separate only by "::" and whitespace
+                QString tmp = m_doc->text(KTextEditor::Range(lastPosEnd.castToSimpleCursor(), pos.castToSimpleCursor()));
+                separatedByDoubleColon = (tmp.trimmed() == "::");
+            }
+
+            lastPosEnd = use.m_range.end;
+            if (separatedByDoubleColon) {
+                continue;
+            }
+
+            QStringList parts = declaration->qualifiedIdentifier().toStringList(RemoveTemplateInformation);
+            if (parts.size() <= 1) {
+                continue;
+            }
+            parts.removeLast();
+            QString text = parts.join("::") + "::";
+
+            GenericTextNote *note = new GenericTextNote(pos.column, text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0);
+            m_notes[pos.line].push_back(note);
+        }
+    }
+#endif
+
+#if 0
+    // Put note to all declarations
+    foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
+        const CursorInRevision &pos = declaration->range().end;
+
+        QString text = QString(" declaration(") +
+            "auto: " + (declaration->isAutoDeclaration() ? "true" : "false") + ", " +
+            "kind: " + QString::number(declaration->kind()) + ", " +
+            "type modifiers: " + QString::number(declaration->abstractType()->modifiers()) + ", " +
+            "type as string: " + declaration->abstractType()->toString() + ") ";
+
+        KTextEditor::InlineNote *note = new GenericTextNote(pos.column, text, Qt::white, QBrush(QColor(0x3a496c)), true, 4.0);
+        m_notes[pos.line].push_back(note);
+    }
+#endif
+
+#if 0
+    // Put note to all uses
+    for (int i = 0; i < ctx->usesCount(); i++) {
+        const auto &use = ctx->uses()[i];
+        const CursorInRevision &pos = use.m_range.start;
+
+        KTextEditor::InlineNote *note = new GenericTextNote(pos.column, QString::fromUtf8("Use: "), Qt::white, QBrush(QColor(0x3a496c)), true, 4.0);
+
+        m_notes[pos.line].push_back(note);
+    }
+#endif
+
+#if 0
+    // Put note to all context
+    {
+        const auto &pos = ctx->range().end;
+        QString text = QString::fromUtf8(" <- End context (") + QString::number(ctx->type()) + ") ";
+        KTextEditor::InlineNote *note = new GenericTextNote(pos.column, text, Qt::white, QBrush(QColor(0x3a496c)), true, 4.0);
+        m_notes[pos.line].push_back(note);
+    }
+    {
+        const auto &pos = ctx->range().start;
+        QString text = QString::fromUtf8(" Start context (") + QString::number(ctx->type()) + ") -> ";
+        KTextEditor::InlineNote *note = new GenericTextNote(pos.column, text, Qt::white, QBrush(QColor(0x3a496c)), true, 4.0);
+        m_notes[pos.line].push_back(note);
+    }
+#endif
+}
+
+int NoteBuilder::gatherUses(KDevelop::DUContext* ctx, KDevelop::TopDUContext* top, int from, const QElapsedTimer& timer, qint64 deadline)
+{
+    if ((m_config.showFunctionArgumentNames || m_config.showFunctionArgumentDefaultValues || m_config.showArgumentCopies ||
+         m_config.showVirtualCalls || m_config.showLoopAllocations || m_config.showCalleeSize) && isPassEnabled(CallSiteArgumentsPass)) {
+        // Display function parameter names on call sites,
+        // values of default parameters, arguments that get copied,
+        // calls that are dispatched dynamically, allocations in loops
+        // and the size of the called functions.
+        QElapsedTimer passTimer;
+        passTimer.start();
+
+        // Loops only exist in function bodies, their scopes are shared by all uses in this context
+        const bool markAllocations = m_config.showLoopAllocations && ctx->type() == DUContext::Other;
+        QVector<KTextEditor::Cursor> scopes;
+        QVector<KTextEditor::Cursor> declarationStarts; // Of the variables declared in this context, sorted
+        if (markAllocations) {
+            for (DUContext* scope = ctx; scope && scope->type() == DUContext::Other; scope = scope->parentContext()) {
+                scopes.append(scope->range().start.castToSimpleCursor());
+            }
+            for (const Declaration* declaration : ctx->localDeclarations(top)) {
+                declarationStarts.append(declaration->range().start.castToSimpleCursor());
+            }
+            std::sort(declarationStarts.begin(), declarationStarts.end());
+        }
+
+        for (int i = from; i < ctx->usesCount(); i++) {
+            if (i > from && timer.nsecsElapsed() >= deadline) {
+                addPassCost(CallSiteArgumentsPass, passTimer.nsecsElapsed());
+                return i;
+            }
+
+            const auto &use = ctx->uses()[i];
+            if (!isPassEnabledOnLine(CallSiteArgumentsPass, use.m_range.end.line)) continue;
+
+            Declaration* declaration = top->usedDeclarationForIndex(use.m_declarationIndex);
+            if (!declaration) continue;
+
+            // Types are allocated if they are the operand of a new expression, which the scanner checks
+            if (markAllocations && declaration->kind() == Declaration::Type) {
+                if (!isConstructedType(ctx, i, declaration, declarationStarts)) continue;
+
+                CallSiteRecord record;
+                record.start = use.m_range.start.castToSimpleCursor();
+                record.position = use.m_range.end.castToSimpleCursor();
+                record.allocation = QStringLiteral("new");
+                record.allocationIsNew = true;
+                record.scopes = scopes;
+                m_callSites.append(record);
+                continue;
+            }
+
+            if(FunctionType::Ptr function = declaration->type<FunctionType>()) {
+                CallSiteRecord record;
+                record.start = use.m_range.start.castToSimpleCursor();
+                record.position = use.m_range.end.castToSimpleCursor();
+                if (m_config.showVirtualCalls) {
+                    record.dispatch = callDispatch(declaration, top);
+                }
+                if (m_config.showCalleeSize) {
+                    record.calleeSize = calleeSizeNote(declaration, top);
+                }
+                if (markAllocations) {
+                    record.allocation = allocationOperation(declaration, top);
+                    if (!record.allocation.isEmpty()) {
+                        record.scopes = scopes;
+                    }
+                }
+
+                // Do not show names and default values if the function has no or one argument (TODO: the later configurable?)
+                const bool annotateArguments = function->indexedArgumentsSize() > 1;
+                bool copies = false;
+
+                DUContext* argumentContext = (annotateArguments || m_config.showArgumentCopies) ? DUChainUtils::getArgumentContext(declaration) : nullptr;
+                if (argumentContext) {
+                    auto decls = argumentContext->localDeclarations(top);
+                    const int argumentCount = qMin((int) function->indexedArgumentsSize(), decls.size());
+
+                    const FunctionDeclaration* functionDeclaration = dynamic_cast<const FunctionDeclaration*>(declaration);
+
+                    for (int argumentIndex = 0; argumentIndex < argumentCount; argumentIndex++) {
+                        const auto identifier = decls[argumentIndex]->identifier();
+                        record.argumentNames.append(!annotateArguments || identifier.isEmpty() ? QString() : identifier.toString());
+                        if (functionDeclaration && annotateArguments) {
+                            record.defaultValues.append(functionDeclaration->defaultParameterForArgument(argumentIndex).str());
+                        }
+                        if (m_config.showArgumentCopies) {
+                            record.argumentCopies.append(argumentCopyNote(decls[argumentIndex]->indexedType(), top));
+                            copies = copies || !record.argumentCopies.last().isEmpty();
+                        }
+                    }
+                }
+
+                if (!copies) {
+                    record.argumentCopies.clear();
+                    if (!annotateArguments) {
+                        record.argumentNames.clear();
+                    }
+                }
+                if (record.argumentNames.isEmpty() && record.dispatch == CallSiteRecord::StaticDispatch &&
+                    record.allocation.isEmpty() && record.calleeSize.isEmpty()) continue;
+
+                m_callSites.append(record);
+            }
+        }
+        addPassCost(CallSiteArgumentsPass, passTimer.nsecsElapsed());
+    }
+
+    return ctx->usesCount();
+}
+
+bool NoteBuilder::isConstructedType(const DUContext* ctx, int useIndex, const Declaration* declaration, const QVector<KTextEditor::Cursor>& declarationStarts)
+{
+    // Enums and template parameters are not created with new
+    if (!declaration->type<StructureType>() && !declaration->type<TypeAliasType>()) return false;
+
+    // The type of a variable is followed by the variable, with no other use in between, like in `Foo* foo = new Foo;`
+    const KTextEditor::Cursor end = ctx->uses()[useIndex].m_range.end.castToSimpleCursor();
+    const auto next = std::lower_bound(declarationStarts.constBegin(), declarationStarts.constEnd(), end);
+    if (next == declarationStarts.constEnd() || next->line() != end.line()) return true;
+
+    return useIndex + 1 < ctx->usesCount() && ctx->uses()[useIndex + 1].m_range.start.castToSimpleCursor() < *next;
+}
+
+CallSiteRecord::Dispatch NoteBuilder::callDispatch(Declaration* declaration, const TopDUContext* top)
+{
+    const IndexedDeclaration indexedDeclaration(declaration);
+    auto known = m_dispatches.constFind(indexedDeclaration);
+    if (known != m_dispatches.constEnd()) return *known;
+
+    // Uses of methods defined in the class body may refer to the definition
+    if (const auto definition = dynamic_cast<FunctionDefinition*>(declaration)) {
+        if (Declaration* functionDeclaration = definition->declaration(top)) {
+            declaration = functionDeclaration;
+        }
+    }
+
+    CallSiteRecord::Dispatch dispatch = CallSiteRecord::StaticDispatch;
+    const auto method = dynamic_cast<ClassFunctionDeclaration*>(declaration);
+    if (method && method->isVirtual()) {
+        const DUContext* classContext = method->context();
+        const auto classDeclaration = classContext ? dynamic_cast<ClassDeclaration*>(classContext->owner()) : nullptr;
+        const bool finalClass = classDeclaration && classDeclaration->classModifier() == ClassDeclarationData::Final;
+        dispatch = (method->isFinal() || finalClass) ? CallSiteRecord::FinalDispatch : CallSiteRecord::VirtualDispatch;
+    }
+
+    m_dispatches.insert(indexedDeclaration, dispatch);
+    return dispatch;
+}
+
+QString NoteBuilder::calleeSizeNote(Declaration* declaration, const TopDUContext* top)
+{
+    const IndexedDeclaration indexedDeclaration(declaration);
+    auto known = m_calleeSizes.constFind(indexedDeclaration);
+    if (known != m_calleeSizes.constEnd()) return *known;
+
+    // The body belongs to the definition, which may be the used declaration itself
+    Declaration* definition = declaration->isDefinition() ? declaration : FunctionDefinition::definition(declaration);
+    const DUContext* body = definition ? functionBody(definition) : nullptr;
+
+    QString note;
+    if (!body || body->type() != DUContext::Other) {
+        note = i18nc("called function whose definition is not known", "out-of-line, body not visible");
+    } else {
+        QString location;
+        if (definition->url() == top->url()) {
+            location = i18nc("called function defined in the same file", "this file");
+        } else if (isHeader(definition->url().str())) {
+            location = i18nc("called function defined in a header", "inline in header");
+        } else {
+            location = i18nc("called function defined in another source file", "out-of-line, other TU");
+        }
+
+        const int lines = body->range().end.line - body->range().start.line + 1;
+        note = i18ncp("size of the called function and where it is defined", "%1 line, %2 uses, %3", "%1 lines, %2 uses, %3",
+                      lines, nestedUseCount(body), location);
+    }
+
+    m_calleeSizes.insert(indexedDeclaration, note);
+    return note;
+}
+
+QString NoteBuilder::allocationOperation(Declaration* declaration, const TopDUContext* top)
+{
+    const IndexedDeclaration indexedDeclaration(declaration);
+    auto known = m_allocationOperations.constFind(indexedDeclaration);
+    if (known != m_allocationOperations.constEnd()) return *known;
+
+    // Uses of methods defined in the class body may refer to the definition
+    if (const auto definition = dynamic_cast<FunctionDefinition*>(declaration)) {
+        if (Declaration* functionDeclaration = definition->declaration(top)) {
+            declaration = functionDeclaration;
+        }
+    }
+
+    const QStringList name = qualifiedName(declaration);
+
+    QString operation;
+    if (name.size() == 1 && (name[0] == QLatin1String("operator new") || name[0] == QLatin1String("operator new[]"))) {
+        operation = QStringLiteral("new");
+    } else if (name.size() == 2 && name[0] == QLatin1String("std")) {
+        static const QStringList factories = {
+            QStringLiteral("make_shared"), QStringLiteral("make_unique"), QStringLiteral("allocate_shared")
+        };
+        if (factories.contains(name[1])) {
+            operation = name[1];
+        }
+    } else if (name.size() == 3 && name[0] == QLatin1String("std")) {
+        static const QStringList containers = {
+            QStringLiteral("vector"), QStringLiteral("deque"), QStringLiteral("list"), QStringLiteral("forward_list"),
+            QStringLiteral("map"), QStringLiteral("multimap"), QStringLiteral("set"), QStringLiteral("multiset"),
+            QStringLiteral("unordered_map"), QStringLiteral("unordered_multimap"),
+            QStringLiteral("unordered_set"), QStringLiteral("unordered_multiset"),
+            QStringLiteral("basic_string")
+        };
+        static const QStringList insertions = {
+            QStringLiteral("push_back"), QStringLiteral("emplace_back"), QStringLiteral("push_front"),
+            QStringLiteral("emplace_front"), QStringLiteral("insert"), QStringLiteral("emplace")
+        };
+        if (containers.contains(name[1])) {
+            const auto method = dynamic_cast<ClassFunctionDeclaration*>(declaration);
+            if (method && method->isConstructor()) {
+                operation = name[1] == QLatin1String("basic_string") ? QStringLiteral("string") : name[1];
+            } else if (insertions.contains(name[2])) {
+                operation = name[2];
+            }
+        }
+    }
+
+    m_allocationOperations.insert(indexedDeclaration, operation);
+    return operation;
+}
+
+QString NoteBuilder::argumentCopyNote(const IndexedType& type, const TopDUContext* top)
+{
+    const AbstractType::Ptr parameterType = TypeUtils::unAliasedType(type.abstractType());
+    if (!parameterType) return QString();
+
+    // Only parameters taken by value copy the argument
+    const auto whichType = parameterType->whichType();
+    if (whichType == AbstractType::TypeReference || whichType == AbstractType::TypePointer) return QString();
+
+    const qint64 size = parameterType->sizeOf();
+    const bool large = size > m_config.argumentCopyThresholdBytes;
+    if (!large && !isNonTriviallyCopyable(parameterType->indexed(), top, 0)) return QString();
+
+    return size >= 0 ? i18nc("argument passed by value, size of the copy", "copy %1 B", size)
+                     : i18nc("argument passed by value", "copy");
+}
+
+bool NoteBuilder::isNonTriviallyCopyable(const IndexedType& type, const TopDUContext* top, int depth)
+{
+    if (depth > MAX_COPY_CHECK_DEPTH) return false;
+
+    auto known = m_nonTrivialCopies.constFind(type.index());
+    if (known != m_nonTrivialCopies.constEnd()) return *known;
+
+    AbstractType::Ptr abstractType = TypeUtils::unAliasedType(type.abstractType());
+    while (const auto array = abstractType.cast<ArrayType>()) {
+        abstractType = TypeUtils::unAliasedType(array->elementType());
+    }
+
+    // Only classes can have copy constructors, and only those we know the declaration of can be checked
+    const auto structure = abstractType.cast<StructureType>();
+    Declaration* declaration = structure ? structure->declaration(top) : nullptr;
+    DUContext* internalContext = declaration ? declaration->internalContext() : nullptr;
+    if (!internalContext) return false;
+
+    bool nonTrivial = false;
+
+    // User declared copy constructor or destructor, or a vtable to set up
+    for (Declaration* member : internalContext->localDeclarations(top)) {
+        if (const auto function = dynamic_cast<ClassFunctionDeclaration*>(member)) {
+            if (function->isDestructor() || function->isVirtual()) {
+                nonTrivial = true;
+                break;
+            }
+            if (!function->isConstructor() || function->isExplicitlyDeleted()) continue;
+
+            const FunctionType::Ptr constructorType = function->type<FunctionType>();
+            if (!constructorType || constructorType->indexedArgumentsSize() != 1) continue;
+
+            const auto reference = constructorType->arguments().first().cast<ReferenceType>();
+            if (!reference || reference->isRValue()) continue;
+
+            const auto argumentStructure = TypeUtils::unAliasedType(reference->baseType()).cast<StructureType>();
+            if (argumentStructure && argumentStructure->declarationId() == declaration->id()) {
+                nonTrivial = true;
+                break;
+            }
+        } else if (const auto field = dynamic_cast<ClassMemberDeclaration*>(member)) {
+            // Members of class type with a non-trivial copy
+            if (field->isStatic() || field->kind() != Declaration::Instance || field->isFunctionDeclaration()) continue;
+
+            if (isNonTriviallyCopyable(field->indexedType(), top, depth + 1)) {
+                nonTrivial = true;
+                break;
+            }
+        }
+    }
+
+    if (const auto classDeclaration = dynamic_cast<ClassDeclaration*>(declaration)) {
+        for (uint i = 0; !nonTrivial && i < classDeclaration->baseClassesSize(); i++) {
+            const BaseClassInstance& base = classDeclaration->baseClasses()[i];
+            nonTrivial = base.virtualInheritance || isNonTriviallyCopyable(base.baseClass, top, depth + 1);
+        }
+    }
+
+    m_nonTrivialCopies.insert(type.index(), nonTrivial);
+    return nonTrivial;
+}
+
+bool NoteBuilder::scanGathered(qint64 budgetUs)
+{
+    if (!m_scanner) {
+        NoteScanner::sortRecords(m_enumerators, m_callSites);
+        m_scanner.reset(new NoteScanner(m_text, m_config.showFunctionArgumentNames, m_config.showFunctionArgumentDefaultValues));
+        m_scanner->setRecords(m_enumerators, m_callSites);
+        m_enumerators.clear();
+        m_callSites.clear();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 elapsed = 0;
+
+    QVector<ScannedNote> scanned;
+    while (!m_scanner->atEnd()) {
+        if (budgetUs >= 0 && elapsed >= budgetUs * 1000) return false;
+
+        const Pass pass = m_scanner->nextIsEnumerator() ? EnumValuesPass : CallSiteArgumentsPass;
+
+        // The pass may have been limited since the record was gathered
+        if (isPassEnabledOnLine(pass, m_scanner->nextPosition().line())) {
+            m_scanner->scanNext(scanned);
+            addScannedNotes(scanned);
+            scanned.clear();
+        } else {
+            m_scanner->skipNext();
+        }
+
+        const qint64 now = timer.nsecsElapsed();
+        addPassCost(pass, now - elapsed);
+        elapsed = now;
+    }
+
+    m_scanner.reset();
+    return true;
+}
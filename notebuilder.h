@@ -0,0 +1,367 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NOTEBUILDER_H
+#define NOTEBUILDER_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <KTextEditor/Cursor>
+#include <KTextEditor/Range>
+
+#include <language/duchain/indexeddeclaration.h>
+#include <language/duchain/indexedducontext.h>
+#include <language/duchain/indexedtopducontext.h>
+#include <language/editor/modificationrevision.h>
+#include <serialization/indexedstring.h>
+
+#include "histogram.h"
+#include "noterecords.h"
+#include "notes/notestore.h"
+#include "sourceinfoconfig.h"
+
+
+namespace KDevelop {
+class Declaration;
+class DUContext;
+class IndexedType;
+class TopDUContext;
+}
+
+class QElapsedTimer;
+class QThreadPool;
+
+class InlineNoteBase;
+class NoteScanner;
+class TextSource;
+class TypeStringCache;
+
+
+/**
+ * Computes the notes for one file.
+ *
+ * Does not depend on the editor, so it can run in a worker thread for files
+ * that are not open.
+ *
+ * The DUChain is walked in chunks. During each chunk the read lock is held
+ * just long enough to gather the data the notes need, then it is released
+ * so that parse jobs waiting for the write lock are not stalled, and the
+ * gathered data is matched with the text.
+ *
+ * The walk is resumable: start() prepares it and every step() continues
+ * where the previous one stopped, which allows spreading the work over
+ * multiple event loop iterations. Contexts overlapping the priority lines
+ * are walked first.
+ *
+ * The time spent in every pass is measured. Once a pass exceeds the budget
+ * from the config, it is limited to the priority lines and if it keeps
+ * exceeding it, it is disabled for the rest of the build. When no pass
+ * runs beyond the priority lines, the contexts outside of them are not
+ * walked at all.
+ *
+ * Alternatively the whole file can be gathered at once by multiple threads,
+ * see gatherParallel(). Each of them walks in the same bounded chunks and
+ * the pass costs are summed over all of them.
+ *
+ * The matching with the text can also be left to the caller, see
+ * setDeferScanning().
+ */
+class NoteBuilder
+{
+    // Upper bound of how long the DUChain read lock is held at once
+    static constexpr qint64 MAX_LOCK_HOLD_US = 2000;
+
+    // How many subtrees the file is split into per thread for gatherParallel(), so that the threads stay busy until the end
+    static constexpr int UNITS_PER_THREAD = 4;
+
+    // Lines with a smaller share of the profile samples get no profile note
+    static constexpr double PROFILE_MIN_PERCENT = 0.1;
+
+    // Distinct background colors of the profile notes
+    static constexpr int PROFILE_HEAT_STEPS = 32;
+
+    // Messages shown in the tooltip of remarks collapsed into one note
+    static constexpr int MAX_REMARK_MESSAGES = 8;
+
+    // How deep members and base classes are followed when looking for a non-trivial copy
+    static constexpr int MAX_COPY_CHECK_DEPTH = 6;
+
+public:
+    enum class Status {
+        InProgress,
+        Finished,
+        Aborted, // The top context changed
+    };
+
+    enum Pass {
+        EnumValuesPass,
+        AutoTypePass,
+        CallSiteArgumentsPass,
+        DefinitionDefaultValuesPass,
+        ProfilePass,
+        CoveragePass,
+        OptRemarkPass,
+        SymbolSizePass,
+        PassCount
+    };
+
+    enum class PassMode {
+        Full,
+        PriorityLinesOnly,
+        Disabled,
+    };
+
+    /**
+     * \param config copied, so the settings and the data they point to stay
+     *        the same for the whole build while the user changes them
+     */
+    NoteBuilder(const SourceInfoSettings& config, TypeStringCache& typeStrings, const TextSource& text);
+    ~NoteBuilder();
+
+    /**
+     * Lines whose notes should be computed first, typically the visible ones.
+     * Must be set before start().
+     */
+    void setPriorityLines(const KTextEditor::Range& lines);
+    KTextEditor::Range priorityLines() const;
+
+    /**
+     * Start computing notes for the file. Must be called without holding the
+     * DUChain read lock.
+     *
+     * \return false if the file has no top context
+     */
+    bool start(const KDevelop::IndexedString& url);
+
+    /**
+     * Gather the data for the whole file at once, with independent subtrees
+     * of contexts spread over the given number of threads of gatherPool().
+     * Contexts overlapping the priority lines are not preferred.
+     *
+     * Blocks until done, can be called from any thread after start(), but
+     * without holding the DUChain read lock. Afterwards step() only matches
+     * the gathered data with the text. The text is not read while
+     * gathering, so its owner does not have to outlive this call.
+     *
+     * \param cancelled checked by all the threads between the chunks, the
+     *        gathering stops once it is not zero
+     * \return false if the top context changed or it was cancelled
+     */
+    bool gatherParallel(int threads, QSharedPointer<const QAtomicInt> cancelled = QSharedPointer<const QAtomicInt>());
+
+    /**
+     * Continue computing for approximately the given time. Must be called
+     * without holding the DUChain read lock.
+     */
+    Status step(qint64 budgetUs);
+
+    bool priorityLinesDone() const;
+
+    /**
+     * Only gather the data, step() then returns Finished without matching it
+     * with the text. The caller takes it with takeRecords(), matches it
+     * using a NoteScanner and adds the results with addScannedNotes().
+     * Must be set before start().
+     */
+    void setDeferScanning(bool defer);
+
+    /**
+     * The gathered records not matched with the text yet, sorted, without
+     * the ones the degraded passes skip.
+     */
+    void takeRecords(QVector<EnumeratorRecord>& enumerators, QVector<CallSiteRecord>& callSites);
+
+    void addScannedNotes(const QVector<ScannedNote>& notes);
+
+    static InlineNoteBase* createNote(const ScannedNote& note);
+
+    /**
+     * Modes to start the passes in, typically the ones a previous build of
+     * the same file ended with. Must be set before start().
+     */
+    void setPassModes(const QVector<PassMode>& modes);
+
+    /**
+     * The pass modes after the degradations that happened during the build.
+     */
+    QVector<PassMode> passModes() const;
+
+    /**
+     * Time spent in the pass since start().
+     */
+    qint64 passCostUs(Pass pass) const;
+
+    /**
+     * Whether some pass did not run over the whole file, the notes are then
+     * incomplete.
+     */
+    bool isDegraded() const;
+
+    static QString passName(Pass pass);
+
+    /**
+     * The notes computed so far, complete once step() returned Finished.
+     * Until then the builder keeps changing the store, partial results are
+     * shown through NoteStore::snapshot().
+     */
+    QSharedPointer<NoteStore> notes() const;
+
+    /**
+     * Compute all the notes for the file at once. Must be called without
+     * holding the DUChain read lock.
+     *
+     * \param cancelled checked between the steps, the build is abandoned
+     *                  once it is non-zero
+     * \return the notes or null if the file has no top context, the top
+     *         context changed while the notes were being computed or the
+     *         build was cancelled
+     */
+    QSharedPointer<NoteStore> build(const KDevelop::IndexedString& url, const QAtomicInt* cancelled = nullptr);
+
+    KDevelop::IndexedString url() const;
+
+    /**
+     * Modification revision of the top context the notes were computed from.
+     */
+    KDevelop::ModificationRevision revision() const;
+
+    /**
+     * How long the DUChain read lock was held per chunk, over all builders.
+     */
+    static Histogram& lockHoldHistogram();
+
+    /**
+     * Threads for gatherParallel(), shared by all builders.
+     */
+    static QThreadPool& gatherPool();
+
+private:
+    struct ParallelGather;
+    class GatherTask;
+
+    bool isFinished() const;
+    bool isGatheringFinished() const;
+
+    bool isPassEnabled(Pass pass) const;
+
+    /**
+     * Whether some pass walking the DUChain runs beyond the priority lines.
+     */
+    bool needsWholeTree() const;
+    bool isPassEnabledOnLine(Pass pass, int line) const;
+    void addPassCost(Pass pass, qint64 nanoseconds);
+
+    void addProfileNotes();
+    void addCoverageNotes();
+    void addOptRemarkNotes();
+
+    bool gatherChunk(qint64 budgetUs);
+    bool gatherSubtree(const KDevelop::IndexedDUContext& root);
+    static void gatherUnits(ParallelGather& shared);
+    void gatherDeclarations(KDevelop::DUContext* ctx, KDevelop::TopDUContext* top);
+    int gatherUses(KDevelop::DUContext* ctx, KDevelop::TopDUContext* top, int from, const QElapsedTimer& timer, qint64 deadline);
+
+    /**
+     * Text of the note for an argument passed as the given parameter type,
+     * empty if passing it does not copy a large or non-trivially copyable
+     * object.
+     */
+    QString argumentCopyNote(const KDevelop::IndexedType& type, const KDevelop::TopDUContext* top);
+
+    /**
+     * Whether the use of a type may be the operand of a new expression,
+     * the scanner checks that in the text. Uses that are the types of
+     * declared variables are not, the most common case.
+     */
+    static bool isConstructedType(const KDevelop::DUContext* ctx, int useIndex, const KDevelop::Declaration* declaration,
+                                  const QVector<KTextEditor::Cursor>& declarationStarts);
+
+    /**
+     * How calls of the function are dispatched, memoized per declaration.
+     */
+    CallSiteRecord::Dispatch callDispatch(KDevelop::Declaration* declaration, const KDevelop::TopDUContext* top);
+    bool isNonTriviallyCopyable(const KDevelop::IndexedType& type, const KDevelop::TopDUContext* top, int depth);
+
+    /**
+     * Name of the heap allocating operation that calling the function
+     * performs (operator new, the smart pointer factories, constructors and
+     * insertions of the standard containers), empty if it is not one of
+     * them. Memoized per declaration.
+     */
+    QString allocationOperation(KDevelop::Declaration* declaration, const KDevelop::TopDUContext* top);
+
+    /**
+     * Text of the note after calls of the function: the lines and uses of
+     * its body, and whether it is defined in this file, inline in a header
+     * or out-of-line in another translation unit. Memoized per declaration.
+     */
+    QString calleeSizeNote(KDevelop::Declaration* declaration, const KDevelop::TopDUContext* top);
+
+    /**
+     * Match the gathered records with the text in document order, for
+     * approximately the given time, or until done if budgetUs is negative.
+     *
+     * \return true if all the gathered records were matched
+     */
+    bool scanGathered(qint64 budgetUs);
+
+private:
+    const SourceInfoSettings m_config; // A snapshot, the workers must not read the shared config
+    TypeStringCache& m_typeStrings;
+    const TextSource& m_text;
+
+    KDevelop::IndexedString m_url;
+    KDevelop::IndexedTopDUContext m_top;
+    KDevelop::ModificationRevision m_revision;
+
+    QVector<KDevelop::IndexedDUContext> m_pendingContexts; // Stack, the next context to walk is the last one
+    QVector<KDevelop::IndexedDUContext> m_deferredContexts; // Contexts outside of the priority lines, in walk order
+
+    KDevelop::IndexedDUContext m_currentContext;
+    bool m_hasCurrentContext = false;
+    int m_nextUse = 0;
+
+    KTextEditor::Range m_priorityLines = KTextEditor::Range::invalid();
+    bool m_prioritizing = false;
+
+    QVector<PassMode> m_passModes;
+    QVector<qint64> m_passCostsNs;
+
+    QVector<EnumeratorRecord> m_enumerators;
+    QVector<CallSiteRecord> m_callSites;
+    QHash<uint, bool> m_nonTrivialCopies; // By type index
+    QHash<KDevelop::IndexedDeclaration, CallSiteRecord::Dispatch> m_dispatches;
+    QHash<KDevelop::IndexedDeclaration, QString> m_allocationOperations;
+    QHash<KDevelop::IndexedDeclaration, QString> m_calleeSizes;
+    bool m_deferScanning = false;
+
+    // State shared with the other threads while gathering in gatherParallel()
+    ParallelGather* m_parallelGather = nullptr;
+
+    // Sweep over the sorted records in progress
+    QScopedPointer<NoteScanner> m_scanner;
+
+    QSharedPointer<NoteStore> m_notes;
+};
+
+#endif // NOTEBUILDER_H
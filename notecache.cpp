@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QMutexLocker>
+
+#include "notecache.h"
+
+
+using namespace KDevelop;
+
+
+NoteCache::NoteCache(size_t budget)
+    : m_budget(budget)
+{
+}
+
+QSharedPointer<const NoteStore> NoteCache::find(const IndexedString& url, const ModificationRevision& revision) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto iter = m_entries.constFind(url);
+    if (iter == m_entries.constEnd() || iter->revision != revision) {
+        return QSharedPointer<const NoteStore>();
+    }
+    return iter->notes;
+}
+
+bool NoteCache::contains(const IndexedString& url, const ModificationRevision& revision) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto iter = m_entries.constFind(url);
+    return iter != m_entries.constEnd() && iter->revision == revision;
+}
+
+void NoteCache::insert(const IndexedString& url, const ModificationRevision& revision, QSharedPointer<const NoteStore> notes, uint generation)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (generation != m_generation) {
+        return;
+    }
+
+    evict(url);
+
+    m_entries.insert(url, Entry{revision, notes});
+    m_insertionOrder.append(url);
+    m_memoryUsage += notes->memoryUsage();
+
+    while (m_memoryUsage > m_budget && m_insertionOrder.size() > 1) {
+        evict(m_insertionOrder.first());
+    }
+}
+
+void NoteCache::remove(const IndexedString& url, const QSharedPointer<const NoteStore>& notes)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto iter = m_entries.constFind(url);
+    if (iter != m_entries.constEnd() && iter->notes == notes) {
+        evict(url);
+    }
+}
+
+void NoteCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+
+    m_entries.clear();
+    m_insertionOrder.clear();
+    m_memoryUsage = 0;
+    m_generation++;
+}
+
+uint NoteCache::generation() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_generation;
+}
+
+void NoteCache::setBudget(size_t budget)
+{
+    QMutexLocker lock(&m_mutex);
+    m_budget = budget;
+}
+
+size_t NoteCache::budget() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_budget;
+}
+
+size_t NoteCache::memoryUsage() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_memoryUsage;
+}
+
+size_t NoteCache::memoryUsage(const QSet<const NoteStore*>& excluded) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    size_t usage = 0;
+    for (const auto &entry : m_entries) {
+        if (!excluded.contains(entry.notes.data())) {
+            usage += entry.notes->memoryUsage();
+        }
+    }
+    return usage;
+}
+
+void NoteCache::evict(const IndexedString& url)
+{
+    auto iter = m_entries.find(url);
+    if (iter == m_entries.end()) {
+        return;
+    }
+
+    m_memoryUsage -= iter->notes->memoryUsage();
+    m_entries.erase(iter);
+    m_insertionOrder.removeOne(url);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NOTECACHE_H
+#define NOTECACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+
+#include <serialization/indexedstring.h>
+#include <language/editor/modificationrevision.h>
+
+#include "notes/notestore.h"
+
+
+/**
+ * Notes computed for files, shared by all providers and the cache warmer.
+ *
+ * Entries are valid only for the modification revision of the top context
+ * they were computed from. Whenever the configuration changes the cache is
+ * cleared and its generation increased, so that results of computations
+ * started before the change are not inserted.
+ *
+ * Thread safe.
+ */
+class NoteCache
+{
+public:
+    explicit NoteCache(size_t budget);
+
+    QSharedPointer<const NoteStore> find(const KDevelop::IndexedString& url, const KDevelop::ModificationRevision& revision) const;
+    bool contains(const KDevelop::IndexedString& url, const KDevelop::ModificationRevision& revision) const;
+
+    /**
+     * Insert notes, evicting the oldest entries if the memory budget is
+     * exceeded. Does nothing if the generation does not match.
+     */
+    void insert(const KDevelop::IndexedString& url, const KDevelop::ModificationRevision& revision, QSharedPointer<const NoteStore> notes, uint generation);
+
+    /**
+     * Drop the entry of the file, if it holds the given notes.
+     */
+    void remove(const KDevelop::IndexedString& url, const QSharedPointer<const NoteStore>& notes);
+
+    void clear();
+    uint generation() const;
+
+    void setBudget(size_t budget);
+    size_t budget() const;
+    size_t memoryUsage() const;
+
+    /**
+     * Memory used by the entries whose notes are not among the given ones,
+     * typically the notes shown in the open documents, which are counted
+     * separately.
+     */
+    size_t memoryUsage(const QSet<const NoteStore*>& excluded) const;
+
+private:
+    void evict(const KDevelop::IndexedString& url);
+
+    struct Entry {
+        KDevelop::ModificationRevision revision;
+        QSharedPointer<const NoteStore> notes;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<KDevelop::IndexedString, Entry> m_entries;
+    QList<KDevelop::IndexedString> m_insertionOrder;
+
+    size_t m_budget;
+    size_t m_memoryUsage = 0;
+    uint m_generation = 0;
+};
+
+#endif // NOTECACHE_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "noterecords.h"
+
+
+namespace {
+
+void writeCursor(QDataStream& stream, const KTextEditor::Cursor& cursor)
+{
+    stream << qint32(cursor.line()) << qint32(cursor.column());
+}
+
+KTextEditor::Cursor readCursor(QDataStream& stream)
+{
+    qint32 line, column;
+    stream >> line >> column;
+    return KTextEditor::Cursor(line, column);
+}
+
+}
+
+
+QDataStream& operator<<(QDataStream& stream, const EnumeratorRecord& record)
+{
+    writeCursor(stream, record.position);
+    return stream << record.value;
+}
+
+QDataStream& operator>>(QDataStream& stream, EnumeratorRecord& record)
+{
+    record.position = readCursor(stream);
+    return stream >> record.value;
+}
+
+QDataStream& operator<<(QDataStream& stream, const CallSiteRecord& record)
+{
+    writeCursor(stream, record.start);
+    writeCursor(stream, record.position);
+    stream << quint8(record.dispatch);
+    stream << record.argumentNames << record.defaultValues << record.argumentCopies;
+
+    stream << record.allocation << record.allocationIsNew << qint32(record.scopes.size());
+    for (const auto& scope : record.scopes) {
+        writeCursor(stream, scope);
+    }
+    return stream << record.calleeSize;
+}
+
+QDataStream& operator>>(QDataStream& stream, CallSiteRecord& record)
+{
+    record.start = readCursor(stream);
+    record.position = readCursor(stream);
+    quint8 dispatch;
+    stream >> dispatch;
+    record.dispatch = CallSiteRecord::Dispatch(dispatch);
+    stream >> record.argumentNames >> record.defaultValues >> record.argumentCopies;
+
+    qint32 scopeCount;
+    stream >> record.allocation >> record.allocationIsNew >> scopeCount;
+    record.scopes.clear();
+    for (qint32 i = 0; i < scopeCount && stream.status() == QDataStream::Ok; i++) {
+        record.scopes.append(readCursor(stream));
+    }
+    return stream >> record.calleeSize;
+}
+
+QDataStream& operator<<(QDataStream& stream, const ScannedNote& note)
+{
+    stream << quint8(note.kind);
+    writeCursor(stream, note.position);
+    return stream << note.text << note.loopDepth;
+}
+
+QDataStream& operator>>(QDataStream& stream, ScannedNote& note)
+{
+    quint8 kind;
+    stream >> kind;
+    note.kind = ScannedNote::Kind(kind);
+    note.position = readCursor(stream);
+    return stream >> note.text >> note.loopDepth;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NOTERECORDS_H
+#define NOTERECORDS_H
+
+#include <QDataStream>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <KTextEditor/Cursor>
+
+
+/**
+ * Data gathered from the DUChain for the notes that still have to be
+ * matched with the text, see NoteBuilder and NoteScanner.
+ */
+struct EnumeratorRecord {
+    KTextEditor::Cursor position;
+    QString value;
+};
+
+struct CallSiteRecord {
+    enum Dispatch : quint8 {
+        StaticDispatch,
+        VirtualDispatch,
+        FinalDispatch, // Virtual, but the method or its class is final, so the call can be devirtualized
+    };
+
+    KTextEditor::Cursor start;    // Start of the use of the function
+    KTextEditor::Cursor position; // End of the use of the function
+    Dispatch dispatch = StaticDispatch;
+    QStringList argumentNames;    // Empty string for unnamed arguments
+    QStringList defaultValues;    // Empty if the used declaration is not a FunctionDeclaration
+    QStringList argumentCopies;   // Notes for the arguments passed by value that get copied, empty if there are none
+
+    QString allocation;                  // Heap allocating operation, like "push_back", empty if the call does not allocate
+    bool allocationIsNew = false;        // The use is of a class, it only allocates in a new expression
+    QVector<KTextEditor::Cursor> scopes; // Starts of the contexts around an allocation, innermost first
+
+    QString calleeSize; // Note placed after the call, empty if not shown
+};
+
+/**
+ * Note produced by NoteScanner, turned into an InlineNoteBase by
+ * NoteBuilder::createNote().
+ */
+struct ScannedNote {
+    enum Kind : quint8 {
+        EnumValue,
+        ArgumentName,
+        DefaultValues,
+        ArgumentCopy,
+        VirtualCall,
+        FinalCall,
+        Allocation,
+        CalleeSize,
+    };
+
+    Kind kind;
+    KTextEditor::Cursor position;
+    QString text;
+    qint32 loopDepth; // Of Allocation notes, zero for the others
+};
+
+QDataStream& operator<<(QDataStream& stream, const EnumeratorRecord& record);
+QDataStream& operator>>(QDataStream& stream, EnumeratorRecord& record);
+QDataStream& operator<<(QDataStream& stream, const CallSiteRecord& record);
+QDataStream& operator>>(QDataStream& stream, CallSiteRecord& record);
+QDataStream& operator<<(QDataStream& stream, const ScannedNote& note);
+QDataStream& operator>>(QDataStream& stream, ScannedNote& note);
+
+#endif // NOTERECORDS_H
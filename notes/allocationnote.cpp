@@ -0,0 +1,59 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <KLocalizedString>
+
+#include "allocationnote.h"
+
+
+namespace {
+
+// From orange for allocations in one loop to red for the deeply nested ones
+QColor depthColor(int loopDepth)
+{
+    return QColor::fromHsvF(qMax(0.0, 0.08 - 0.03 * (loopDepth - 1)), 0.25, 1.0);
+}
+
+}
+
+
+AllocationNote::AllocationNote(int column, const QString& operation, int loopDepth)
+    : GenericTextNote(column, i18nc("heap allocation inside of loops, %1 is the loop nesting depth", "alloc ⟳%1", loopDepth),
+                      QColor(0x803020), QBrush(depthColor(loopDepth)), true, 4.0)
+    , m_operation(operation)
+    , m_loopDepth(loopDepth)
+{
+    setToolTip(i18np("%2 allocates inside of a loop", "%2 allocates inside of %1 nested loops", loopDepth, operation));
+    setSpaceRight(true);
+}
+
+size_t AllocationNote::memoryUsage() const
+{
+    return GenericTextNote::memoryUsage() + sizeof(*this) - sizeof(GenericTextNote) + m_operation.capacity() * sizeof(QChar);
+}
+
+QString AllocationNote::operation() const
+{
+    return m_operation;
+}
+
+int AllocationNote::loopDepth() const
+{
+    return m_loopDepth;
+}
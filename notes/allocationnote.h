@@ -0,0 +1,46 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef ALLOCATIONNOTE_H
+#define ALLOCATIONNOTE_H
+
+#include "generictextnote.h"
+
+
+/**
+ * Marks a heap allocation inside of loops, remembering what it is so that
+ * the worst ones of a document can be listed.
+ */
+class AllocationNote : public GenericTextNote
+{
+public:
+    AllocationNote(int column, const QString& operation, int loopDepth);
+    ~AllocationNote() override = default;
+
+    size_t memoryUsage() const override;
+
+    QString operation() const;
+    int loopDepth() const;
+
+private:
+    QString m_operation;
+    int m_loopDepth;
+};
+
+#endif // ALLOCATIONNOTE_H
@@ -20,14 +20,30 @@
 #include "generictextnote.h"
 
 
+constexpr qreal GenericTextNote::MARGIN;
+constexpr qreal GenericTextNote::MIN_VISIBLE_CORNER_RADIUS;
+
+
+namespace {
+
+NoteStyle makeStyle(const QColor& textColor, const QBrush& backgroundBrush, bool renderBackground, qreal cornerRadius, qreal margin)
+{
+    NoteStyle style;
+    style.textColor = textColor;
+    style.background = backgroundBrush;
+    style.renderBackground = renderBackground;
+    style.cornerRadius = cornerRadius;
+    style.margin = margin;
+    return style;
+}
+
+}
+
+
 GenericTextNote::GenericTextNote(int column, QString text, QColor textColor, QBrush backgroundBrush, bool renderBackground, qreal cornerRadius, qreal margin)
     : m_column(column)
     , m_text(text)
-    , m_textColor(textColor)
-    , m_backgroundBrush(backgroundBrush)
-    , m_renderBackground(renderBackground)
-    , m_cornerRadius(cornerRadius)
-    , m_margin(margin)
+    , m_style(NoteStyles::index(makeStyle(textColor, backgroundBrush, renderBackground, cornerRadius, margin)))
     , m_spaceLeft(false)
     , m_spaceRight(false)
 {}
@@ -42,37 +58,59 @@ int GenericTextNote::column() const
 
 qreal GenericTextNote::width(qreal height, const QFontMetricsF &fontMetrics) const
 {
-    qreal spaceWidth = fontMetrics.width(QChar::fromLatin1(' '));
+    const NoteStyle &style = NoteStyles::style(m_style);
+
+    qreal spaceWidth = (m_spaceLeft || m_spaceRight) ? fontMetrics.width(QChar::fromLatin1(' ')) : 0.0;
     return fontMetrics.boundingRect(m_text).width() +
-           m_margin * 2.0 +
+           style.margin * 2.0 +
            (m_spaceLeft ? spaceWidth : 0.0) +
            (m_spaceRight ? spaceWidth : 0.0);
 }
 
 void GenericTextNote::paint(qreal height, const QFontMetricsF &fontMetrics, const QFont &font, QPainter &painter) const
 {
-    qreal textWidth = width(height, fontMetrics);
-
-    qreal spaceWidth = fontMetrics.width(QChar::fromLatin1(' '));
-    qreal spaceMarginLeft  = (m_spaceLeft ? spaceWidth : 0.0);
-    qreal spaceMarginRight = (m_spaceRight ? spaceWidth : 0.0);
-
-    if (m_renderBackground) {
-        QRectF rectangle(m_margin / 2.0 + spaceMarginLeft, 0, textWidth - m_margin - spaceMarginLeft - spaceMarginRight, height);
-        painter.setPen(Qt::NoPen);
-        painter.setBrush(m_backgroundBrush);
-        if (m_cornerRadius > 0) {
-            painter.drawRoundedRect(rectangle, m_cornerRadius, m_cornerRadius);
+    const NoteStyle &style = NoteStyles::style(m_style);
+
+    qreal spaceMarginLeft = (m_spaceLeft ? fontMetrics.width(QChar::fromLatin1(' ')) : 0.0);
+
+    if (style.renderBackground) {
+        QRectF rectangle(style.margin / 2.0 + spaceMarginLeft, 0, fontMetrics.boundingRect(m_text).width() + style.margin, height);
+
+        // Antialiased rounded rectangles are many times slower than filled ones, skip them when the rounding would not show
+        qreal radius = qMin(style.cornerRadius, qMin(rectangle.width(), rectangle.height()) / 2.0);
+        if (radius * painter.deviceTransform().m11() < MIN_VISIBLE_CORNER_RADIUS) {
+            painter.fillRect(rectangle, style.background);
         } else {
-            painter.drawRect(rectangle);
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(style.background);
+            painter.drawRoundedRect(rectangle, radius, radius);
         }
     }
 
-    QPen pen(Qt::SolidLine);
-    pen.setColor(m_textColor);
-    painter.setPen(pen);
-    painter.setFont(font);
-    painter.drawText(m_margin + spaceMarginLeft, fontMetrics.ascent(), m_text);
+    // Setting the pen or the font marks the painter state dirty even when nothing changes, only set what differs
+    const QPen &pen = painter.pen();
+    if (pen.style() != Qt::SolidLine || pen.color() != style.textColor) {
+        painter.setPen(style.textColor);
+    }
+    if (painter.font() != font) {
+        painter.setFont(font);
+    }
+    painter.drawText(style.margin + spaceMarginLeft, fontMetrics.ascent(), m_text);
+}
+
+QString GenericTextNote::toolTip() const
+{
+    return m_toolTip;
+}
+
+QString GenericTextNote::text() const
+{
+    return m_text;
+}
+
+size_t GenericTextNote::memoryUsage() const
+{
+    return sizeof(*this) + (m_text.capacity() + m_toolTip.capacity()) * sizeof(QChar);
 }
 
 void GenericTextNote::setText(QString text)
@@ -80,10 +118,23 @@ void GenericTextNote::setText(QString text)
     m_text = text;
 }
 
+void GenericTextNote::setToolTip(QString toolTip)
+{
+    m_toolTip = toolTip;
+}
+
+bool GenericTextNote::spaceLeft() const {
+    return m_spaceLeft;
+}
+
 void GenericTextNote::setSpaceLeft(bool spaceLeft) {
     m_spaceLeft = spaceLeft;
 }
 
+bool GenericTextNote::spaceRight() const {
+    return m_spaceRight;
+}
+
 void GenericTextNote::setSpaceRight(bool spaceRight) {
     m_spaceRight = spaceRight;
 }
@@ -28,12 +28,19 @@
 #include <KTextEditor/InlineNoteInterface>
 
 #include "inlinenotebase.h"
+#include "notestyle.h"
 
 
+/**
+ * Text drawn with one of the shared NoteStyles.
+ */
 class GenericTextNote : public InlineNoteBase
 {
     constexpr static qreal MARGIN = 1.0;
 
+    // Corner radius in device pixels below which the rounding is not visible and a plain rectangle is filled instead
+    constexpr static qreal MIN_VISIBLE_CORNER_RADIUS = 1.0;
+
 public:
     GenericTextNote(int column, QString text, QColor textColor, QBrush backgroundBrush, bool renderBackground, qreal cornerRadius, qreal margin = MARGIN);
     virtual ~GenericTextNote();
@@ -41,22 +48,24 @@ public:
     int column() const override;
     qreal width(qreal height, const QFontMetricsF &fontMetrics) const override;
     void paint(qreal height, const QFontMetricsF &fontMetrics, const QFont &font, QPainter &painter) const override;
+    QString toolTip() const override;
+    QString text() const override;
+    size_t memoryUsage() const override;
 
     void setText(QString text);
+    void setToolTip(QString toolTip);
 
+    bool spaceLeft() const;
     void setSpaceLeft(bool spaceLeft);
+    bool spaceRight() const;
     void setSpaceRight(bool spaceRight);
 
 private:
     int m_column;
     QString m_text;
+    QString m_toolTip;
 
-    QColor m_textColor;
-    QBrush m_backgroundBrush;
-    bool m_renderBackground;
-    qreal m_cornerRadius;
-
-    qreal m_margin;
+    NoteStyles::Index m_style;
 
     bool m_spaceLeft;
     bool m_spaceRight;
@@ -1,6 +1,10 @@
 #ifndef INLINENOTEBASE_H
 #define INLINENOTEBASE_H
 
+#include <cstddef>
+
+#include <QString>
+
 class InlineNoteBase
 {
 public:
@@ -50,6 +54,28 @@ public:
      * \param painter painter prepared for rendering the note
      */
     virtual void paint(qreal height, const QFontMetricsF &fontMetrics, const QFont &font, QPainter &painter) const = 0;
+
+    /**
+     * Text shown when the mouse hovers over the note.
+     *
+     * \return the tool tip text or empty string if the note has no tool tip
+     */
+    virtual QString toolTip() const { return QString(); }
+
+    /**
+     * Plain text of the note, for clients that render the notes on their
+     * own, such as the LSP server.
+     *
+     * \return the text or empty string if the note is purely graphical
+     */
+    virtual QString text() const { return QString(); }
+
+    /**
+     * Approximate amount of memory occupied by the note.
+     *
+     * \return the size of the note including its heap allocated data in bytes
+     */
+    virtual size_t memoryUsage() const = 0;
 };
 
 #endif
@@ -109,6 +109,11 @@ void MemberSizeNote::paint(qreal height, const QFontMetricsF& fontMetrics, const
     drawRectangles(m_padding);
 }
 
+size_t MemberSizeNote::memoryUsage() const
+{
+    return sizeof(*this);
+}
+
 void MemberSizeNote::setColumn(int column)
 {
     m_column = column;
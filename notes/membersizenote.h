@@ -44,6 +44,7 @@ public:
     int column() const override;
     qreal width(qreal height, const QFontMetricsF& fontMetrics) const override;
     void paint(qreal height, const QFontMetricsF& fontMetrics, const QFont& font, QPainter& painter) const override;
+    size_t memoryUsage() const override;
 
     void setColumn(int column);
 
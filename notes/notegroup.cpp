@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QStringList>
+
+#include "notegroup.h"
+
+
+NoteGroup::NoteGroup(const QVector<QSharedPointer<const InlineNoteBase>>& notes)
+{
+    for (const auto &note : notes) {
+        if (const NoteGroup *group = dynamic_cast<const NoteGroup*>(note.data())) {
+            m_notes += group->m_notes;
+        } else {
+            m_notes.append(note);
+        }
+    }
+}
+
+int NoteGroup::column() const
+{
+    return m_notes.first()->column();
+}
+
+qreal NoteGroup::width(qreal height, const QFontMetricsF& fontMetrics) const
+{
+    qreal width = 0;
+    for (const auto &note : m_notes) {
+        width += note->width(height, fontMetrics);
+    }
+    return width;
+}
+
+void NoteGroup::paint(qreal height, const QFontMetricsF& fontMetrics, const QFont& font, QPainter& painter) const
+{
+    for (const auto &note : m_notes) {
+        painter.save();
+        note->paint(height, fontMetrics, font, painter);
+        painter.restore();
+
+        painter.translate(note->width(height, fontMetrics), 0);
+    }
+}
+
+QString NoteGroup::toolTip() const
+{
+    QStringList toolTips;
+    for (const auto &note : m_notes) {
+        const QString toolTip = note->toolTip();
+        if (!toolTip.isEmpty()) {
+            toolTips.append(toolTip);
+        }
+    }
+    return toolTips.join(QLatin1Char('\n'));
+}
+
+QString NoteGroup::text() const
+{
+    QStringList texts;
+    for (const auto &note : m_notes) {
+        const QString text = note->text();
+        if (!text.isEmpty()) {
+            texts.append(text);
+        }
+    }
+    return texts.join(QLatin1Char(' '));
+}
+
+size_t NoteGroup::memoryUsage() const
+{
+    size_t usage = sizeof(*this) + m_notes.capacity() * sizeof(QSharedPointer<const InlineNoteBase>);
+    for (const auto &note : m_notes) {
+        usage += note->memoryUsage();
+    }
+    return usage;
+}
+
+const QVector<QSharedPointer<const InlineNoteBase>>& NoteGroup::notes() const
+{
+    return m_notes;
+}
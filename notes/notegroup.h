@@ -0,0 +1,65 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NOTEGROUP_H
+#define NOTEGROUP_H
+
+#include <QFont>
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "inlinenotebase.h"
+
+
+/**
+ * Several notes placed at the same position, drawn one after another.
+ *
+ * The editor shows one note per position and provider, so NoteStore puts
+ * the notes of different passes that end up at the same position, like an
+ * argument name and the copy of that argument, into a group.
+ */
+class NoteGroup : public InlineNoteBase
+{
+public:
+    /**
+     * \param notes at least two, notes that are groups themselves are not
+     *        nested but their notes taken over
+     */
+    explicit NoteGroup(const QVector<QSharedPointer<const InlineNoteBase>>& notes);
+    ~NoteGroup() override = default;
+
+    int column() const override;
+    qreal width(qreal height, const QFontMetricsF& fontMetrics) const override;
+    void paint(qreal height, const QFontMetricsF& fontMetrics, const QFont& font, QPainter& painter) const override;
+    QString toolTip() const override;
+    QString text() const override;
+    size_t memoryUsage() const override;
+
+    /**
+     * The grouped notes, in the order they are drawn.
+     */
+    const QVector<QSharedPointer<const InlineNoteBase>>& notes() const;
+
+private:
+    QVector<QSharedPointer<const InlineNoteBase>> m_notes;
+};
+
+#endif // NOTEGROUP_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+
+#include "notegroup.h"
+#include "notestore.h"
+
+
+void NoteStore::insert(const KTextEditor::Cursor& position, InlineNoteBase* note)
+{
+    place(position, QSharedPointer<const InlineNoteBase>(note), false);
+}
+
+void NoteStore::merge(NoteStore& other)
+{
+    take(other, false);
+}
+
+void NoteStore::update(NoteStore& other)
+{
+    take(other, true);
+}
+
+QSharedPointer<const NoteStore> NoteStore::snapshot() const
+{
+    return copy();
+}
+
+QSharedPointer<NoteStore> NoteStore::copy() const
+{
+    auto store = QSharedPointer<NoteStore>::create();
+    store->m_notes = m_notes;
+    store->m_lineColumns = m_lineColumns;
+    store->m_memoryUsage = m_memoryUsage;
+    return store;
+}
+
+const InlineNoteBase* NoteStore::find(const KTextEditor::Cursor& position) const
+{
+    auto iter = m_notes.constFind(position);
+    if (iter == m_notes.constEnd()) {
+        return nullptr;
+    }
+    return iter->data();
+}
+
+QVector<const InlineNoteBase*> NoteStore::findAll(const KTextEditor::Cursor& position) const
+{
+    QVector<const InlineNoteBase*> notes;
+
+    const InlineNoteBase *note = find(position);
+    if (const NoteGroup *group = dynamic_cast<const NoteGroup*>(note)) {
+        for (const auto &grouped : group->notes()) {
+            notes.append(grouped.data());
+        }
+    } else if (note) {
+        notes.append(note);
+    }
+    return notes;
+}
+
+QList<KTextEditor::Cursor> NoteStore::positions() const
+{
+    return m_notes.keys();
+}
+
+QVector<int> NoteStore::columns(int line) const
+{
+    // Most lines have no notes, share one empty vector for all of them
+    static const QVector<int> noColumns;
+
+    auto iter = m_lineColumns.constFind(line);
+    return (iter != m_lineColumns.constEnd()) ? *iter : noColumns;
+}
+
+void NoteStore::take(NoteStore& other, bool replace)
+{
+    for (auto iter = other.m_notes.constBegin(); iter != other.m_notes.constEnd(); ++iter) {
+        place(iter.key(), iter.value(), replace);
+    }
+
+    other.m_notes.clear();
+    other.m_lineColumns.clear();
+    other.m_memoryUsage = 0;
+}
+
+void NoteStore::place(const KTextEditor::Cursor& position, const QSharedPointer<const InlineNoteBase>& note, bool replace)
+{
+    auto iter = m_notes.find(position);
+    if (iter == m_notes.end()) {
+        addColumn(position);
+        m_notes.insert(position, note);
+        m_memoryUsage += note->memoryUsage() + NODE_OVERHEAD;
+        return;
+    }
+
+    // The existing note may be shown by a snapshot, so it is not changed but replaced
+    m_memoryUsage -= (*iter)->memoryUsage();
+    if (replace) {
+        *iter = note;
+    } else {
+        *iter = QSharedPointer<const InlineNoteBase>(new NoteGroup({ *iter, note }));
+    }
+    m_memoryUsage += (*iter)->memoryUsage();
+}
+
+void NoteStore::addColumn(const KTextEditor::Cursor& position)
+{
+    QVector<int> &columns = m_lineColumns[position.line()];
+    if (columns.isEmpty()) {
+        m_memoryUsage += LINE_OVERHEAD;
+    }
+
+    columns.insert(std::lower_bound(columns.begin(), columns.end(), position.column()), position.column());
+    m_memoryUsage += sizeof(int);
+}
+
+int NoteStore::count() const
+{
+    return m_notes.size();
+}
+
+size_t NoteStore::memoryUsage() const
+{
+    return m_memoryUsage;
+}
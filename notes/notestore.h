@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NOTESTORE_H
+#define NOTESTORE_H
+
+#include <QHash>
+#include <QMap>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <KTextEditor/Cursor>
+
+#include "inlinenotebase.h"
+
+
+/**
+ * Owns all notes of one document, ordered by their position.
+ *
+ * The store is filled once by NoteBuilder and afterwards only read, so it
+ * can be shared between providers and the note cache. Partial results of a
+ * store still being filled are shown through snapshot(), never directly.
+ *
+ * The columns of the notes are kept per line as well, so that columns(),
+ * which the editor calls for every visible line on every repaint, is just
+ * a lookup returning an implicitly shared vector.
+ */
+class NoteStore
+{
+    // Rough size of one QMap node holding the note pointer, with its reference count
+    static constexpr size_t NODE_OVERHEAD = 72;
+
+    // Rough size of one QHash node and the vector of columns of a line, without the columns
+    static constexpr size_t LINE_OVERHEAD = 56;
+
+public:
+    NoteStore() = default;
+
+    /**
+     * Insert a note, taking ownership of it. If there already is a note at
+     * the same position, both are put into a NoteGroup, the new one drawn
+     * after it.
+     */
+    void insert(const KTextEditor::Cursor& position, InlineNoteBase* note);
+
+    /**
+     * Move all notes of the other store into this one, as if they were
+     * inserted in position order.
+     */
+    void merge(NoteStore& other);
+
+    /**
+     * Like merge(), but the notes of the other store replace the ones at
+     * the same positions, for notes of lines that were computed again.
+     */
+    void update(NoteStore& other);
+
+    /**
+     * Immutable copy of the store as it is now. The notes and the columns
+     * are shared with this store until it is changed, which copies them
+     * once, so the snapshot stays valid and unchanged while this store is
+     * being filled further, also from another thread.
+     */
+    QSharedPointer<const NoteStore> snapshot() const;
+
+    /**
+     * Like snapshot(), but the copy can be changed further.
+     */
+    QSharedPointer<NoteStore> copy() const;
+
+    /**
+     * The note at the position, a NoteGroup if several were inserted there.
+     */
+    const InlineNoteBase* find(const KTextEditor::Cursor& position) const;
+
+    /**
+     * The notes at the position, a group split into its notes.
+     */
+    QVector<const InlineNoteBase*> findAll(const KTextEditor::Cursor& position) const;
+
+    /**
+     * Positions of all notes, in document order.
+     */
+    QList<KTextEditor::Cursor> positions() const;
+
+    /**
+     * Sorted columns of the notes on the line. Does not allocate.
+     */
+    QVector<int> columns(int line) const;
+
+    int count() const;
+    size_t memoryUsage() const;
+
+private:
+    Q_DISABLE_COPY(NoteStore)
+
+    void take(NoteStore& other, bool replace);
+    void place(const KTextEditor::Cursor& position, const QSharedPointer<const InlineNoteBase>& note, bool replace);
+    void addColumn(const KTextEditor::Cursor& position);
+
+    // Shared with the snapshots, grouped notes stay alive while some snapshot shows them
+    QMap<KTextEditor::Cursor, QSharedPointer<const InlineNoteBase>> m_notes;
+    QHash<int, QVector<int>> m_lineColumns;
+    size_t m_memoryUsage = 0;
+};
+
+#endif // NOTESTORE_H
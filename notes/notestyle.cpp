@@ -0,0 +1,109 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <debug.h>
+
+#include "notestyle.h"
+
+
+constexpr int NoteStyles::MAX_STYLES;
+
+
+namespace {
+
+struct Registry
+{
+    // Index 0 is the default style
+    Registry() : count(1) {}
+
+    NoteStyle styles[NoteStyles::MAX_STYLES];
+    QAtomicInt count;
+
+    QMutex mutex;
+    QHash<NoteStyle, NoteStyles::Index> indexes;
+};
+
+Registry& registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+}
+
+
+bool NoteStyle::operator==(const NoteStyle& other) const
+{
+    return textColor == other.textColor &&
+           background == other.background &&
+           renderBackground == other.renderBackground &&
+           cornerRadius == other.cornerRadius &&
+           margin == other.margin;
+}
+
+uint qHash(const NoteStyle& style, uint seed)
+{
+    // The brush is only compared, the notes use solid colors
+    return qHash(style.textColor.rgba(), seed) ^
+           qHash(style.background.color().rgba(), seed) ^
+           qHash(style.renderBackground, seed) ^
+           qHash(style.cornerRadius, seed) ^
+           qHash(style.margin, seed);
+}
+
+NoteStyles::Index NoteStyles::index(const NoteStyle& style)
+{
+    Registry& r = registry();
+    QMutexLocker lock(&r.mutex);
+
+    auto iter = r.indexes.constFind(style);
+    if (iter != r.indexes.constEnd()) {
+        return *iter;
+    }
+
+    const int count = r.count.load();
+    if (count >= MAX_STYLES) {
+        if (count == MAX_STYLES) {
+            qCDebug(KDEV_SOURCEINFO) << "Note style registry is full, further styles are shown with the default one";
+            r.count.storeRelease(count + 1);
+        }
+        return 0;
+    }
+
+    // The style is written before the count is published, so style() never sees it half constructed
+    r.styles[count] = style;
+    r.indexes.insert(style, Index(count));
+    r.count.storeRelease(count + 1);
+    return Index(count);
+}
+
+const NoteStyle& NoteStyles::style(Index index)
+{
+    Q_ASSERT(index < qMin(registry().count.loadAcquire(), MAX_STYLES));
+    return registry().styles[index];
+}
+
+int NoteStyles::count()
+{
+    return qMin(registry().count.loadAcquire(), MAX_STYLES);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NOTESTYLE_H
+#define NOTESTYLE_H
+
+#include <QBrush>
+#include <QColor>
+#include <QHash>
+
+
+/**
+ * Colors and shape of a text note.
+ */
+struct NoteStyle
+{
+    QColor textColor;
+    QBrush background;
+    bool renderBackground = false;
+    qreal cornerRadius = 0.0;
+    qreal margin = 1.0;
+
+    bool operator==(const NoteStyle& other) const;
+};
+
+uint qHash(const NoteStyle& style, uint seed = 0);
+
+
+/**
+ * Registry of the styles shared by the text notes.
+ *
+ * A document has thousands of notes but only a handful of distinct styles,
+ * so the notes keep just the index of theirs. Styles are registered from
+ * any thread, including the ones gathering notes in background, and never
+ * removed, so an index stays valid for the lifetime of the process and
+ * looking it up while painting takes no lock.
+ */
+class NoteStyles
+{
+public:
+    typedef quint16 Index;
+
+    // Registered styles at most, a fixed capacity lets style() read without a lock
+    static constexpr int MAX_STYLES = 1024;
+
+    /**
+     * Index of the style, registers the style if it is new. Once the
+     * registry is full, new styles get the index of the default style.
+     */
+    static Index index(const NoteStyle& style);
+
+    static const NoteStyle& style(Index index);
+
+    static int count();
+};
+
+#endif // NOTESTYLE_H
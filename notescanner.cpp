@@ -0,0 +1,385 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "notescanner.h"
+#include "argumentscanner.h"
+
+
+namespace {
+
+// Converts increasing offsets into a text that starts at the given position to cursors
+class CursorWalker
+{
+public:
+    CursorWalker(const QString& text, const KTextEditor::Cursor& origin)
+        : m_text(text)
+        , m_cursor(origin)
+    {
+    }
+
+    KTextEditor::Cursor cursorAt(int offset)
+    {
+        Q_ASSERT(offset >= m_offset);
+        for (; m_offset < offset; m_offset++) {
+            if (m_text.at(m_offset) == '\n') {
+                m_cursor.setColumn(0);
+                m_cursor.setLine(m_cursor.line() + 1);
+            } else {
+                m_cursor.setColumn(m_cursor.column() + 1);
+            }
+        }
+        return m_cursor;
+    }
+
+private:
+    const QString& m_text;
+    KTextEditor::Cursor m_cursor;
+    int m_offset = 0;
+};
+
+bool isIdentifierCharacter(const QChar c)
+{
+    return c.isLetterOrNumber() || c == '_';
+}
+
+bool isKeywordAt(const QString& text, int offset, const QLatin1String& keyword)
+{
+    if (offset < 0 || offset + keyword.size() > text.size()) return false;
+    if (text.midRef(offset, keyword.size()) != keyword) return false;
+    if (offset > 0 && isIdentifierCharacter(text.at(offset - 1))) return false;
+    return offset + keyword.size() == text.size() || !isIdentifierCharacter(text.at(offset + keyword.size()));
+}
+
+bool endsWithKeyword(const QString& text, const QLatin1String& keyword)
+{
+    return isKeywordAt(text, text.size() - keyword.size(), keyword);
+}
+
+// Start of the identifier ending right before the offset
+int identifierStart(const QString& text, int offset)
+{
+    while (offset > 0 && isIdentifierCharacter(text.at(offset - 1))) {
+        offset--;
+    }
+    return offset;
+}
+
+}
+
+
+constexpr int NoteScanner::MAX_LOOP_HEADER_LINES;
+
+
+NoteScanner::NoteScanner(const TextSource& text, bool showArgumentNames, bool showDefaultValues)
+    : m_text(text)
+    , m_showArgumentNames(showArgumentNames)
+    , m_showDefaultValues(showDefaultValues)
+    , m_loopText(text)
+{
+}
+
+void NoteScanner::sortRecords(QVector<EnumeratorRecord>& enumerators, QVector<CallSiteRecord>& callSites)
+{
+    // Records come in the order of the contexts
+    std::sort(enumerators.begin(), enumerators.end(), [](const EnumeratorRecord& a, const EnumeratorRecord& b) {
+        return a.position < b.position;
+    });
+    std::sort(callSites.begin(), callSites.end(), [](const CallSiteRecord& a, const CallSiteRecord& b) {
+        return a.position < b.position;
+    });
+}
+
+void NoteScanner::setRecords(const QVector<EnumeratorRecord>& enumerators, const QVector<CallSiteRecord>& callSites)
+{
+    m_enumerators = enumerators;
+    m_callSites = callSites;
+    m_nextEnumerator = 0;
+    m_nextCallSite = 0;
+
+    m_scopes.clear();
+    for (const auto &record : callSites) {
+        m_scopes += record.scopes;
+    }
+    std::sort(m_scopes.begin(), m_scopes.end());
+    m_scopes.erase(std::unique(m_scopes.begin(), m_scopes.end()), m_scopes.end());
+    m_nextScope = 0;
+}
+
+bool NoteScanner::atEnd() const
+{
+    return m_nextEnumerator >= m_enumerators.size() && m_nextCallSite >= m_callSites.size();
+}
+
+bool NoteScanner::nextIsEnumerator() const
+{
+    return m_nextCallSite >= m_callSites.size() ||
+        (m_nextEnumerator < m_enumerators.size() && m_enumerators.at(m_nextEnumerator).position < m_callSites.at(m_nextCallSite).position);
+}
+
+KTextEditor::Cursor NoteScanner::nextPosition() const
+{
+    return nextIsEnumerator() ? m_enumerators.at(m_nextEnumerator).position : m_callSites.at(m_nextCallSite).position;
+}
+
+void NoteScanner::scanNext(QVector<ScannedNote>& notes)
+{
+    if (nextIsEnumerator()) {
+        scanEnumerator(m_enumerators.at(m_nextEnumerator++), notes);
+    } else {
+        scanCallSite(m_callSites.at(m_nextCallSite++), notes);
+    }
+}
+
+void NoteScanner::skipNext()
+{
+    if (nextIsEnumerator()) {
+        m_nextEnumerator++;
+    } else {
+        m_nextCallSite++;
+    }
+}
+
+void NoteScanner::scanEnumerator(const EnumeratorRecord& record, QVector<ScannedNote>& notes)
+{
+    const KTextEditor::Cursor &pos = record.position;
+
+    // XXX: Ugly and slow hack to figure out whether the enum value is set explicitly or not.
+    QString followingText = m_text.text(KTextEditor::Range(pos.line(), pos.column(), pos.line(), pos.column() + 100 /*xxx*/ ));
+    if (followingText.trimmed().startsWith('=')) return;
+
+    notes.append({ScannedNote::EnumValue, pos, record.value});
+}
+
+void NoteScanner::scanCallSite(const CallSiteRecord& record, QVector<ScannedNote>& notes)
+{
+    const KTextEditor::Cursor &pos = record.position;
+    const int argumentCount = record.argumentNames.size();
+
+    // The use of a type is only allocated if it is the operand of a new expression, there is nothing else to match
+    if (record.allocationIsNew) {
+        if (record.start.line() != pos.line()) return;
+
+        // Skip the qualification of the type
+        QString precedingText = m_text.text(KTextEditor::Range(pos.line(), 0, pos.line(), record.start.column())).trimmed();
+        while (precedingText.endsWith(QLatin1String("::"))) {
+            precedingText.chop(2);
+            precedingText.truncate(identifierStart(precedingText, precedingText.size()));
+            precedingText = precedingText.trimmed();
+        }
+        if (!endsWithKeyword(precedingText, QLatin1String("new"))) return;
+
+        const int depth = loopDepth(record.scopes);
+        if (depth > 0) {
+            notes.append({ScannedNote::Allocation, record.start, record.allocation, depth});
+        }
+        return;
+    }
+
+    // XXX: Ugly hack, the call may not fit into the fixed window of following text
+    const QString followingText = m_text.text(KTextEditor::Range(pos.line(), pos.column(), pos.line() + 10 /* xxx */, pos.column() + 500 /* xxx */ ));
+    // The note after the call needs the closing parenthesis, the rest stops after the known arguments
+    const auto arguments = ArgumentScanner::scan(followingText, record.calleeSize.isEmpty() ? argumentCount : std::numeric_limits<int>::max());
+    const int argumentsFound = qMin(arguments.argumentStarts.size(), argumentCount);
+
+    // Allocating calls are marked even if the scanner does not recognize the call
+    if (!record.allocation.isEmpty()) {
+        const int depth = loopDepth(record.scopes);
+        if (depth > 0) {
+            notes.append({ScannedNote::Allocation, record.start, record.allocation, depth});
+        }
+    }
+
+    if (!arguments.isCall) return;
+
+    CursorWalker walker(followingText, pos);
+
+    // Calls qualified with the class name are not dispatched dynamically
+    if (record.dispatch != CallSiteRecord::StaticDispatch) {
+        bool qualified = false;
+        if (record.start.line() == pos.line()) {
+            const QString precedingText = m_text.text(KTextEditor::Range(pos.line(), 0, pos.line(), record.start.column()));
+            qualified = precedingText.trimmed().endsWith(QLatin1String("::"));
+        }
+        if (!qualified) {
+            notes.append({record.dispatch == CallSiteRecord::FinalDispatch ? ScannedNote::FinalCall : ScannedNote::VirtualCall, record.start, QString()});
+        }
+    }
+
+    // Every time we find beginning of expression in place of argument, place a note with the argument name,
+    // and one for arguments that are copied into the call after it. The walker only goes forward, so both in one pass.
+    const bool showCopies = !record.argumentCopies.isEmpty();
+    for (int argumentIndex = 0; argumentIndex < argumentsFound; argumentIndex++) {
+        const QString identifier = m_showArgumentNames ? record.argumentNames.at(argumentIndex) : QString();
+        const QString copy = showCopies ? record.argumentCopies.at(argumentIndex) : QString();
+        if (identifier.isEmpty() && copy.isEmpty()) continue;
+
+        const KTextEditor::Cursor argumentStart = walker.cursorAt(arguments.argumentStarts.at(argumentIndex));
+        if (!identifier.isEmpty()) {
+            notes.append({ScannedNote::ArgumentName, argumentStart, identifier});
+        }
+        if (!copy.isEmpty()) {
+            notes.append({ScannedNote::ArgumentCopy, argumentStart, copy});
+        }
+    }
+
+    // If we reach the end and still have arguments left, we expect they have default values. Put out note with them.
+    if (m_showDefaultValues && !record.defaultValues.isEmpty() && arguments.closingParenthesis >= 0) {
+        QString text;
+        for (int argumentIndex = argumentsFound; argumentIndex < argumentCount; argumentIndex++) {
+            text += ", ";
+            if (m_showArgumentNames) {
+                const QString &identifier = record.argumentNames.at(argumentIndex);
+                if (!identifier.isEmpty()) text += identifier + ": ";
+            }
+            text += record.defaultValues.at(argumentIndex);
+        }
+
+        if (!text.isEmpty()) {
+            notes.append({ScannedNote::DefaultValues, walker.cursorAt(arguments.closingParenthesis), text});
+        }
+    }
+
+    // Size of the called function, right after the call
+    if (!record.calleeSize.isEmpty() && arguments.closingParenthesis >= 0) {
+        notes.append({ScannedNote::CalleeSize, walker.cursorAt(arguments.closingParenthesis + 1), record.calleeSize});
+    }
+}
+
+int NoteScanner::loopDepth(const QVector<KTextEditor::Cursor>& scopes)
+{
+    // The statement and the body of a loop may both have a scope, count the loop only once
+    QVector<KTextEditor::Cursor> keywords;
+    for (const auto& scope : scopes) {
+        const KTextEditor::Cursor keyword = loopKeyword(scope);
+        if (keyword.isValid() && !keywords.contains(keyword)) {
+            keywords.append(keyword);
+        }
+    }
+    return keywords.size();
+}
+
+KTextEditor::Cursor NoteScanner::loopKeyword(const KTextEditor::Cursor& scopeStart)
+{
+    // Scopes are classified in document order, the ones of the following call sites are not reached yet
+    for (; m_nextScope < m_scopes.size() && m_scopes.at(m_nextScope) <= scopeStart; m_nextScope++) {
+        const KTextEditor::Cursor scope = m_scopes.at(m_nextScope);
+        m_loopKeywords.insert((quint64(scope.line()) << 32) | quint32(scope.column()), classifyScope(scope));
+    }
+
+    const quint64 key = (quint64(scopeStart.line()) << 32) | quint32(scopeStart.column());
+    return m_loopKeywords.value(key, KTextEditor::Cursor::invalid());
+}
+
+KTextEditor::Cursor NoteScanner::classifyScope(const KTextEditor::Cursor& scopeStart)
+{
+    // XXX: Ugly hack, the DUChain has no notion of loops, so look at the text before the scope for the loop header.
+    //      Headers longer than a few lines are not recognized.
+    const int firstLine = qMax(0, scopeStart.line() - MAX_LOOP_HEADER_LINES);
+    if (!m_sweepPosition.isValid() || m_sweepPosition.line() < firstLine) {
+        m_sweepPosition = KTextEditor::Cursor(firstLine, 0);
+        m_headerKeyword = KTextEditor::Cursor::invalid();
+        m_awaitingHeader = false;
+        m_headerDepth = 0;
+        m_loopKeyword = KTextEditor::Cursor::invalid();
+    }
+
+    sweepLoopHeaders(m_loopText.text(KTextEditor::Range(m_sweepPosition, scopeStart)));
+    m_sweepPosition = scopeStart;
+
+    const QString start = m_loopText.text(KTextEditor::Range(scopeStart, KTextEditor::Cursor(scopeStart.line(), scopeStart.column() + 6)));
+    if (isKeywordAt(start, 0, QLatin1String("for")) ||
+        isKeywordAt(start, 0, QLatin1String("while")) ||
+        isKeywordAt(start, 0, QLatin1String("do"))) {
+        return scopeStart;
+    }
+
+    // The scope of the loop statement itself may start in its header
+    if (m_awaitingHeader || m_headerDepth > 0) {
+        return m_headerKeyword;
+    }
+
+    return start.startsWith(QLatin1Char('{')) ? m_loopKeyword : KTextEditor::Cursor::invalid();
+}
+
+void NoteScanner::sweepLoopHeaders(const QString& text)
+{
+    CursorWalker walker(text, m_sweepPosition);
+
+    int i = 0;
+    while (i < text.size()) {
+        const QChar c = text.at(i);
+        const int tokenStart = i;
+
+        // Comments are skipped without affecting what precedes and follows them, literals may contain anything
+        if (c.isSpace()) {
+            i++;
+            continue;
+        }
+        if (c == '/' && i + 1 < text.size() && text.at(i + 1) == '/') {
+            const int end = text.indexOf(QLatin1Char('\n'), i);
+            i = end < 0 ? text.size() : end;
+            continue;
+        }
+        if (c == '/' && i + 1 < text.size() && text.at(i + 1) == '*') {
+            const int end = text.indexOf(QLatin1String("*/"), i + 2);
+            i = end < 0 ? text.size() : end + 2;
+            continue;
+        }
+
+        if (c == '"' || c == '\'') {
+            for (i++; i < text.size() && text.at(i) != c && text.at(i) != '\n'; i++) {
+                if (text.at(i) == '\\') i++;
+            }
+            i++;
+        } else if (isIdentifierCharacter(c)) {
+            while (i < text.size() && isIdentifierCharacter(text.at(i))) {
+                i++;
+            }
+        } else {
+            i++;
+        }
+
+        // Inside the parentheses of a loop header
+        if (m_headerDepth > 0) {
+            if (c == '(') {
+                m_headerDepth++;
+            } else if (c == ')' && --m_headerDepth == 0) {
+                m_loopKeyword = m_headerKeyword;
+            }
+            continue;
+        }
+
+        // Any other token between the loop header and the scope means the scope is not the body
+        const bool awaitingHeader = m_awaitingHeader;
+        m_awaitingHeader = false;
+        m_loopKeyword = KTextEditor::Cursor::invalid();
+
+        if (awaitingHeader && c == '(') {
+            m_headerDepth = 1;
+        } else if (isKeywordAt(text, tokenStart, QLatin1String("for")) || isKeywordAt(text, tokenStart, QLatin1String("while"))) {
+            m_headerKeyword = walker.cursorAt(tokenStart);
+            m_awaitingHeader = true;
+        } else if (isKeywordAt(text, tokenStart, QLatin1String("do"))) {
+            m_loopKeyword = walker.cursorAt(tokenStart);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NOTESCANNER_H
+#define NOTESCANNER_H
+
+#include <QHash>
+#include <QVector>
+
+#include "noterecords.h"
+#include "textsource.h"
+
+
+/**
+ * Matches the records gathered from the DUChain with the text, producing
+ * the notes that depend on it.
+ *
+ * Needs neither the DUChain nor the editor, so it also runs in the
+ * kdevsourceinfo-worker process, see ScanWorker.
+ *
+ * The records are matched in document order, so that the text is read in a
+ * single forward pass. The loops enclosing call sites are recognized in a
+ * second forward pass over the text before the starts of their scopes,
+ * which are always ahead of the call sites in them.
+ */
+class NoteScanner
+{
+    // Loop headers are only looked for this far before the scope of the loop
+    static constexpr int MAX_LOOP_HEADER_LINES = 10;
+
+public:
+    NoteScanner(const TextSource& text, bool showArgumentNames, bool showDefaultValues);
+
+    /**
+     * Sort the records by position, as expected by setRecords().
+     */
+    static void sortRecords(QVector<EnumeratorRecord>& enumerators, QVector<CallSiteRecord>& callSites);
+
+    void setRecords(const QVector<EnumeratorRecord>& enumerators, const QVector<CallSiteRecord>& callSites);
+
+    bool atEnd() const;
+
+    /**
+     * Whether the next record in document order is an enumerator or a call
+     * site, and where it is. Only valid if not atEnd().
+     */
+    bool nextIsEnumerator() const;
+    KTextEditor::Cursor nextPosition() const;
+
+    /**
+     * Match the next record with the text, appending the resulting notes.
+     */
+    void scanNext(QVector<ScannedNote>& notes);
+    void skipNext();
+
+private:
+    void scanEnumerator(const EnumeratorRecord& record, QVector<ScannedNote>& notes);
+    void scanCallSite(const CallSiteRecord& record, QVector<ScannedNote>& notes);
+
+    /**
+     * Number of distinct loops among the given scopes.
+     */
+    int loopDepth(const QVector<KTextEditor::Cursor>& scopes);
+
+    /**
+     * Position of the for, while or do keyword that the scope starting at
+     * the given position belongs to, invalid if it is not a loop. Sweeps
+     * over the scopes of all records up to the given one.
+     */
+    KTextEditor::Cursor loopKeyword(const KTextEditor::Cursor& scopeStart);
+
+    KTextEditor::Cursor classifyScope(const KTextEditor::Cursor& scopeStart);
+    void sweepLoopHeaders(const QString& text);
+
+private:
+    TextStream m_text;
+    const bool m_showArgumentNames;
+    const bool m_showDefaultValues;
+
+    QVector<EnumeratorRecord> m_enumerators;
+    QVector<CallSiteRecord> m_callSites;
+    int m_nextEnumerator = 0;
+    int m_nextCallSite = 0;
+
+    QVector<KTextEditor::Cursor> m_scopes; // Of all call sites, sorted
+    int m_nextScope = 0;
+    QHash<quint64, KTextEditor::Cursor> m_loopKeywords; // By scope start
+
+    // State of the sweep over the text before the scopes
+    TextStream m_loopText;
+    KTextEditor::Cursor m_sweepPosition = KTextEditor::Cursor::invalid();
+    KTextEditor::Cursor m_headerKeyword = KTextEditor::Cursor::invalid(); // Of the for or while whose header is next or being read
+    bool m_awaitingHeader = false;
+    int m_headerDepth = 0; // Parentheses open in the header
+    KTextEditor::Cursor m_loopKeyword = KTextEditor::Cursor::invalid(); // Of the loop whose body may follow
+};
+
+#endif // NOTESCANNER_H
@@ -0,0 +1,507 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QMutexLocker>
+
+#include <KLocalizedString>
+
+#include "demangle.h"
+#include "optremarkdata.h"
+
+#include <debug.h>
+
+
+namespace {
+
+// How often the cancellation is checked while reading records
+constexpr int CANCEL_CHECK_INTERVAL_LINES = 4096;
+
+const QString RECORDS_PATTERN = QStringLiteral("*.opt.yaml");
+
+// Canonical path for absolute names, relative ones depend on where the compiler ran and are kept as they are
+QString sourceKey(const QString& name)
+{
+    if (QDir::isRelativePath(name)) {
+        return QDir::cleanPath(name);
+    }
+
+    const QString canonical = QFileInfo(name).canonicalFilePath();
+    return canonical.isEmpty() ? QDir::cleanPath(name) : canonical;
+}
+
+bool remarkLessThan(const OptRemarkData::Remark& a, const OptRemarkData::Remark& b)
+{
+    if (a.line != b.line) return a.line < b.line;
+    if (a.column != b.column) return a.column < b.column;
+    if (a.kind != b.kind) return a.kind < b.kind;
+    if (a.pass != b.pass) return a.pass < b.pass;
+    if (a.name != b.name) return a.name < b.name;
+    return a.message < b.message;
+}
+
+/**
+ * Reads the YAML documents of the records, one remark per document:
+ *
+ *   --- !Missed
+ *   Pass:            inline
+ *   Name:            NoDefinition
+ *   DebugLoc:        { File: 'a.cpp', Line: 10, Column: 5 }
+ *   Function:        main
+ *   Args:
+ *     - Callee:          _Z3foov
+ *     - String:          ' will not be inlined into '
+ *     ...
+ *   ...
+ *
+ * Only as much YAML as LLVM writes is understood. Flow mappings may be
+ * wrapped over multiple lines.
+ */
+class RecordReader
+{
+public:
+    RecordReader(QFile& file, const QAtomicInt& cancelled)
+        : m_file(file)
+        , m_cancelled(cancelled)
+    {
+    }
+
+    bool isCancelled() const
+    {
+        return m_isCancelled;
+    }
+
+    // Returns false at the end of the file or once cancelled, the file is the name as written in the records
+    bool next(OptRemarkData::Remark& remark, QString& file)
+    {
+        QByteArray line;
+        bool inRecord = false;
+        QByteArray section;
+
+        while (readLine(line)) {
+            if (line.startsWith("--- !")) {
+                inRecord = startRecord(line.mid(5).trimmed(), remark);
+                file.clear();
+                section.clear();
+                continue;
+            }
+
+            if (line == "...") {
+                if (inRecord && !file.isEmpty() && remark.line >= 0) return true;
+                inRecord = false;
+                continue;
+            }
+
+            if (!inRecord || line.trimmed().isEmpty()) continue;
+
+            // Top level keys
+            if (line.at(0) != ' ') {
+                const int colon = line.indexOf(':');
+                if (colon < 0) continue;
+
+                section = line.left(colon);
+                const QByteArray value = line.mid(colon + 1).trimmed();
+                if (section == "Pass") {
+                    remark.pass = intern(scalar(value));
+                } else if (section == "Name") {
+                    remark.name = intern(scalar(value));
+                } else if (section == "Function") {
+                    remark.function = intern(demangle(QString::fromUtf8(scalar(value))).toUtf8());
+                } else if (section == "DebugLoc" && !value.isEmpty()) {
+                    readDebugLoc(flowMapping(value), remark, file);
+                }
+                continue;
+            }
+
+            const QByteArray trimmed = line.trimmed();
+            if (section == "DebugLoc") {
+                // Block mapping, one key per line
+                readDebugLoc(trimmed, remark, file);
+            } else if (section == "Args" && trimmed.startsWith("- ")) {
+                // Every argument is a single key mapping, possibly followed by its own DebugLoc which is not needed
+                const int colon = trimmed.indexOf(':');
+                if (colon < 0) continue;
+
+                const QByteArray key = trimmed.mid(2, colon - 2).trimmed();
+                const QString value = QString::fromUtf8(scalar(trimmed.mid(colon + 1).trimmed()));
+                remark.message += (key == "Callee" || key == "Caller") ? demangle(value) : value;
+            }
+        }
+
+        // The last record may lack its end marker
+        return inRecord && !file.isEmpty() && remark.line >= 0;
+    }
+
+private:
+    bool readLine(QByteArray& line)
+    {
+        if (m_isCancelled || m_file.atEnd()) return false;
+
+        if (++m_lines % CANCEL_CHECK_INTERVAL_LINES == 0 && m_cancelled.loadAcquire()) {
+            m_isCancelled = true;
+            return false;
+        }
+
+        line = m_file.readLine();
+        while (line.endsWith('\n') || line.endsWith('\r')) {
+            line.chop(1);
+        }
+        return true;
+    }
+
+    bool startRecord(const QByteArray& tag, OptRemarkData::Remark& remark)
+    {
+        remark = OptRemarkData::Remark();
+        if (tag == "Passed") {
+            remark.kind = OptRemarkData::Kind::Passed;
+        } else if (tag == "Missed" || tag == "Failure") {
+            remark.kind = OptRemarkData::Kind::Missed;
+        } else if (tag.startsWith("Analysis")) {
+            remark.kind = OptRemarkData::Kind::Analysis;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Joins the lines of a flow mapping and strips the braces
+    QByteArray flowMapping(QByteArray value)
+    {
+        QByteArray line;
+        while (!value.endsWith('}') && readLine(line)) {
+            value += ' ' + line.trimmed();
+        }
+        if (value.startsWith('{')) value.remove(0, 1);
+        if (value.endsWith('}')) value.chop(1);
+        return value;
+    }
+
+    void readDebugLoc(const QByteArray& mapping, OptRemarkData::Remark& remark, QString& file)
+    {
+        for (const QByteArray& entry : splitFlowMapping(mapping)) {
+            const int colon = entry.indexOf(':');
+            if (colon < 0) continue;
+
+            const QByteArray key = entry.left(colon).trimmed();
+            const QByteArray value = scalar(entry.mid(colon + 1).trimmed());
+            if (key == "File") {
+                file = intern(value);
+            } else if (key == "Line") {
+                remark.line = value.toInt() - 1;
+            } else if (key == "Column") {
+                remark.column = value.toInt() - 1;
+            }
+        }
+    }
+
+    // Splits at the commas outside of quotes
+    static QVector<QByteArray> splitFlowMapping(const QByteArray& mapping)
+    {
+        QVector<QByteArray> entries;
+        char quote = 0;
+        int start = 0;
+        for (int i = 0; i < mapping.size(); i++) {
+            const char c = mapping.at(i);
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (c == '\'' || c == '"') {
+                quote = c;
+            } else if (c == ',') {
+                entries.append(mapping.mid(start, i - start));
+                start = i + 1;
+            }
+        }
+        entries.append(mapping.mid(start));
+        return entries;
+    }
+
+    static QByteArray scalar(const QByteArray& value)
+    {
+        if (value.size() >= 2 && value.startsWith('\'') && value.endsWith('\'')) {
+            QByteArray result = value.mid(1, value.size() - 2);
+            result.replace("''", "'");
+            return result;
+        }
+
+        if (value.size() >= 2 && value.startsWith('"') && value.endsWith('"')) {
+            QByteArray result;
+            result.reserve(value.size());
+            for (int i = 1; i < value.size() - 1; i++) {
+                char c = value.at(i);
+                if (c == '\\' && i + 1 < value.size() - 1) {
+                    c = value.at(++i);
+                    if (c == 'n') c = '\n';
+                    else if (c == 't') c = '\t';
+                }
+                result += c;
+            }
+            return result;
+        }
+
+        return value;
+    }
+
+    // Pass names, remark names, functions and files repeat a lot, share their strings
+    QString intern(const QByteArray& value)
+    {
+        auto iter = m_strings.constFind(value);
+        if (iter != m_strings.constEnd()) return *iter;
+
+        const QString string = QString::fromUtf8(value);
+        m_strings.insert(value, string);
+        return string;
+    }
+
+    QFile& m_file;
+    const QAtomicInt& m_cancelled;
+    bool m_isCancelled = false;
+    qint64 m_lines = 0;
+
+    QHash<QByteArray, QString> m_strings;
+};
+
+}
+
+
+bool OptRemarkData::Remark::operator==(const Remark& other) const
+{
+    return kind == other.kind && line == other.line && column == other.column &&
+           pass == other.pass && name == other.name && message == other.message;
+}
+
+QSharedPointer<BuildDataIndex> OptRemarkData::scan(const QString& directory, const QAtomicInt& cancelled, QString* error)
+{
+    const QDir dir(directory);
+    if (!dir.exists() || !dir.isReadable()) {
+        if (error) *error = i18n("Can not read %1", directory);
+        return QSharedPointer<BuildDataIndex>();
+    }
+
+    auto data = QSharedPointer<OptRemarkData>::create();
+    data->m_directory = dir.absolutePath();
+
+    QDirIterator iter(data->m_directory, { RECORDS_PATTERN }, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+    while (iter.hasNext()) {
+        if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+        iter.next();
+        data->addTranslationUnit(iter.fileInfo(), cancelled);
+    }
+    if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+    qCDebug(KDEV_SOURCEINFO) << "Indexed optimization records of" << data->m_units.size() << "translation units covering"
+                             << data->m_unitsBySource.size() << "files in" << data->m_directory;
+    return data;
+}
+
+QSharedPointer<BuildDataIndex> OptRemarkData::refreshed(const QSet<QString>& directories, const QAtomicInt& cancelled) const
+{
+    auto data = QSharedPointer<OptRemarkData>::create();
+    data->m_directory = m_directory;
+    data->m_units = m_units;
+    data->m_unitsBySource = m_unitsBySource;
+    data->m_relativeSourcesByName = m_relativeSourcesByName;
+    data->m_unitsByDirectory = m_unitsByDirectory;
+    {
+        QMutexLocker lock(&m_mergedMutex);
+        data->m_merged = m_merged;
+    }
+
+    QStringList changedSources;
+    for (const QString& directory : directories) {
+        if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+        QSet<QString> present;
+        const QFileInfoList entries = QDir(directory).entryInfoList({ RECORDS_PATTERN }, QDir::Files | QDir::Readable);
+        for (const QFileInfo& info : entries) {
+            const QString path = info.filePath();
+            present.insert(path);
+
+            auto known = data->m_units.constFind(path);
+            if (known != data->m_units.constEnd() && known->lastModified == info.lastModified()) continue;
+
+            changedSources += data->removeTranslationUnit(path);
+            changedSources += data->addTranslationUnit(info, cancelled);
+        }
+
+        // Deleted ones
+        const QSet<QString> known = data->m_unitsByDirectory.value(directory);
+        for (const QString& path : known) {
+            if (!present.contains(path)) {
+                changedSources += data->removeTranslationUnit(path);
+            }
+        }
+    }
+
+    // A record file may have been read only partially
+    if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+    // Relative sources are merged into every file whose path ends with them, drop those too
+    {
+        const QStringList mergedPaths = data->m_merged.keys();
+        for (const QString& source : changedSources) {
+            if (!QDir::isRelativePath(source)) {
+                data->m_merged.remove(source);
+                continue;
+            }
+            for (const QString& path : mergedPaths) {
+                if (path.endsWith(QLatin1Char('/') + source)) {
+                    data->m_merged.remove(path);
+                }
+            }
+        }
+    }
+
+    qCDebug(KDEV_SOURCEINFO) << "Refreshed optimization remarks of" << changedSources.size() << "files in" << directories.size() << "directories";
+    return data;
+}
+
+QStringList OptRemarkData::addTranslationUnit(const QFileInfo& info, const QAtomicInt& cancelled)
+{
+    TranslationUnit unit;
+    unit.lastModified = info.lastModified();
+
+    QFile file(info.filePath());
+    if (file.open(QIODevice::ReadOnly)) {
+        QHash<QString, QVector<Remark>> remarks;
+
+        RecordReader reader(file, cancelled);
+        Remark remark;
+        QString name;
+        while (reader.next(remark, name)) {
+            remarks[sourceKey(name)].append(remark);
+        }
+
+        for (auto iter = remarks.begin(); iter != remarks.end(); ++iter) {
+            std::sort(iter->begin(), iter->end(), remarkLessThan);
+            iter->erase(std::unique(iter->begin(), iter->end()), iter->end());
+            unit.remarks.insert(iter.key(), QSharedPointer<const QVector<Remark>>::create(*iter));
+        }
+    }
+
+    // Remembered even if empty, so it is not read again until it changes
+    const QString path = info.filePath();
+    const QStringList sources = unit.remarks.keys();
+    for (const QString& source : sources) {
+        QStringList& units = m_unitsBySource[source];
+        if (units.isEmpty() && QDir::isRelativePath(source)) {
+            m_relativeSourcesByName[QFileInfo(source).fileName()].append(source);
+        }
+        units.append(path);
+    }
+    m_unitsByDirectory[info.path()].insert(path);
+    m_units.insert(path, unit);
+    return sources;
+}
+
+QStringList OptRemarkData::removeTranslationUnit(const QString& path)
+{
+    auto iter = m_units.find(path);
+    if (iter == m_units.end()) return QStringList();
+
+    const QStringList sources = iter->remarks.keys();
+    for (const QString& source : sources) {
+        QStringList& units = m_unitsBySource[source];
+        units.removeAll(path);
+        if (!units.isEmpty()) continue;
+
+        m_unitsBySource.remove(source);
+        if (QDir::isRelativePath(source)) {
+            const QString name = QFileInfo(source).fileName();
+            QStringList& relative = m_relativeSourcesByName[name];
+            relative.removeAll(source);
+            if (relative.isEmpty()) {
+                m_relativeSourcesByName.remove(name);
+            }
+        }
+    }
+
+    const QString directory = QFileInfo(path).path();
+    QSet<QString>& inDirectory = m_unitsByDirectory[directory];
+    inDirectory.remove(path);
+    if (inDirectory.isEmpty()) {
+        m_unitsByDirectory.remove(directory);
+    }
+
+    m_units.erase(iter);
+    return sources;
+}
+
+QString OptRemarkData::directory() const
+{
+    return m_directory;
+}
+
+QStringList OptRemarkData::dataDirectories() const
+{
+    return m_unitsByDirectory.keys();
+}
+
+QVector<OptRemarkData::Remark> OptRemarkData::remarks(const QString& path) const
+{
+    const QString canonicalPath = sourceKey(QFileInfo(path).absoluteFilePath());
+
+    {
+        QMutexLocker lock(&m_mergedMutex);
+        auto iter = m_merged.constFind(canonicalPath);
+        if (iter != m_merged.constEnd()) {
+            return **iter;
+        }
+    }
+
+    QStringList sources;
+    if (m_unitsBySource.contains(canonicalPath)) {
+        sources.append(canonicalPath);
+    }
+    for (const QString& relative : m_relativeSourcesByName.value(QFileInfo(canonicalPath).fileName())) {
+        if (canonicalPath.endsWith(QLatin1Char('/') + relative)) {
+            sources.append(relative);
+        }
+    }
+
+    auto merged = QSharedPointer<QVector<Remark>>::create();
+    for (const QString& source : sources) {
+        for (const QString& unitPath : m_unitsBySource.value(source)) {
+            const auto unitRemarks = m_units.value(unitPath).remarks.value(source);
+            if (unitRemarks) {
+                *merged += *unitRemarks;
+            }
+        }
+    }
+    std::sort(merged->begin(), merged->end(), remarkLessThan);
+    merged->erase(std::unique(merged->begin(), merged->end()), merged->end());
+
+    QMutexLocker lock(&m_mergedMutex);
+    m_merged.insert(canonicalPath, merged);
+    return *merged;
+}
+
+int OptRemarkData::fileCount() const
+{
+    return m_unitsBySource.size();
+}
+
+int OptRemarkData::translationUnitCount() const
+{
+    return m_units.size();
+}
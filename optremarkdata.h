@@ -0,0 +1,107 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef OPTREMARKDATA_H
+#define OPTREMARKDATA_H
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "builddataindex.h"
+
+
+/**
+ * Optimization remarks from the records clang writes with
+ * -fsave-optimization-record, for the optimization remark notes.
+ *
+ * Every translation unit gets its own `.opt.yaml` file next to its object
+ * file. They get very large, so they are read line by line and only the
+ * fields shown in the notes are kept. The remarks of every record file are
+ * kept separately, refreshing the index only reads the files of the
+ * translation units that were built again.
+ */
+class OptRemarkData : public BuildDataIndex
+{
+public:
+    enum class Kind : quint8 {
+        Passed,
+        Missed,
+        Analysis,
+    };
+
+    struct Remark {
+        Kind kind = Kind::Analysis;
+        int line = -1;   // Starting at 0
+        int column = -1; // Starting at 0, unknown if negative
+        QString pass;    // Like "inline" or "loop-vectorize"
+        QString name;    // Identifies the remark within the pass, like "NoDefinition"
+        QString function;
+        QString message;
+
+        bool operator==(const Remark& other) const;
+    };
+
+    /**
+     * Index the records in the directory, see BuildDataIndex::ScanFunction.
+     */
+    static QSharedPointer<BuildDataIndex> scan(const QString& directory, const QAtomicInt& cancelled, QString* error);
+
+    QSharedPointer<BuildDataIndex> refreshed(const QSet<QString>& directories, const QAtomicInt& cancelled) const override;
+    QString directory() const override;
+    QStringList dataDirectories() const override;
+
+    /**
+     * Remarks about the file from all translation units, ordered by position.
+     * Headers are compiled as part of many translation units, remarks that
+     * are the same in several of them are only returned once.
+     *
+     * Files are matched by canonical path, or by the end of their path if the
+     * records name them relative to the directory the compiler ran in.
+     */
+    QVector<Remark> remarks(const QString& path) const;
+
+    int fileCount() const;
+    int translationUnitCount() const;
+
+private:
+    struct TranslationUnit {
+        QDateTime lastModified;
+        QHash<QString, QSharedPointer<const QVector<Remark>>> remarks; // By source, see sourceKey()
+    };
+
+    // Both return the sources whose remarks changed
+    QStringList addTranslationUnit(const QFileInfo& info, const QAtomicInt& cancelled);
+    QStringList removeTranslationUnit(const QString& path);
+
+    QString m_directory;
+
+    QHash<QString, TranslationUnit> m_units; // By path of the records
+    QHash<QString, QStringList> m_unitsBySource;
+    QHash<QString, QStringList> m_relativeSourcesByName; // Sources named relatively, by file name
+    QHash<QString, QSet<QString>> m_unitsByDirectory;
+
+    // Merged remarks of the files asked for so far
+    mutable QMutex m_mergedMutex;
+    mutable QHash<QString, QSharedPointer<const QVector<Remark>>> m_merged;
+};
+
+#endif // OPTREMARKDATA_H
@@ -0,0 +1,479 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cctype>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QVarLengthArray>
+#include <QVector>
+
+#include <KLocalizedString>
+
+#include "profiledata.h"
+
+
+namespace {
+
+// How often the progress is published and the cancellation checked
+constexpr int PROGRESS_INTERVAL_LINES = 4096;
+
+struct Location {
+    int file = -1; // Unknown if negative
+    int line = -1; // Starting at 0
+};
+
+// Costs by file name as it appears in the profile, converted to canonical paths once at the end
+class Accumulator
+{
+public:
+    int fileId(const QByteArray& name)
+    {
+        if (name.isEmpty() || name == "??") return -1;
+
+        auto iter = m_fileIds.constFind(name);
+        if (iter != m_fileIds.constEnd()) return *iter;
+
+        const int id = names.size();
+        m_fileIds.insert(name, id);
+        names.append(name);
+        files.append(QHash<int, ProfileData::LineCost>());
+        return id;
+    }
+
+    void addSelf(const Location& location, qint64 cost)
+    {
+        files[location.file][location.line].self += cost;
+    }
+
+    void addInclusive(const Location& location, qint64 cost)
+    {
+        files[location.file][location.line].inclusive += cost;
+    }
+
+    // Innermost frame first, frames without line information have an unknown location
+    void addStack(const QVector<Location>& frames, qint64 cost)
+    {
+        totalCost += cost;
+        if (frames.isEmpty()) return;
+
+        if (frames.first().file >= 0) {
+            addSelf(frames.first(), cost);
+        }
+
+        // Recursive calls must not count the same line multiple times
+        QVarLengthArray<Location, 64> seen;
+        for (const Location &frame : frames) {
+            if (frame.file < 0) continue;
+
+            bool duplicate = false;
+            for (const Location &other : seen) {
+                if (other.file == frame.file && other.line == frame.line) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (duplicate) continue;
+
+            seen.append(frame);
+            addInclusive(frame, cost);
+        }
+    }
+
+    QVector<QByteArray> names;
+    QVector<QHash<int, ProfileData::LineCost>> files;
+    qint64 totalCost = 0;
+
+private:
+    QHash<QByteArray, int> m_fileIds;
+};
+
+class LineReader
+{
+public:
+    LineReader(QFile& file, const QAtomicInt& cancelled, QAtomicInteger<qint64>& bytesRead)
+        : m_file(file)
+        , m_cancelled(cancelled)
+        , m_bytesRead(bytesRead)
+    {
+    }
+
+    // Returns false at the end of the file or once cancelled
+    bool next(QByteArray& line)
+    {
+        if (m_isCancelled || m_file.atEnd()) return false;
+
+        line = m_file.readLine();
+        while (line.endsWith('\n') || line.endsWith('\r')) {
+            line.chop(1);
+        }
+
+        if (++m_lines % PROGRESS_INTERVAL_LINES == 0) {
+            m_bytesRead.storeRelease(m_file.pos());
+            m_isCancelled = m_cancelled.loadAcquire();
+        }
+        return !m_isCancelled;
+    }
+
+    bool isCancelled() const
+    {
+        return m_isCancelled;
+    }
+
+private:
+    QFile& m_file;
+    const QAtomicInt& m_cancelled;
+    QAtomicInteger<qint64>& m_bytesRead;
+    qint64 m_lines = 0;
+    bool m_isCancelled = false;
+};
+
+bool isHexNumber(const QByteArray& text)
+{
+    if (text.isEmpty()) return false;
+    for (const char c : text) {
+        if (!isxdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+// "path:123" at the end of the text, possibly in parentheses or brackets
+bool parseLocation(const QByteArray& text, Accumulator& accumulator, Location& location)
+{
+    QByteArray source = text.trimmed();
+
+    // perf appends "(discriminator 2)" to some lines
+    const int discriminator = source.indexOf(" (discriminator");
+    if (discriminator >= 0) {
+        source.truncate(discriminator);
+    }
+    if (source.endsWith(')') || source.endsWith(']')) {
+        source.chop(1);
+    }
+
+    const int colon = source.lastIndexOf(':');
+    if (colon <= 0) return false;
+
+    bool ok;
+    const int line = source.mid(colon + 1).toInt(&ok);
+    if (!ok || line <= 0) return false;
+
+    int start = colon;
+    while (start > 0 && source.at(start - 1) != ' ' && source.at(start - 1) != '\t' && source.at(start - 1) != '(' && source.at(start - 1) != '[') {
+        start--;
+    }
+
+    const int file = accumulator.fileId(source.mid(start, colon - start));
+    if (file < 0) return false;
+
+    location.file = file;
+    location.line = line - 1;
+    return true;
+}
+
+/*
+ * Samples separated by empty lines, each starts with an unindented header
+ * followed by indented frames "address symbol (dso)". With +srcline every
+ * frame is followed by an indented "file:line", or just the header by it
+ * if there are no call chains.
+ */
+void parsePerfScript(LineReader& reader, Accumulator& accumulator)
+{
+    QVector<Location> frames;
+    bool inSample = false;
+
+    QByteArray line;
+    while (reader.next(line)) {
+        const QByteArray trimmed = line.trimmed();
+        if (trimmed.isEmpty() || !isspace(static_cast<unsigned char>(line.at(0)))) {
+            if (inSample) {
+                accumulator.addStack(frames, 1);
+            }
+            frames.clear();
+            inSample = !trimmed.isEmpty();
+            continue;
+        }
+
+        const int space = trimmed.indexOf(' ');
+        if (isHexNumber(space < 0 ? trimmed : trimmed.left(space))) {
+            frames.append(Location()); // Its source line may follow
+            continue;
+        }
+
+        Location location;
+        if (parseLocation(trimmed, accumulator, location)) {
+            if (frames.isEmpty()) {
+                frames.append(location);
+            } else if (frames.last().file < 0) {
+                frames.last() = location;
+            }
+        }
+    }
+
+    if (inSample) {
+        accumulator.addStack(frames, 1);
+    }
+}
+
+// Callgrind compresses repeated names as "(id) name" on first use and "(id)" later
+QByteArray resolveName(const QByteArray& value, QHash<QByteArray, QByteArray>& names)
+{
+    if (!value.startsWith('(')) return value.trimmed();
+
+    const int close = value.indexOf(')');
+    if (close < 0) return value.trimmed();
+
+    const QByteArray id = value.left(close + 1);
+    const QByteArray name = value.mid(close + 1).trimmed();
+    if (name.isEmpty()) {
+        return names.value(id);
+    }
+    names.insert(id, name);
+    return name;
+}
+
+qint64 parsePosition(const QByteArray& text, qint64 previous)
+{
+    if (text == "*") return previous;
+    if (text.startsWith('+')) return previous + text.mid(1).toLongLong(nullptr, 0);
+    if (text.startsWith('-')) return previous - text.mid(1).toLongLong(nullptr, 0);
+    return text.toLongLong(nullptr, 0);
+}
+
+/*
+ * Cost lines "position cost..." belong to the file set by the last fl=,
+ * fi= or fe=. A cost line after calls= is the inclusive cost of the call
+ * made from that line. Only the first event is used.
+ */
+void parseCallgrind(LineReader& reader, Accumulator& accumulator)
+{
+    QHash<QByteArray, QByteArray> fileNames;
+    int functionFile = -1;
+    int costFile = -1;
+
+    int positionCount = 1;
+    int lineColumn = 0;
+    QVector<qint64> positions(positionCount, 0);
+
+    bool callCost = false;
+    bool hasTotals = false;
+    qint64 totals = 0;
+    qint64 selfCost = 0;
+
+    QByteArray line;
+    while (reader.next(line)) {
+        if (line.isEmpty() || line.at(0) == '#') continue;
+
+        const char first = line.at(0);
+        if (isdigit(static_cast<unsigned char>(first)) || first == '+' || first == '-' || first == '*') {
+            const QList<QByteArray> parts = line.simplified().split(' ');
+            for (int i = 0; i < positionCount && i < parts.size(); i++) {
+                positions[i] = parsePosition(parts.at(i), positions[i]);
+            }
+            const qint64 cost = parts.size() > positionCount ? parts.at(positionCount).toLongLong() : 0;
+
+            const Location location{ costFile, int(positions[lineColumn]) - 1 };
+            if (location.file >= 0 && location.line >= 0) {
+                if (!callCost) {
+                    accumulator.addSelf(location, cost);
+                }
+                accumulator.addInclusive(location, cost);
+            }
+            if (!callCost) {
+                selfCost += cost;
+            }
+            callCost = false;
+            continue;
+        }
+
+        const int equals = line.indexOf('=');
+        const QByteArray key = (equals < 0) ? QByteArray() : line.left(equals);
+        const QByteArray value = line.mid(equals + 1);
+
+        if (key == "calls") {
+            callCost = true;
+        } else if (key == "fl") {
+            functionFile = costFile = accumulator.fileId(resolveName(value, fileNames));
+        } else if (key == "fi" || key == "fe") {
+            costFile = accumulator.fileId(resolveName(value, fileNames));
+        } else if (key == "fn") {
+            costFile = functionFile;
+        } else if (key == "cfi" || key == "cfl") {
+            // The callee may introduce a compressed name used later
+            resolveName(value, fileNames);
+        } else if (line.startsWith("positions:")) {
+            const QList<QByteArray> names = line.mid(int(sizeof("positions:")) - 1).simplified().split(' ');
+            positionCount = names.size();
+            lineColumn = qMax(names.indexOf("line"), 0);
+            positions.fill(0, positionCount);
+        } else if (line.startsWith("totals:") || line.startsWith("summary:")) {
+            const QList<QByteArray> parts = line.mid(line.indexOf(':') + 1).simplified().split(' ');
+            totals = parts.first().toLongLong();
+            hasTotals = true;
+        }
+    }
+
+    accumulator.totalCost = hasTotals ? totals : selfCost;
+}
+
+// One stack per line, "outer;...;inner count"
+void parseFoldedStacks(LineReader& reader, Accumulator& accumulator)
+{
+    QVector<Location> frames;
+
+    QByteArray line;
+    while (reader.next(line)) {
+        const int space = line.lastIndexOf(' ');
+        if (space < 0) continue;
+
+        bool ok;
+        const qint64 count = line.mid(space + 1).toLongLong(&ok);
+        if (!ok) continue;
+
+        const QList<QByteArray> names = line.left(space).split(';');
+        frames.clear();
+        for (int i = names.size() - 1; i >= 0; i--) {
+            Location location;
+            parseLocation(names.at(i), accumulator, location);
+            frames.append(location);
+        }
+        accumulator.addStack(frames, count);
+    }
+}
+
+ProfileData::Format detectFormat(QFile& file, const QString& path)
+{
+    if (QFileInfo(path).fileName().startsWith(QLatin1String("callgrind.out"))) {
+        return ProfileData::Format::Callgrind;
+    }
+
+    const QList<QByteArray> lines = file.peek(64 * 1024).split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith("# callgrind format") || line.startsWith("events:")) {
+            return ProfileData::Format::Callgrind;
+        }
+    }
+
+    // Folded stacks end with a count, perf headers with the event name
+    for (const QByteArray &line : lines) {
+        const QByteArray trimmed = line.trimmed();
+        if (trimmed.isEmpty()) continue;
+
+        bool ok = false;
+        const int space = trimmed.lastIndexOf(' ');
+        if (space >= 0) {
+            trimmed.mid(space + 1).toLongLong(&ok);
+        }
+        return ok ? ProfileData::Format::FoldedStacks : ProfileData::Format::PerfScript;
+    }
+    return ProfileData::Format::PerfScript;
+}
+
+}
+
+
+QSharedPointer<ProfileData> ProfileData::load(const QString& path, const QAtomicInt& cancelled, QAtomicInteger<qint64>& bytesRead, QString* error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) *error = i18n("Can not open %1: %2", path, file.errorString());
+        return QSharedPointer<ProfileData>();
+    }
+
+    auto data = QSharedPointer<ProfileData>::create();
+    data->m_path = path;
+    data->m_format = detectFormat(file, path);
+
+    Accumulator accumulator;
+    LineReader reader(file, cancelled, bytesRead);
+    switch (data->m_format) {
+        case Format::PerfScript:   parsePerfScript(reader, accumulator); break;
+        case Format::Callgrind:    parseCallgrind(reader, accumulator); break;
+        case Format::FoldedStacks: parseFoldedStacks(reader, accumulator); break;
+    }
+    if (reader.isCancelled()) {
+        return QSharedPointer<ProfileData>();
+    }
+    bytesRead.storeRelease(file.size());
+
+    for (int id = 0; id < accumulator.names.size(); id++) {
+        const QString name = QString::fromUtf8(accumulator.names.at(id));
+        const QFileInfo info(name);
+        const QString canonicalPath = info.canonicalFilePath().isEmpty() ? QDir::cleanPath(name) : info.canonicalFilePath();
+
+        // Different spellings of the same path end up in the same file
+        auto &lines = data->m_files[canonicalPath];
+        const auto &costs = accumulator.files.at(id);
+        for (auto iter = costs.constBegin(); iter != costs.constEnd(); ++iter) {
+            lines[iter.key()].self += iter->self;
+            lines[iter.key()].inclusive += iter->inclusive;
+        }
+
+        auto byName = data->m_pathsByName.find(info.fileName());
+        if (byName == data->m_pathsByName.end()) {
+            data->m_pathsByName.insert(info.fileName(), canonicalPath);
+        } else if (*byName != canonicalPath) {
+            byName->clear();
+        }
+    }
+    data->m_totalCost = accumulator.totalCost;
+
+    if (data->m_files.isEmpty() || data->m_totalCost <= 0) {
+        if (error) *error = i18n("%1 contains no samples with source line information", path);
+        return QSharedPointer<ProfileData>();
+    }
+    return data;
+}
+
+QString ProfileData::path() const
+{
+    return m_path;
+}
+
+ProfileData::Format ProfileData::format() const
+{
+    return m_format;
+}
+
+QHash<int, ProfileData::LineCost> ProfileData::lines(const QString& path) const
+{
+    const QFileInfo info(path);
+    const QString canonicalPath = info.canonicalFilePath().isEmpty() ? QDir::cleanPath(path) : info.canonicalFilePath();
+
+    auto iter = m_files.constFind(canonicalPath);
+    if (iter != m_files.constEnd()) {
+        return *iter;
+    }
+
+    // Profiles recorded on another machine or from another checkout
+    const QString byName = m_pathsByName.value(info.fileName());
+    return byName.isEmpty() ? QHash<int, LineCost>() : m_files.value(byName);
+}
+
+qint64 ProfileData::totalCost() const
+{
+    return m_totalCost;
+}
+
+int ProfileData::fileCount() const
+{
+    return m_files.size();
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef PROFILEDATA_H
+#define PROFILEDATA_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QHash>
+#include <QSharedPointer>
+#include <QString>
+
+
+/**
+ * Samples of a profile attributed to source lines, for the profile notes.
+ *
+ * Reads the output of `perf script -F +srcline`, callgrind.out files and
+ * folded stacks whose frames end with "file:line". Only frames with source
+ * line information are counted. The self cost of a sample goes to its
+ * innermost frame, the inclusive cost to every distinct line on its stack.
+ *
+ * The file is read line by line and only the per line totals are kept, so
+ * the memory use does not depend on the size of the profile.
+ */
+class ProfileData
+{
+public:
+    enum class Format {
+        PerfScript,
+        Callgrind,
+        FoldedStacks,
+    };
+
+    struct LineCost {
+        qint64 self = 0;
+        qint64 inclusive = 0;
+    };
+
+    /**
+     * Read and index the profile. Blocking, meant to run in a worker thread.
+     *
+     * \param cancelled checked periodically, reading stops once it is set
+     * \param bytesRead updated periodically, for showing the progress
+     *
+     * \return the data or null if the file can not be read, does not contain
+     *         any line information or reading was cancelled
+     */
+    static QSharedPointer<ProfileData> load(const QString& path, const QAtomicInt& cancelled, QAtomicInteger<qint64>& bytesRead, QString* error);
+
+    QString path() const;
+    Format format() const;
+
+    /**
+     * Costs of the lines of the file, by line number starting at 0.
+     *
+     * Files are matched by canonical path, or by name if the profile was
+     * recorded with the sources at a different place and the name is unique.
+     */
+    QHash<int, LineCost> lines(const QString& path) const;
+
+    /**
+     * Cost of all samples, including the ones without line information.
+     */
+    qint64 totalCost() const;
+
+    int fileCount() const;
+
+private:
+    QString m_path;
+    Format m_format = Format::PerfScript;
+
+    QHash<QString, QHash<int, LineCost>> m_files; // By canonical path
+    QHash<QString, QString> m_pathsByName; // Empty if the name is not unique
+    qint64 m_totalCost = 0;
+};
+
+#endif // PROFILEDATA_H
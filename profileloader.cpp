@@ -0,0 +1,130 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QFileInfo>
+#include <QRunnable>
+
+#include "profileloader.h"
+#include "profiledata.h"
+
+#include <debug.h>
+
+
+constexpr int ProfileLoader::POLL_INTERVAL_MS;
+
+
+// Shared with the task, which keeps running for a while after the job is cancelled
+struct ProfileLoader::Job {
+    QString path;
+    qint64 size = 0;
+
+    QAtomicInt cancelled;
+    QAtomicInteger<qint64> bytesRead;
+    QAtomicInt finished;
+
+    // Written by the task before finished is set
+    QSharedPointer<ProfileData> result;
+    QString error;
+};
+
+class ProfileLoader::LoadTask : public QRunnable
+{
+public:
+    explicit LoadTask(QSharedPointer<Job> job)
+        : m_job(job)
+    {
+    }
+
+    void run() override
+    {
+        m_job->result = ProfileData::load(m_job->path, m_job->cancelled, m_job->bytesRead, &m_job->error);
+        m_job->finished.storeRelease(1);
+    }
+
+private:
+    QSharedPointer<Job> m_job;
+};
+
+
+ProfileLoader::ProfileLoader(QObject* parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(1);
+
+    m_pollTimer.setInterval(POLL_INTERVAL_MS);
+    connect(&m_pollTimer, &QTimer::timeout, this, &ProfileLoader::poll);
+}
+
+ProfileLoader::~ProfileLoader()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void ProfileLoader::load(const QString& path)
+{
+    cancel();
+
+    m_job = QSharedPointer<Job>::create();
+    m_job->path = path;
+    m_job->size = QFileInfo(path).size();
+    m_progress = -1;
+
+    m_pool.start(new LoadTask(m_job));
+    m_pollTimer.start();
+}
+
+void ProfileLoader::cancel()
+{
+    if (!m_job) return;
+
+    m_job->cancelled.storeRelease(1);
+    m_job.reset();
+    m_pollTimer.stop();
+}
+
+bool ProfileLoader::isLoading() const
+{
+    return !m_job.isNull();
+}
+
+void ProfileLoader::poll()
+{
+    if (!m_job->finished.loadAcquire()) {
+        const int progress = m_job->size > 0 ? int(100 * m_job->bytesRead.loadAcquire() / m_job->size) : 0;
+        if (progress != m_progress) {
+            m_progress = progress;
+            emit progressChanged(progress);
+        }
+        return;
+    }
+
+    const QSharedPointer<Job> job = m_job;
+    m_job.reset();
+    m_pollTimer.stop();
+
+    if (job->result) {
+        qCDebug(KDEV_SOURCEINFO) << "Loaded profile" << job->path << "with" << job->result->fileCount() << "files";
+        emit loaded(job->result);
+    } else {
+        emit failed(job->error);
+    }
+}
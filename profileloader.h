@@ -0,0 +1,71 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef PROFILELOADER_H
+#define PROFILELOADER_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QTimer>
+
+
+class ProfileData;
+
+
+/**
+ * Reads a profile into ProfileData in a background thread.
+ *
+ * Only one profile is loaded at a time, loading another one cancels the
+ * previous.
+ */
+class ProfileLoader : public QObject
+{
+    Q_OBJECT
+
+    static constexpr int POLL_INTERVAL_MS = 100;
+
+public:
+    explicit ProfileLoader(QObject* parent = nullptr);
+    ~ProfileLoader() override;
+
+    void load(const QString& path);
+    void cancel();
+
+    bool isLoading() const;
+
+Q_SIGNALS:
+    void progressChanged(int percent);
+    void loaded(QSharedPointer<const ProfileData> profile);
+    void failed(const QString& error);
+
+private Q_SLOTS:
+    void poll();
+
+private:
+    struct Job;
+    class LoadTask;
+
+    QSharedPointer<Job> m_job;
+    QThreadPool m_pool;
+    QTimer m_pollTimer;
+    int m_progress = -1;
+};
+
+#endif // PROFILELOADER_H
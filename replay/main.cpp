@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstdio>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QObject>
+#include <QSharedPointer>
+
+#include "headlesscore.h"
+#include "sourceinfoconfig.h"
+#include "tracereplayer.h"
+
+
+namespace {
+
+// Prints the report of the replay and ends the event loop
+class ReplayReport : public QObject
+{
+    Q_OBJECT
+
+public Q_SLOTS:
+    void print(const QString& report)
+    {
+        fprintf(stdout, "%s\n", report.toLocal8Bit().constData());
+        fflush(stdout);
+        QCoreApplication::quit();
+    }
+};
+
+}
+
+
+int main(int argc, char** argv)
+{
+    // The KDevelop core and the editor documents need a QApplication even when running without UI
+    QApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("kdevsourceinfo-replay"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Replays a trace recorded by the KDevelop source info plugin without the IDE and reports the rebuilds, "
+                                                    "so that builds of the plugin can be compared or bisected"));
+    parser.addHelpOption();
+    parser.addOption({ QStringLiteral("session"), QStringLiteral("KDevelop session whose projects provide the include paths"), QStringLiteral("name") });
+    parser.addPositionalArgument(QStringLiteral("trace"), QStringLiteral("Trace file recorded from the tool view of the plugin"));
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+
+    if (!HeadlessCore::initialize(parser.value(QStringLiteral("session")))) {
+        fprintf(stderr, "Failed to start the KDevelop core\n");
+        return 1;
+    }
+
+    int result = 1;
+    {
+        TraceReplayer replayer(QSharedPointer<SourceInfoConfig>::create());
+
+        QString error;
+        if (replayer.load(parser.positionalArguments().first(), &error)) {
+            ReplayReport report;
+            QObject::connect(&replayer, &TraceReplayer::finished, &report, &ReplayReport::print);
+
+            replayer.start();
+            result = app.exec();
+        } else {
+            fprintf(stderr, "%s\n", error.toLocal8Bit().constData());
+        }
+    }
+
+    HeadlessCore::shutdown();
+    return result;
+}
+
+#include "main.moc"
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QIODevice>
+#include <QtEndian>
+
+#include "scanprotocol.h"
+
+
+void ScanProtocol::writeMessage(QIODevice* device, const QByteArray& message)
+{
+    uchar size[sizeof(quint32)];
+    qToBigEndian<quint32>(message.size(), size);
+    device->write(reinterpret_cast<const char*>(size), sizeof(size));
+    device->write(message);
+}
+
+bool ScanProtocol::takeMessage(QByteArray& buffer, QByteArray& message)
+{
+    if (buffer.size() < int(sizeof(quint32))) return false;
+
+    const quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer.constData()));
+    if (quint32(buffer.size()) - sizeof(quint32) < size) return false;
+
+    message = buffer.mid(sizeof(quint32), size);
+    buffer.remove(0, sizeof(quint32) + size);
+    return true;
+}
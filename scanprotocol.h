@@ -0,0 +1,68 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SCANPROTOCOL_H
+#define SCANPROTOCOL_H
+
+#include <QByteArray>
+#include <QDataStream>
+
+class QIODevice;
+
+
+/**
+ * Messages exchanged between ScanWorker and the kdevsourceinfo-worker
+ * process over a local socket.
+ *
+ * Every message is framed by its size (quint32) and is a QDataStream
+ * starting with its type (quint8). Requests are identified by ids chosen by
+ * ScanWorker, the worker answers every request with any number of
+ * NotesReply messages, so that the notes can be shown incrementally, and a
+ * final DoneReply.
+ *
+ * Before anything else the worker sends a Hello with the token it got from
+ * ScanWorker on its standard input, connections that do not are dropped.
+ */
+namespace ScanProtocol {
+
+constexpr int STREAM_VERSION = QDataStream::Qt_5_6;
+
+enum MessageType : quint8 {
+    ScanRequest,   // quint32 id, bool showArgumentNames, bool showDefaultValues, QString text, QVector<EnumeratorRecord>, QVector<CallSiteRecord> (sorted)
+    CancelRequest, // quint32 id
+    NotesReply,    // quint32 id, QVector<ScannedNote>
+    DoneReply,     // quint32 id
+    Hello,         // QByteArray token
+};
+
+// Limit of the first message on a connection, so that a bogus size does not make ScanWorker buffer forever
+constexpr int MAX_HELLO_SIZE = 1024;
+
+void writeMessage(QIODevice* device, const QByteArray& message);
+
+/**
+ * Takes the next complete message out of the buffer of received data.
+ *
+ * \return false if the buffer does not contain a complete message yet
+ */
+bool takeMessage(QByteArray& buffer, QByteArray& message);
+
+}
+
+#endif // SCANPROTOCOL_H
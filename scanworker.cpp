@@ -0,0 +1,354 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QLocalSocket>
+#include <QSignalBlocker>
+#include <QUuid>
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#endif
+
+#include "scanworker.h"
+#include "scanprotocol.h"
+
+#include <debug.h>
+
+
+namespace {
+
+// QUuid takes the random bits from the system random device where there is one
+QByteArray randomBytes(int count)
+{
+    QByteArray bytes;
+    while (bytes.size() < count) {
+        bytes += QUuid::createUuid().toRfc4122();
+    }
+    bytes.truncate(count);
+    return bytes;
+}
+
+// Process on the other end of the socket, -1 if it can not be determined
+qint64 peerProcessId(QLocalSocket* socket)
+{
+#ifdef Q_OS_LINUX
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(int(socket->socketDescriptor()), SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0) {
+        return credentials.pid;
+    }
+#else
+    Q_UNUSED(socket)
+#endif
+    return -1;
+}
+
+}
+
+
+constexpr int ScanWorker::WATCHDOG_TIMEOUT_MS;
+constexpr int ScanWorker::MAX_UNAUTHENTICATED;
+constexpr int ScanWorker::TOKEN_BYTES;
+
+
+ScanWorker::ScanWorker(QObject* parent)
+    : QObject(parent)
+{
+    m_watchdog.setSingleShot(true);
+    m_watchdog.setInterval(WATCHDOG_TIMEOUT_MS);
+
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+
+    connect(&m_server, &QLocalServer::newConnection, this, &ScanWorker::newConnection);
+    connect(&m_process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, &ScanWorker::processFinished);
+    connect(&m_process, &QProcess::errorOccurred, this, &ScanWorker::processFinished);
+    connect(&m_watchdog, &QTimer::timeout, this, &ScanWorker::watchdogTimeout);
+}
+
+ScanWorker::~ScanWorker()
+{
+    m_process.disconnect(this);
+    stopProcess();
+}
+
+quint32 ScanWorker::scan(const QString& text, bool showArgumentNames, bool showDefaultValues,
+                         const QVector<EnumeratorRecord>& enumerators, const QVector<CallSiteRecord>& callSites)
+{
+    const quint32 id = m_nextId++;
+
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    stream.setVersion(ScanProtocol::STREAM_VERSION);
+    stream << quint8(ScanProtocol::ScanRequest) << id << showArgumentNames << showDefaultValues << text << enumerators << callSites;
+
+    m_pending.append(id);
+    if (!ensureStarted()) {
+        failPending();
+        return id;
+    }
+
+    send(message);
+    if (!m_watchdog.isActive()) {
+        m_watchdog.start();
+    }
+    return id;
+}
+
+void ScanWorker::cancel(quint32 id)
+{
+    m_failed.removeOne(id);
+    if (!m_pending.removeOne(id)) return;
+
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    stream.setVersion(ScanProtocol::STREAM_VERSION);
+    stream << quint8(ScanProtocol::CancelRequest) << id;
+    send(message);
+
+    if (m_pending.isEmpty()) {
+        m_watchdog.stop();
+    }
+}
+
+void ScanWorker::newConnection()
+{
+    while (QLocalSocket* socket = m_server.nextPendingConnection()) {
+        if (m_socket || m_unauthenticated.size() >= MAX_UNAUTHENTICATED) {
+            reject(socket);
+            continue;
+        }
+
+        // Nothing is sent until the connection proves that it is the started process
+        m_unauthenticated.append(socket);
+        connect(socket, &QLocalSocket::readyRead, this, &ScanWorker::authenticate);
+        connect(socket, &QLocalSocket::disconnected, this, &ScanWorker::authenticate);
+    }
+}
+
+void ScanWorker::authenticate()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket || !m_unauthenticated.contains(socket)) return;
+
+    if (socket->state() != QLocalSocket::ConnectedState) {
+        reject(socket);
+        return;
+    }
+
+    // Only peeked until the whole Hello is there
+    QByteArray buffer = socket->peek(ScanProtocol::MAX_HELLO_SIZE);
+    const int received = buffer.size();
+    QByteArray message;
+    if (!ScanProtocol::takeMessage(buffer, message)) {
+        if (received >= ScanProtocol::MAX_HELLO_SIZE) {
+            reject(socket);
+        }
+        return;
+    }
+    socket->read(received - buffer.size());
+
+    QDataStream stream(message);
+    stream.setVersion(ScanProtocol::STREAM_VERSION);
+
+    quint8 type;
+    QByteArray token;
+    stream >> type >> token;
+
+    if (type != ScanProtocol::Hello || m_token.isEmpty() || token != m_token || !isStartedProcess(socket)) {
+        qCDebug(KDEV_SOURCEINFO) << "Rejected a connection to the scan worker server that is not from the worker";
+        reject(socket);
+        return;
+    }
+
+    accept(socket);
+}
+
+bool ScanWorker::isStartedProcess(QLocalSocket* socket) const
+{
+#ifdef Q_OS_LINUX
+    return m_process.state() != QProcess::NotRunning && peerProcessId(socket) == m_process.processId();
+#else
+    // Only the token can be checked
+    Q_UNUSED(socket)
+    return m_process.state() != QProcess::NotRunning;
+#endif
+}
+
+void ScanWorker::accept(QLocalSocket* socket)
+{
+    m_unauthenticated.removeOne(socket);
+    socket->disconnect(this);
+
+    // No other connections from now on
+    for (QLocalSocket* other : m_unauthenticated) {
+        other->disconnect(this);
+        other->abort();
+        other->deleteLater();
+    }
+    m_unauthenticated.clear();
+    m_server.close();
+    m_token.clear();
+
+    m_socket = socket;
+    connect(m_socket, &QLocalSocket::readyRead, this, &ScanWorker::readyRead);
+
+    for (const auto &message : qAsConst(m_unsent)) {
+        ScanProtocol::writeMessage(m_socket, message);
+    }
+    m_unsent.clear();
+
+    if (m_socket->bytesAvailable()) {
+        readyRead();
+    }
+}
+
+void ScanWorker::reject(QLocalSocket* socket)
+{
+    m_unauthenticated.removeOne(socket);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+void ScanWorker::readyRead()
+{
+    m_buffer += m_socket->readAll();
+
+    QByteArray message;
+    while (ScanProtocol::takeMessage(m_buffer, message)) {
+        QDataStream stream(message);
+        stream.setVersion(ScanProtocol::STREAM_VERSION);
+
+        quint8 type;
+        quint32 id;
+        stream >> type >> id;
+
+        // The worker is alive, give it another full timeout
+        if (!m_pending.isEmpty()) {
+            m_watchdog.start();
+        }
+
+        if (!m_pending.contains(id)) continue; // Cancelled
+
+        if (type == ScanProtocol::NotesReply) {
+            QVector<ScannedNote> notes;
+            stream >> notes;
+            emit notesScanned(id, notes);
+        } else if (type == ScanProtocol::DoneReply) {
+            m_pending.removeOne(id);
+            if (m_pending.isEmpty()) {
+                m_watchdog.stop();
+            }
+            emit scanFinished(id, true);
+        }
+    }
+}
+
+void ScanWorker::processFinished()
+{
+    if (m_process.state() != QProcess::NotRunning) return; // Errors that do not end the process
+
+    qCDebug(KDEV_SOURCEINFO) << "Scan worker exited:" << m_process.exitStatus() << m_process.errorString();
+    stopProcess();
+    failPending();
+}
+
+void ScanWorker::watchdogTimeout()
+{
+    qCDebug(KDEV_SOURCEINFO) << "Scan worker did not reply for" << WATCHDOG_TIMEOUT_MS << "ms, restarting it";
+    stopProcess();
+    failPending();
+}
+
+bool ScanWorker::ensureStarted()
+{
+    if (m_process.state() != QProcess::NotRunning) return true;
+
+    // A new name for every process, so that nobody can wait for it to appear
+    const QString serverName = QStringLiteral("kdevsourceinfo-%1-%2").arg(QCoreApplication::applicationPid())
+                                                                     .arg(QString::fromLatin1(randomBytes(16).toHex()));
+    m_server.close();
+    if (!m_server.listen(serverName)) {
+        qCDebug(KDEV_SOURCEINFO) << "Failed to listen for the scan worker:" << m_server.errorString();
+        return false;
+    }
+
+    // Unlike the command line, the standard input is not visible to other processes
+    m_token = randomBytes(TOKEN_BYTES);
+    m_process.start(QStringLiteral(SOURCEINFO_WORKER_PATH), { m_server.fullServerName() });
+    m_process.write(m_token.toHex() + '\n');
+    m_process.closeWriteChannel();
+    return true;
+}
+
+void ScanWorker::send(const QByteArray& message)
+{
+    if (m_socket) {
+        ScanProtocol::writeMessage(m_socket, message);
+    } else {
+        m_unsent.append(message);
+    }
+}
+
+void ScanWorker::stopProcess()
+{
+    m_watchdog.stop();
+
+    if (m_socket) {
+        m_socket->disconnect(this);
+        m_socket->abort();
+        m_socket->deleteLater();
+        m_socket = nullptr;
+    }
+    while (!m_unauthenticated.isEmpty()) {
+        reject(m_unauthenticated.first());
+    }
+    m_server.close();
+    m_token.clear();
+    m_buffer.clear();
+    m_unsent.clear();
+
+    if (m_process.state() != QProcess::NotRunning) {
+        QSignalBlocker blocker(&m_process);
+        m_process.kill();
+        m_process.waitForFinished();
+    }
+}
+
+void ScanWorker::reportFailed()
+{
+    const QList<quint32> failed = m_failed;
+    m_failed.clear();
+    for (quint32 id : failed) {
+        emit scanFinished(id, false);
+    }
+}
+
+void ScanWorker::failPending()
+{
+    if (m_pending.isEmpty()) return;
+
+    if (m_failed.isEmpty()) {
+        QMetaObject::invokeMethod(this, "reportFailed", Qt::QueuedConnection);
+    }
+    m_failed += m_pending;
+    m_pending.clear();
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SCANWORKER_H
+#define SCANWORKER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QLocalServer>
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+#include <QVector>
+
+#include "noterecords.h"
+
+
+class QLocalSocket;
+
+
+/**
+ * Matches the records gathered by NoteBuilder with the text in the
+ * kdevsourceinfo-worker process, so that a slow or crashing scan does not
+ * block or bring down the IDE.
+ *
+ * The process is started on the first request and connects back to a local
+ * server. If it crashes or does not reply for WATCHDOG_TIMEOUT_MS, it is
+ * killed, the pending requests fail and the next request starts a new one.
+ *
+ * The documents must not leak to other local processes, so the server has a
+ * random name, is accessible only by the user and is closed once the worker
+ * connected. The worker gets a random token on its standard input and has
+ * to send it back first. On Linux the connection must also come from the
+ * started process itself.
+ */
+class ScanWorker : public QObject
+{
+    Q_OBJECT
+
+    static constexpr int WATCHDOG_TIMEOUT_MS = 5000;
+
+    // Connections that did not send the token yet, more are dropped right away
+    static constexpr int MAX_UNAUTHENTICATED = 8;
+
+    static constexpr int TOKEN_BYTES = 32;
+
+public:
+    explicit ScanWorker(QObject* parent = nullptr);
+    ~ScanWorker() override;
+
+    /**
+     * Queue matching of the records, which must be sorted, with the text.
+     *
+     * \return id of the request, passed to the signals
+     */
+    quint32 scan(const QString& text, bool showArgumentNames, bool showDefaultValues,
+                 const QVector<EnumeratorRecord>& enumerators, const QVector<CallSiteRecord>& callSites);
+
+    /**
+     * The request is not needed anymore, no more signals are emitted for it.
+     */
+    void cancel(quint32 id);
+
+Q_SIGNALS:
+    void notesScanned(quint32 id, const QVector<ScannedNote>& notes);
+
+    /**
+     * Emitted once for every request that was not cancelled. If succeeded
+     * is false, only some or none of its notes were delivered.
+     */
+    void scanFinished(quint32 id, bool succeeded);
+
+private Q_SLOTS:
+    void newConnection();
+    void authenticate();
+    void readyRead();
+    void processFinished();
+    void watchdogTimeout();
+    void reportFailed();
+
+private:
+    bool ensureStarted();
+    bool isStartedProcess(QLocalSocket* socket) const;
+    void accept(QLocalSocket* socket);
+    void reject(QLocalSocket* socket);
+    void send(const QByteArray& message);
+    void stopProcess();
+    void failPending();
+
+private:
+    QLocalServer m_server;
+    QProcess m_process;
+    QByteArray m_token; // Expected in the Hello of the started process
+    QList<QLocalSocket*> m_unauthenticated;
+    QLocalSocket* m_socket = nullptr;
+    QByteArray m_buffer;
+
+    QList<QByteArray> m_unsent; // Messages waiting for the process to connect
+    QList<quint32> m_pending;   // Requests without DoneReply, in the order they were sent
+    QList<quint32> m_failed;    // Failures are reported asynchronously, the caller may not know the id yet
+    quint32 m_nextId = 1;
+
+    QTimer m_watchdog;
+};
+
+#endif // SCANWORKER_H
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SOURCEINFOCONFIG_H
+#define SOURCEINFOCONFIG_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+
+
+class CoverageData;
+class OptRemarkData;
+class ProfileData;
+class SymbolSizeData;
+
+/**
+ * The settings, copyable so that background computations can work with a
+ * snapshot while the user keeps changing them.
+ */
+struct SourceInfoSettings
+{
+    bool showFunctionArgumentNames = true;
+    bool showFunctionArgumentDefaultValues = true;
+    bool showStructFieldSize = true;
+    bool showAutoType = true;
+    bool showEnumConstValues = true;
+    bool showArgumentCopies = false;
+    bool showVirtualCalls = false;
+    bool showLoopAllocations = false;
+    bool showCalleeSize = false;
+
+    bool abbreviateAutoType = true;
+    int autoTypeMaxDepth = 2; // 0 means unlimited
+    bool showAutoTypeSize = false;
+    int autoTypeSizeHighlightBytes = 64; // Larger types are highlighted
+
+    int argumentCopyThresholdBytes = 64; // Arguments passed by value are flagged if larger, or not trivially copyable
+
+    bool warmCacheOnProjectLoad = false;
+    int warmCacheMaxThreads = 2;
+    int noteCacheBudgetMiB = 64;
+    int openDocumentsBudgetMiB = 128;
+
+    int rebuildStepBudgetUs = 5000;
+    int passBudgetMs = 200; // Per document, passes over it are limited to the visible lines or disabled
+
+    int parallelGatherThreads = 0; // Threads gathering large documents in background, 0 disables it
+
+    bool outOfProcessScanning = false; // Match the gathered data with the text in the worker process
+
+    bool showProfile = true;
+    QSharedPointer<const ProfileData> profile; // Loaded by the plugin, null if there is none
+
+    bool showCoverage = true;
+    QSharedPointer<const CoverageData> coverage; // Indexed by the plugin, null if there is none
+
+    bool showOptRemarks = true;
+    bool showPassedOptRemarks = false; // Optimizations that were applied, there are many of them
+    QStringList optRemarkPasses = { QStringLiteral("inline"), QStringLiteral("loop-vectorize"),
+                                    QStringLiteral("licm"), QStringLiteral("gvn") }; // Empty shows all passes
+    QSharedPointer<const OptRemarkData> optRemarks; // Indexed by the plugin, null if there is none
+
+    bool showSymbolSizes = true;
+    QSharedPointer<const SymbolSizeData> symbolSizes; // Indexed by the plugin, null if there is none
+
+    /**
+     * Whether notes computed with the other settings look the same. The
+     * scheduling settings do not matter, but the pass budget does, it
+     * decides which passes get limited or disabled.
+     */
+    bool hasSameNotes(const SourceInfoSettings& other) const
+    {
+        return showFunctionArgumentNames == other.showFunctionArgumentNames &&
+               showFunctionArgumentDefaultValues == other.showFunctionArgumentDefaultValues &&
+               showStructFieldSize == other.showStructFieldSize &&
+               showAutoType == other.showAutoType &&
+               showEnumConstValues == other.showEnumConstValues &&
+               showArgumentCopies == other.showArgumentCopies &&
+               showVirtualCalls == other.showVirtualCalls &&
+               showLoopAllocations == other.showLoopAllocations &&
+               showCalleeSize == other.showCalleeSize &&
+               abbreviateAutoType == other.abbreviateAutoType &&
+               autoTypeMaxDepth == other.autoTypeMaxDepth &&
+               showAutoTypeSize == other.showAutoTypeSize &&
+               autoTypeSizeHighlightBytes == other.autoTypeSizeHighlightBytes &&
+               argumentCopyThresholdBytes == other.argumentCopyThresholdBytes &&
+               passBudgetMs == other.passBudgetMs &&
+               showProfile == other.showProfile &&
+               profile == other.profile &&
+               showCoverage == other.showCoverage &&
+               coverage == other.coverage &&
+               showOptRemarks == other.showOptRemarks &&
+               showPassedOptRemarks == other.showPassedOptRemarks &&
+               optRemarkPasses == other.optRemarkPasses &&
+               optRemarks == other.optRemarks &&
+               showSymbolSizes == other.showSymbolSizes &&
+               symbolSizes == other.symbolSizes;
+    }
+};
+
+/**
+ * The settings shared by the plugin and its tool view, changed only on the
+ * main thread. Background computations get a SourceInfoSettings copy.
+ */
+class SourceInfoConfig : public QObject, public SourceInfoSettings
+{
+    Q_OBJECT
+
+Q_SIGNALS:
+    void changed();
+};
+
+#endif // SOURCEINFOCONFIG_H
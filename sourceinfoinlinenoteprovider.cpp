@@ -17,41 +17,117 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <algorithm>
+
 #include <language/duchain/duchain.h>
 #include <language/duchain/duchainlock.h>
 #include <language/duchain/duchainutils.h>
+#include <language/duchain/parsingenvironment.h>
 #include <language/duchain/topducontext.h>
-#include <language/duchain/ducontext.h>
-#include <language/duchain/declaration.h>
-#include <language/duchain/classmemberdeclaration.h>
-#include <language/duchain/functiondeclaration.h>
-#include <language/duchain/functiondefinition.h>
-#include <language/duchain/use.h>
-#include <language/duchain/types/enumeratortype.h>
-#include <language/duchain/types/functiontype.h>
 
 #include <kdevplatform/interfaces/idocument.h>
 
 #include <KTextEditor/Document>
 #include <KTextEditor/Range>
+#include <KTextEditor/View>
+
+#include <KLocalizedString>
+
+#include <QPair>
+#include <QRunnable>
+#include <QStringList>
+#include <QThreadPool>
+#include <QToolTip>
 
 #include "sourceinfoinlinenoteprovider.h"
+#include "notebuilder.h"
+#include "notecache.h"
+#include "scanworker.h"
+#include "textsource.h"
 
-#include "notes/generictextnote.h"
-#include "notes/membersizenote.h"
+#include "notes/allocationnote.h"
+#include "notes/notestore.h"
+
+#include <debug.h>
 
 
 using namespace KDevelop;
 using namespace KTextEditor;
 
 
-SourceInfoInlineNoteProvider::SourceInfoInlineNoteProvider(QSharedPointer<SourceInfoConfig> config, Document* document)
+namespace {
+
+// Anything but running also stops the gathering threads
+enum ParallelGatherState {
+    ParallelGatherRunning,
+    ParallelGatherFinished,
+    ParallelGatherAborted,
+    ParallelGatherCancelled,
+};
+
+class ParallelGatherTask : public QRunnable
+{
+public:
+    ParallelGatherTask(QSharedPointer<NoteBuilder> builder, QSharedPointer<SourceInfoConfig> config, QSharedPointer<TypeStringCache> typeStrings, QSharedPointer<QAtomicInt> state, int threads)
+        : m_builder(builder)
+        , m_config(config)
+        , m_typeStrings(typeStrings)
+        , m_state(state)
+        , m_threads(threads)
+    {
+    }
+
+    void run() override
+    {
+        const bool finished = m_builder->gatherParallel(m_threads, m_state);
+        m_state->testAndSetRelease(ParallelGatherRunning, finished ? ParallelGatherFinished : ParallelGatherAborted);
+    }
+
+private:
+    // The builder refers to the config and the type strings, keep them alive even if the provider goes away meanwhile.
+    // It also refers to the text of the document, which gathering must not read, it is only read in the steps.
+    QSharedPointer<NoteBuilder> m_builder;
+    QSharedPointer<SourceInfoConfig> m_config;
+    QSharedPointer<TypeStringCache> m_typeStrings;
+    QSharedPointer<QAtomicInt> m_state;
+    int m_threads;
+};
+
+}
+
+
+constexpr int SourceInfoInlineNoteProvider::PUBLISH_INTERVAL_MS;
+constexpr int SourceInfoInlineNoteProvider::SCROLL_REBUILD_DELAY_MS;
+constexpr int SourceInfoInlineNoteProvider::PARALLEL_GATHER_MIN_LINES;
+constexpr int SourceInfoInlineNoteProvider::PARALLEL_GATHER_POLL_MS;
+constexpr int SourceInfoInlineNoteProvider::MAX_SUMMARY_ALLOCATIONS;
+
+SourceInfoInlineNoteProvider::SourceInfoInlineNoteProvider(QSharedPointer<SourceInfoConfig> config, QSharedPointer<TypeStringCache> typeStrings, QSharedPointer<NoteCache> noteCache, ScanWorker* scanWorker, Document* document)
     : m_document(document)
+    , m_text(document)
+    , m_passModes(NoteBuilder::PassCount, NoteBuilder::PassMode::Full)
+    , m_passCostsUs(NoteBuilder::PassCount, 0)
     , m_config(config)
+    , m_typeStrings(typeStrings)
+    , m_noteCache(noteCache)
+    , m_scanWorker(scanWorker)
 {
     connect(m_config.data(), &SourceInfoConfig::changed, this, &SourceInfoInlineNoteProvider::configChanged);
 
-    rebuildNotes();
+    if (m_scanWorker) {
+        connect(m_scanWorker, &ScanWorker::notesScanned, this, &SourceInfoInlineNoteProvider::notesScanned);
+        connect(m_scanWorker, &ScanWorker::scanFinished, this, &SourceInfoInlineNoteProvider::scanFinished);
+    }
+
+    m_rebuildTimer.setSingleShot(true);
+    connect(&m_rebuildTimer, &QTimer::timeout, this, &SourceInfoInlineNoteProvider::continueRebuild);
+
+    m_scrollRebuildTimer.setSingleShot(true);
+    m_scrollRebuildTimer.setInterval(SCROLL_REBUILD_DELAY_MS);
+    connect(&m_scrollRebuildTimer, &QTimer::timeout, this, &SourceInfoInlineNoteProvider::rebuildVisibleLines);
+
+    // The provider may be created while the IDE starts up or opens a document, do not hold that up
+    QTimer::singleShot(0, this, &SourceInfoInlineNoteProvider::rebuildNotes);
 
     connect(m_document, &KTextEditor::Document::viewCreated,
             this, &SourceInfoInlineNoteProvider::registerToView);
@@ -72,6 +148,8 @@ void SourceInfoInlineNoteProvider::registerToView(KTextEditor::Document* /*docum
     }
     iface->registerInlineNoteProvider(this);
     Q_EMIT inlineNotesReset();
+
+    connect(view, &KTextEditor::View::verticalScrollPositionChanged, this, &SourceInfoInlineNoteProvider::visibleLinesChanged);
 }
 
 SourceInfoInlineNoteProvider::~SourceInfoInlineNoteProvider()
@@ -83,368 +161,459 @@ SourceInfoInlineNoteProvider::~SourceInfoInlineNoteProvider()
         }
         iface->unregisterInlineNoteProvider(this);
     }
-
-    deleteNotes();
 }
 
 QVector<int> SourceInfoInlineNoteProvider::inlineNotes(int line) const {
-    auto iter = m_notes.lowerBound(Cursor(line, 0));
-
-    QVector<int> columns;
-    for (; iter != m_notes.end() && iter.key().line() == line; ++iter) {
-        columns.push_back(iter.key().column());
+    if (!m_notes) {
+        return QVector<int>();
     }
-    return columns;
+    return m_notes->columns(line);
 }
 
 QSize SourceInfoInlineNoteProvider::inlineNoteSize(const InlineNote& note) const {
-    auto iter = m_notes.find(note.position());
-    Q_ASSERT (iter != m_notes.end());
+    const InlineNoteBase *inlineNote = m_notes->find(note.position());
+    Q_ASSERT (inlineNote);
 
     return QSize(
-        (*iter)->width(note.lineHeight(), QFontMetricsF(note.font())),
+        inlineNote->width(note.lineHeight(), QFontMetricsF(note.font())),
         note.lineHeight()
     );
 }
 
 void SourceInfoInlineNoteProvider::paintInlineNote(const InlineNote& note, QPainter& painter) const {
-    auto iter = m_notes.find(note.position());
-    Q_ASSERT (iter != m_notes.end());
+    const InlineNoteBase *inlineNote = m_notes->find(note.position());
+    Q_ASSERT (inlineNote);
 
-    return (*iter)->paint(note.lineHeight(), QFontMetricsF(note.font()), note.font(), painter);
+    return inlineNote->paint(note.lineHeight(), QFontMetricsF(note.font()), note.font(), painter);
 }
 
-void SourceInfoInlineNoteProvider::configChanged()
+void SourceInfoInlineNoteProvider::inlineNoteFocusInEvent(const InlineNote& note, const QPoint& globalPos)
 {
-    rebuildNotes();
+    if (!m_notes) return;
+
+    const InlineNoteBase *inlineNote = m_notes->find(note.position());
+    if (!inlineNote) return;
+
+    const QString toolTip = inlineNote->toolTip();
+    if (!toolTip.isEmpty()) {
+        QToolTip::showText(globalPos, toolTip);
+    }
+}
+
+void SourceInfoInlineNoteProvider::inlineNoteFocusOutEvent(const InlineNote& /*note*/)
+{
+    QToolTip::hideText();
+}
+
+size_t SourceInfoInlineNoteProvider::memoryUsage() const
+{
+    return m_notes ? m_notes->memoryUsage() : 0;
+}
+
+QSharedPointer<const NoteStore> SourceInfoInlineNoteProvider::notes() const
+{
+    return m_notes;
 }
 
-void SourceInfoInlineNoteProvider::deleteNotes()
+void SourceInfoInlineNoteProvider::evictNotes()
 {
-    for (auto &note : m_notes) {
-        delete note;
+    cancelRebuild();
+
+    if (m_notes) {
+        m_noteCache->remove(IndexedString(m_document->url()), m_notes);
     }
+
+    m_evicted = true;
     m_notes.clear();
+    m_degraded = DegradedNotes();
+    emit inlineNotesReset();
 }
 
-void SourceInfoInlineNoteProvider::rebuildNotes()
+void SourceInfoInlineNoteProvider::restoreNotes()
+{
+    if (!m_evicted) return;
+
+    m_evicted = false;
+    rebuildNotes();
+}
+
+bool SourceInfoInlineNoteProvider::isEvicted() const
 {
-    deleteNotes();
+    return m_evicted;
+}
 
-    DUChainReadLocker lock;
-    TopDUContext* topContext = DUChainUtils::standardContextForUrl(m_document->url());
-    if (topContext) {
-        walkContext(topContext, topContext);
+bool SourceInfoInlineNoteProvider::isVisible() const
+{
+    for (auto view : m_document->views()) {
+        if (view->isVisible()) return true;
     }
+    return false;
+}
 
-    emit inlineNotesReset();
+QString SourceInfoInlineNoteProvider::degradationDescription() const
+{
+    QStringList passes;
+    for (int pass = 0; pass < NoteBuilder::PassCount; pass++) {
+        const QString name = NoteBuilder::passName(NoteBuilder::Pass(pass));
+        switch (m_passModes[pass]) {
+        case NoteBuilder::PassMode::Full:
+            break;
+        case NoteBuilder::PassMode::PriorityLinesOnly:
+            passes.append(i18n("%1: only on visible lines, took %2 ms", name, m_passCostsUs[pass] / 1000));
+            break;
+        case NoteBuilder::PassMode::Disabled:
+            passes.append(i18n("%1: disabled, took %2 ms", name, m_passCostsUs[pass] / 1000));
+            break;
+        }
+    }
+    return passes.join(QLatin1Char('\n'));
 }
 
-void SourceInfoInlineNoteProvider::walkContext(KDevelop::DUContext* ctx, KDevelop::TopDUContext* top)
+QString SourceInfoInlineNoteProvider::allocationSummary() const
 {
-    if (m_config->showEnumConstValues) {
-        // Add " = 123" notes after enums that do not have explicit value.
-        if (ctx->type() == DUContext::ContextType::Enum) {
-            foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
-                if(EnumeratorType::Ptr enumerator = declaration->type<EnumeratorType>()) {
-                    const CursorInRevision &pos = declaration->range().end;
-
-                    // XXX: Ugly and slow hack to figure out whether the enum value is set explicitly or not.
-                    QString followingText = m_document->text(KTextEditor::Range(pos.line, pos.column, pos.line, pos.column + 100 /*xxx*/ ));
-                    if (followingText.trimmed().startsWith('=')) continue;
-
-                    InlineNoteBase *note = new GenericTextNote(pos.column, QString::fromUtf8(" = ") + enumerator->valueAsString(), Qt::gray, QBrush(), false, 0.0);
-                    m_notes.insert(pos.castToSimpleCursor(), note);
-                }
+    if (!m_notes) return QString();
+
+    QVector<QPair<KTextEditor::Cursor, const AllocationNote*>> allocations;
+    for (const auto &position : m_notes->positions()) {
+        for (const InlineNoteBase *note : m_notes->findAll(position)) {
+            if (const auto *allocation = dynamic_cast<const AllocationNote*>(note)) {
+                allocations.append(qMakePair(position, allocation));
             }
         }
     }
 
-    if (m_config->showAutoType) {
-        // Add notes with the derived type of auto declarations
-        foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
-            if (declaration->kind() != Declaration::Instance) continue;
+    // Deepest first, then in document order
+    std::stable_sort(allocations.begin(), allocations.end(), [](const QPair<KTextEditor::Cursor, const AllocationNote*>& a,
+                                                                const QPair<KTextEditor::Cursor, const AllocationNote*>& b) {
+        return a.second->loopDepth() > b.second->loopDepth();
+    });
+
+    QStringList lines;
+    for (int i = 0; i < allocations.size() && i < MAX_SUMMARY_ALLOCATIONS; i++) {
+        const auto &allocation = allocations.at(i);
+        lines.append(i18np("line %2: %3, in a loop", "line %2: %3, %1 loops deep",
+                           allocation.second->loopDepth(), allocation.first.line() + 1, allocation.second->operation()));
+    }
+    if (allocations.size() > MAX_SUMMARY_ALLOCATIONS) {
+        lines.append(i18n("and %1 more", allocations.size() - MAX_SUMMARY_ALLOCATIONS));
+    }
+    return lines.join(QLatin1Char('\n'));
+}
 
-            const CursorInRevision &pos = declaration->range().start;
+bool SourceInfoInlineNoteProvider::isRebuilding() const
+{
+    return !m_builder.isNull();
+}
 
-            // Only show this for implicitly typed declarations
-            if (declaration->isExplicitlyTyped()) continue;
+int SourceInfoInlineNoteProvider::noteCount() const
+{
+    return m_notes ? m_notes->count() : 0;
+}
 
-            const AbstractType::Ptr abstractType = declaration->abstractType();
-            if (!abstractType) continue;
+void SourceInfoInlineNoteProvider::setVisibleLinesOverride(const KTextEditor::Range& lines)
+{
+    m_visibleLinesOverride = lines;
+    visibleLinesChanged();
+}
 
-            QString text = "= " + abstractType->toString();
+void SourceInfoInlineNoteProvider::configChanged()
+{
+    // Notes computed so far are for the old configuration
+    cancelRebuild();
+    m_degraded = DegradedNotes();
+
+    // The budget or the enabled passes may have changed, give every pass another chance
+    if (m_passModes.count(NoteBuilder::PassMode::Full) != NoteBuilder::PassCount) {
+        m_passModes.fill(NoteBuilder::PassMode::Full);
+        m_passCostsUs.fill(0);
+        emit degradationChanged();
+    }
 
-            InlineNoteBase *note = new GenericTextNote(pos.column, text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0, 6.0);
-            m_notes.insert(pos.castToSimpleCursor(), note);
-        }
+    rebuildNotes();
+}
+
+void SourceInfoInlineNoteProvider::visibleLinesChanged()
+{
+    // Notes of passes limited to the visible lines have to be recomputed for the new ones
+    if (!m_passModes.contains(NoteBuilder::PassMode::PriorityLinesOnly)) return;
+
+    m_scrollRebuildTimer.start();
+}
+
+void SourceInfoInlineNoteProvider::rebuildVisibleLines()
+{
+    // Same revision, but the builder in progress may be working on the previously visible lines. A degraded result is extended instead, see rebuildNotes()
+    if (!m_degraded.notes) {
+        cancelRebuild();
     }
+    rebuildNotes();
+}
 
-    // Disabled for now
-#if 0
-    if (m_config->showStructFieldSize) {
-        // Add member size and offset notes behind struct fields
-        if (ctx->type() == DUContext::ContextType::Class) {
-            QVector<MemberSizeNote*> memberNotes;
-            MemberSizeNote *previousNote = nullptr;
-            uint64_t previousBytesOffsetOf = 0;
-            int maxColumn = 0;
-            foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
-                if (declaration->kind() != Declaration::Instance) continue;
-                if (declaration->isFunctionDeclaration()) continue;
-
-                const ClassMemberDeclaration* classMemberDeclaration = dynamic_cast<const ClassMemberDeclaration*>(declaration);
-                if (!classMemberDeclaration) continue;
-                if (classMemberDeclaration->isStatic()) continue;
-
-                const CursorInRevision &pos = declaration->range().end;
-
-                uint64_t bytesOffsetOf = classMemberDeclaration->bitOffsetOf() / 8; // TODO: Display somehow bit offets?
-
-                MemberSizeNote *note = new MemberSizeNote(
-                    0,
-                    classMemberDeclaration->sizeOf(),
-                    0,
-                    bytesOffsetOf,
-                    4 /* TODO: Configurable */
-                );
-                if (previousNote) {
-                    previousNote->setPadding(bytesOffsetOf - previousBytesOffsetOf - previousNote->size());
-                }
-                previousNote = note;
-                previousBytesOffsetOf = bytesOffsetOf;
-                m_notes[pos.line].push_back(note);
-
-                memberNotes.push_back(note);
-
-                // XXX: Ugly, slow and unreliable way to find the end of line
-                const auto range = KTextEditor::Range(pos.line, pos.column, pos.line, pos.column + 500 /* xxx */);
-                int endColumn = pos.column + m_doc->text(range).length() + 1;
-                if (endColumn > maxColumn) {
-                    maxColumn = endColumn;
-                }
-            }
-            foreach (MemberSizeNote* memberNote, memberNotes) {
-                memberNote->setColumn(memberNote->column() + maxColumn);
-            }
+void SourceInfoInlineNoteProvider::rebuildNotes()
+{
+    // Evicted notes are recomputed once the document is viewed again
+    if (m_evicted) return;
+
+    const IndexedString url(m_document->url());
+
+    ModificationRevision revision;
+    {
+        DUChainReadLocker lock;
+        TopDUContext* topContext = DUChainUtils::standardContextForUrl(m_document->url());
+        if (!topContext || !topContext->parsingEnvironmentFile()) {
+            cancelRebuild();
+            publishNotes(QSharedPointer<const NoteStore>());
+            return;
         }
+        revision = topContext->parsingEnvironmentFile()->modificationRevision();
+    }
+
+    // Reuse the notes if they were already computed in background or by other provider for the same revision
+    if (auto notes = m_noteCache->find(url, revision)) {
+        cancelRebuild();
+        publishNotes(notes);
+        emit rebuildFinished(m_document, 0, true);
+        return;
     }
-#endif
-
-    if (m_config->showFunctionArgumentNames || m_config->showFunctionArgumentDefaultValues) {
-        // Display function parameter names on call sites
-        // and values of default parameters.
-        for (int i = 0; i < ctx->usesCount(); i++) {
-            const auto &use = ctx->uses()[i];
-            Declaration* declaration = top->usedDeclarationForIndex(use.m_declarationIndex);
-            if (!declaration) continue;
-
-            if(FunctionType::Ptr function = declaration->type<FunctionType>()) {
-                // Do not show if the function has no or one argument (TODO: the later configurable?)
-                if (function->indexedArgumentsSize() <= 1) {
-                    continue;
-                }
-
-                if (DUContext* argumentContext = DUChainUtils::getArgumentContext(declaration)) {
-                    CursorInRevision pos = use.m_range.end;
-
-                    // XXX: Ugly, slow and incorrect hack to figure out where the parameters are
-                    QString followingText = m_document->text(KTextEditor::Range(pos.line, pos.column, pos.line + 10 /* xxx */, pos.column + 500 /* xxx */ ));
-                    int stackDepth = -1;
-                    unsigned int argumentIndex = 0;
-                    bool argumentPending = false;
-
-                    auto decls = argumentContext->localDeclarations(top);
-
-                    int char_i = 0;
-
-                    // First skip any whitespaces // XXX: Comments here will break stuff
-                    while (char_i < followingText.length() && followingText.at(char_i).isSpace()) {
-                        char_i++;
-                    }
-
-                    if (followingText.at(char_i) != '(') break; // So the use was not a function call (e.g. taking address of the function, nevermind)
-
-                    // Go thru the arguments and every time we find beginning of expression in place of argument, place a note with the argument name
-                    for(;
-                        char_i < followingText.length() &&
-                        argumentIndex < function->indexedArgumentsSize() &&
-                        argumentIndex < (unsigned int) decls.size();
-                        char_i++)
-                    {
-                        QChar c = followingText.at(char_i);
-                        // XXX: Very primitive parser, does not understand strings and many other things!
-                        if (c == '(' || c == '{' || c == '[') stackDepth++;
-                        if (c == ')' || c == '}' || c == ']') stackDepth--;
-
-                        if (c == ')' && stackDepth == -1) {
-                            if (m_config->showFunctionArgumentDefaultValues) {
-                                // If we reach the end and still have arguments left, we expect they have default values. Put out note with them.
-                                if (argumentIndex < function->indexedArgumentsSize()) {
-                                    if (FunctionDeclaration* functionDeclaration = dynamic_cast<FunctionDeclaration*>(declaration)) {
-                                        QString text;
-
-                                        for (; argumentIndex < function->indexedArgumentsSize() && argumentIndex < (unsigned int) decls.size(); argumentIndex++) {
-                                            text += ", ";
-                                            if (m_config->showFunctionArgumentNames) {
-                                                auto indentifier = decls[argumentIndex]->identifier();
-                                                if (!indentifier.isEmpty()) text += indentifier.toString() + ": ";
-                                            }
-                                            text += functionDeclaration->defaultParameterForArgument(argumentIndex).str();
-                                        }
-
-                                        GenericTextNote *note = new GenericTextNote(pos.column, text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0);
-                                        m_notes.insert(pos.castToSimpleCursor(), note);
-                                    }
-                                }
-                            }
-                            break;
-                        }
-
-                        if (argumentPending && !c.isSpace()) {
-                            if (m_config->showFunctionArgumentNames) {
-                                auto identifier = decls[argumentIndex]->identifier();
-                                if (!identifier.isEmpty()) {
-                                    QString text = identifier.toString() + ":";
-                                    GenericTextNote *note = new GenericTextNote(pos.column, text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0);
-                                    note->setSpaceRight(true);
-                                    m_notes.insert(pos.castToSimpleCursor(), note);
-                                }
-                            }
-                            argumentIndex++;
-                            argumentPending = false;
-                        }
-
-                        if (stackDepth == 0 && (c == '(' || c == ',')) {
-                            argumentPending = true;
-                        }
-
-                        if (c == '\n') {
-                            pos.column = 0;
-                            pos.line++;
-                        } else {
-                            pos.column++;
-                        }
-                    }
-                }
+
+    // The degraded notes stay valid until the revision or the budget changes, only the limited passes need the newly visible lines
+    if (m_degraded.notes && m_degraded.revision == revision && m_degraded.passModes == m_passModes) {
+        const KTextEditor::Range lines = visibleLines();
+        if (!lines.isValid() || !m_passModes.contains(NoteBuilder::PassMode::PriorityLinesOnly) || m_degraded.covers(lines)) {
+            cancelRebuild();
+            if (m_notes != m_degraded.notes) {
+                publishNotes(m_degraded.notes);
             }
+            return;
+        }
+
+        if (m_builder && m_incrementalBuild && m_builder->revision() == revision && m_builder->priorityLines() == lines) {
+            return;
         }
+
+        // Only the limited passes run, on the visible lines
+        QVector<NoteBuilder::PassMode> passModes = m_passModes;
+        for (auto &mode : passModes) {
+            if (mode == NoteBuilder::PassMode::Full) mode = NoteBuilder::PassMode::Disabled;
+        }
+
+        cancelRebuild();
+        startBuild(url, lines, passModes, true);
+        return;
     }
 
-    if (m_config->showFunctionArgumentDefaultValues) {
-        // Display default argument values at function definition
-        foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
-            if (declaration->kind() != Declaration::Instance) continue;
+    // Updates of other documents trigger rebuild too, do not start over if we are already on it
+    if (m_builder && m_builder->url() == url && m_builder->revision() == revision) {
+        return;
+    }
 
-            if (const FunctionDefinition* functionDefinition = dynamic_cast<const FunctionDefinition*>(declaration)) {
-                if (!functionDefinition->isDefinition()) continue; // Only definitions, declarations already have the default parameters
+    cancelRebuild();
+    startBuild(url, visibleLines(), m_passModes, false);
+}
 
-                const FunctionDeclaration* functionDeclaration = dynamic_cast<const FunctionDeclaration*>(functionDefinition->declaration());
-                if (!functionDeclaration) continue;
-                if (functionDeclaration->defaultParametersSize() == 0) continue;
+void SourceInfoInlineNoteProvider::startBuild(const IndexedString& url, const KTextEditor::Range& priorityLines, const QVector<NoteBuilder::PassMode>& passModes, bool incremental)
+{
+    m_rebuildGeneration = m_noteCache->generation();
+    m_builder.reset(new NoteBuilder(*m_config, *m_typeStrings, m_text));
+    m_builder->setPriorityLines(priorityLines);
+    m_builder->setPassModes(passModes);
+    m_builder->setDeferScanning(m_scanWorker && m_config->outOfProcessScanning);
+    if (!m_builder->start(url)) {
+        m_builder.reset();
+        return;
+    }
 
-                auto *argumentContext = functionDefinition->internalContext();
-                if (!argumentContext) continue;
+    m_incrementalBuild = incremental;
+    m_partialNotesPublished = false;
+    m_lastPublish.start();
+    m_rebuildStarted.start();
 
-                int argumentIndex = 0;
-                foreach (const Declaration* argumentDeclaration, argumentContext->localDeclarations(top)) {
-                    if (argumentDeclaration->kind() != Declaration::Instance) continue;
+    // Large documents are gathered by multiple threads in background, only the matching with the text is left for the steps
+    if (!incremental && m_config->parallelGatherThreads > 0 && m_document->lines() >= PARALLEL_GATHER_MIN_LINES) {
+        m_parallelGatherState = QSharedPointer<QAtomicInt>::create(ParallelGatherRunning);
+        NoteBuilder::gatherPool().start(new ParallelGatherTask(m_builder, m_config, m_typeStrings, m_parallelGatherState, m_config->parallelGatherThreads));
+        m_rebuildTimer.start(PARALLEL_GATHER_POLL_MS);
+        return;
+    }
 
-                    const auto identifier = functionDeclaration->defaultParameterForArgument(argumentIndex);
-                    if (!identifier.isEmpty()) {
-                        const CursorInRevision &pos = argumentDeclaration->range().end;
-                        QString text = " = " + identifier.str();
-                        GenericTextNote *note = new GenericTextNote(pos.column, text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0);
-                        m_notes.insert(pos.castToSimpleCursor(), note);
-                    }
+    m_rebuildTimer.start(0);
+}
 
-                    argumentIndex++;
-                }
-            }
+void SourceInfoInlineNoteProvider::continueRebuild()
+{
+    if (!m_builder) return;
+
+    if (m_parallelGatherState) {
+        const int state = m_parallelGatherState->loadAcquire();
+        if (state == ParallelGatherRunning) {
+            m_rebuildTimer.start(PARALLEL_GATHER_POLL_MS);
+            return;
+        }
+
+        m_parallelGatherState.reset();
+        if (state == ParallelGatherAborted) {
+            // The top context changed, keep the old notes until the update arrives
+            updatePassModes();
+            m_builder.reset();
+            return;
         }
     }
 
-#if 0
-    // Make every use fully qualified
-    {
-        CursorInRevision lastPosEnd;
-        for (int i = 0; i < ctx->usesCount(); i++) {
-            const auto &use = ctx->uses()[i];
-            Declaration* declaration = top->usedDeclarationForIndex(use.m_declarationIndex);
-            if (!declaration) continue;
-
-            const CursorInRevision &pos = use.m_range.start;
-
-            bool separatedByDoubleColon = false;
-            if (lastPosEnd.column != 0 && lastPosEnd.line != 0) {
-                // XXX: Ugly, slow and unreliable way to determine if the previous and this use of something are separate only by "::" and whitespace
-                QString tmp = m_doc->text(KTextEditor::Range(lastPosEnd.castToSimpleCursor(), pos.castToSimpleCursor()));
-                separatedByDoubleColon = (tmp.trimmed() == "::");
-            }
+    switch (m_builder->step(m_config->rebuildStepBudgetUs)) {
+    case NoteBuilder::Status::Aborted:
+        // The top context changed, keep the old notes until the update arrives
+        updatePassModes();
+        m_builder.reset();
+        break;
+
+    case NoteBuilder::Status::Finished:
+        updatePassModes();
+        if (m_scanWorker && m_config->outOfProcessScanning) {
+            // Only gathered so far, the worker process matches the records with the text and the builder waits for its notes
+            QVector<EnumeratorRecord> enumerators;
+            QVector<CallSiteRecord> callSites;
+            m_builder->takeRecords(enumerators, callSites);
+            m_scanRequest = m_scanWorker->scan(m_document->text(), m_config->showFunctionArgumentNames, m_config->showFunctionArgumentDefaultValues, enumerators, callSites);
+            break;
+        }
+        finishRebuild();
+        break;
+
+    case NoteBuilder::Status::InProgress:
+        // Show the notes on the visible lines as soon as they are ready, the rest in batches to avoid repainting too often
+        // The builder keeps filling its store, the editor gets a snapshot of it. Incremental builds are shown once merged
+        if (!m_incrementalBuild && m_builder->priorityLinesDone() && (!m_partialNotesPublished || m_lastPublish.elapsed() >= PUBLISH_INTERVAL_MS)) {
+            publishNotes(m_builder->notes()->snapshot());
+            m_partialNotesPublished = true;
+            m_lastPublish.restart();
+        }
+        m_rebuildTimer.start(0);
+        break;
+    }
+}
 
-            lastPosEnd = use.m_range.end;
-            if (separatedByDoubleColon) {
-                continue;
-            }
+void SourceInfoInlineNoteProvider::notesScanned(quint32 id, const QVector<ScannedNote>& notes)
+{
+    if (id != m_scanRequest) return;
 
-            QStringList parts = declaration->qualifiedIdentifier().toStringList(RemoveTemplateInformation);
-            if (parts.size() <= 1) {
-                continue;
-            }
-            parts.removeLast();
-            QString text = parts.join("::") + "::";
+    m_builder->addScannedNotes(notes);
+    if (!m_incrementalBuild && m_lastPublish.elapsed() >= PUBLISH_INTERVAL_MS) {
+        publishNotes(m_builder->notes()->snapshot());
+        m_partialNotesPublished = true;
+        m_lastPublish.restart();
+    }
+}
 
-            GenericTextNote *note = new GenericTextNote(pos.column, text, QColor(0x9090b0), QBrush(QColor(0xf5f5f5)), true, 4.0);
-            m_notes[pos.line].push_back(note);
-        }
+void SourceInfoInlineNoteProvider::scanFinished(quint32 id, bool succeeded)
+{
+    if (id != m_scanRequest) return;
+    m_scanRequest = 0;
+
+    if (!succeeded) {
+        // Show at least the notes that do not depend on the text, the next update tries again
+        qCDebug(KDEV_SOURCEINFO) << "Scanning" << m_builder->url().str() << "in the worker process failed";
+        publishNotes(m_incrementalBuild ? m_degraded.notes : m_builder->notes());
+        m_builder.reset();
+        return;
     }
-#endif
 
-#if 0
-    // Put note to all declarations
-    foreach (const Declaration* declaration, ctx->localDeclarations(top)) {
-        const CursorInRevision &pos = declaration->range().end;
+    finishRebuild();
+}
+
+void SourceInfoInlineNoteProvider::cancelRebuild()
+{
+    m_rebuildTimer.stop();
 
-        QString text = QString(" declaration(") +
-            "auto: " + (declaration->isAutoDeclaration() ? "true" : "false") + ", " +
-            "kind: " + QString::number(declaration->kind()) + ", " +
-            "type modifiers: " + QString::number(declaration->abstractType()->modifiers()) + ", " +
-            "type as string: " + declaration->abstractType()->toString() + ") ";
+    if (m_scanRequest) {
+        m_scanWorker->cancel(m_scanRequest);
+        m_scanRequest = 0;
+    }
 
-        KTextEditor::InlineNote *note = new GenericTextNote(pos.column, text, Qt::white, QBrush(QColor(0x3a496c)), true, 4.0);
-        m_notes[pos.line].push_back(note);
+    // A parallel gathering in progress stops after the chunks its threads are in
+    if (m_parallelGatherState) {
+        m_parallelGatherState->storeRelease(ParallelGatherCancelled);
+        m_parallelGatherState.reset();
     }
-#endif
+    m_builder.reset();
+    m_incrementalBuild = false;
+}
 
-#if 0
-    // Put note to all uses
-    for (int i = 0; i < ctx->usesCount(); i++) {
-        const auto &use = ctx->uses()[i];
-        const CursorInRevision &pos = use.m_range.start;
+void SourceInfoInlineNoteProvider::finishRebuild()
+{
+    if (m_incrementalBuild) {
+        // Notes of the limited passes on the newly visible lines, added to the ones of the lines seen before,
+        // lines seen before that are visible again got the same notes once more
+        auto merged = m_degraded.notes->copy();
+        merged->update(*m_builder->notes());
+        m_degraded.notes = merged;
+        m_degraded.lines.append(m_builder->priorityLines());
+    } else if (m_builder->isDegraded()) {
+        // Notes limited to the visible lines are not valid for other views of the file, kept just for this document
+        m_degraded.notes = m_builder->notes();
+        m_degraded.revision = m_builder->revision();
+        m_degraded.passModes = m_passModes;
+        m_degraded.lines = { m_builder->priorityLines() };
+    } else {
+        m_degraded = DegradedNotes();
+        m_noteCache->insert(m_builder->url(), m_builder->revision(), m_builder->notes(), m_rebuildGeneration);
+    }
 
-        KTextEditor::InlineNote *note = new GenericTextNote(pos.column, QString::fromUtf8("Use: "), Qt::white, QBrush(QColor(0x3a496c)), true, 4.0);
+    publishNotes(m_incrementalBuild ? m_degraded.notes : m_builder->notes());
+    m_builder.reset();
+    m_incrementalBuild = false;
+    emit rebuildFinished(m_document, m_rebuildStarted.nsecsElapsed() / 1000, false);
+}
 
-        m_notes[pos.line].push_back(note);
+void SourceInfoInlineNoteProvider::publishNotes(QSharedPointer<const NoteStore> notes)
+{
+    m_notes = notes;
+    emit inlineNotesReset();
+    emit memoryUsageChanged();
+    emit allocationsChanged();
+}
+
+void SourceInfoInlineNoteProvider::updatePassModes()
+{
+    auto passModes = m_builder->passModes();
+
+    // Passes left out of an incremental build keep their mode
+    if (m_incrementalBuild) {
+        for (int pass = 0; pass < NoteBuilder::PassCount; pass++) {
+            if (m_passModes[pass] == NoteBuilder::PassMode::Full) passModes[pass] = NoteBuilder::PassMode::Full;
+        }
     }
-#endif
 
-#if 0
-    // Put note to all context
-    {
-        const auto &pos = ctx->range().end;
-        QString text = QString::fromUtf8(" <- End context (") + QString::number(ctx->type()) + ") ";
-        KTextEditor::InlineNote *note = new GenericTextNote(pos.column, text, Qt::white, QBrush(QColor(0x3a496c)), true, 4.0);
-        m_notes[pos.line].push_back(note);
+    if (passModes == m_passModes) return;
+
+    for (int pass = 0; pass < NoteBuilder::PassCount; pass++) {
+        if (passModes[pass] != m_passModes[pass]) {
+            m_passCostsUs[pass] = m_builder->passCostUs(NoteBuilder::Pass(pass));
+        }
     }
-    {
-        const auto &pos = ctx->range().start;
-        QString text = QString::fromUtf8(" Start context (") + QString::number(ctx->type()) + ") -> ";
-        KTextEditor::InlineNote *note = new GenericTextNote(pos.column, text, Qt::white, QBrush(QColor(0x3a496c)), true, 4.0);
-        m_notes[pos.line].push_back(note);
+    m_passModes = passModes;
+    emit degradationChanged();
+}
+
+bool SourceInfoInlineNoteProvider::DegradedNotes::covers(const KTextEditor::Range& visible) const
+{
+    for (const auto &range : lines) {
+        if (range.isValid() && range.start().line() <= visible.start().line() && range.end().line() >= visible.end().line()) return true;
     }
-#endif
+    return false;
+}
+
+KTextEditor::Range SourceInfoInlineNoteProvider::visibleLines() const
+{
+    if (m_visibleLinesOverride.isValid()) {
+        return m_visibleLinesOverride;
+    }
+
+    KTextEditor::Range lines = KTextEditor::Range::invalid();
+    for (auto view : m_document->views()) {
+        if (!view->isVisible()) continue;
 
-    foreach (DUContext* childContext, ctx->childContexts()) {
-        walkContext(childContext, top);
+        const KTextEditor::Range viewLines(view->firstDisplayedLine(), 0, view->lastDisplayedLine(), 0);
+        lines = lines.isValid() ? lines.encompass(viewLines) : viewLines;
     }
+    return lines;
 }
@@ -20,68 +20,176 @@
 #ifndef SOURCEINFOINLINENOTEPROVIDER_H
 #define SOURCEINFOINLINENOTEPROVIDER_H
 
-#include <QMap>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QTimer>
 #include <QVector>
 
 #include <KTextEditor/Cursor>
 #include <KTextEditor/InlineNoteInterface>
 #include <KTextEditor/InlineNoteProvider>
 
-#include "notes/inlinenotebase.h"
+#include "notebuilder.h"
+#include "notes/notestore.h"
+#include "sourceinfoconfig.h"
+#include "textsource.h"
+#include "typestringcache.h"
 
 
-namespace KDevelop {
-class IDocument;
-class DUContext;
-class TopDUContext;
-}
+class NoteCache;
+class ScanWorker;
 
 
-class SourceInfoConfig : public QObject
+class SourceInfoInlineNoteProvider : public KTextEditor::InlineNoteProvider
 {
     Q_OBJECT
 
-public:
-    bool showFunctionArgumentNames = true;
-    bool showFunctionArgumentDefaultValues = true;
-    bool showStructFieldSize = true;
-    bool showAutoType = true;
-    bool showEnumConstValues = true;
+    // How often partial results of a rebuild are shown after the visible lines are done
+    static constexpr int PUBLISH_INTERVAL_MS = 50;
 
-Q_SIGNALS:
-    void changed();
-};
+    // Delay of the rebuild after scrolling while some pass is limited to the visible lines
+    static constexpr int SCROLL_REBUILD_DELAY_MS = 200;
 
+    // Documents gathered in parallel, smaller ones are cheap enough to be walked on the main thread with the visible lines first
+    static constexpr int PARALLEL_GATHER_MIN_LINES = 5000;
 
-class SourceInfoInlineNoteProvider : public KTextEditor::InlineNoteProvider
-{
-    Q_OBJECT
+    // How often the rebuild checks whether the parallel gathering finished
+    static constexpr int PARALLEL_GATHER_POLL_MS = 5;
+
+    // Allocations listed by allocationSummary()
+    static constexpr int MAX_SUMMARY_ALLOCATIONS = 10;
 
 public:
-    SourceInfoInlineNoteProvider(QSharedPointer<SourceInfoConfig> config, KTextEditor::Document* document);
+    /**
+     * \param scanWorker used if enabled in the config, may be null
+     */
+    SourceInfoInlineNoteProvider(QSharedPointer<SourceInfoConfig> config, QSharedPointer<TypeStringCache> typeStrings, QSharedPointer<NoteCache> noteCache, ScanWorker* scanWorker, KTextEditor::Document* document);
     ~SourceInfoInlineNoteProvider();
 
     QVector<int> inlineNotes(int line) const override;
     QSize inlineNoteSize(const KTextEditor::InlineNote& note) const override;
     void paintInlineNote(const KTextEditor::InlineNote& note, QPainter& painter) const override;
+    void inlineNoteFocusInEvent(const KTextEditor::InlineNote& note, const QPoint& globalPos) override;
+    void inlineNoteFocusOutEvent(const KTextEditor::InlineNote& note) override;
+
+    size_t memoryUsage() const;
+
+    /**
+     * The notes shown, null if there are none. They may be shared with the
+     * note cache.
+     */
+    QSharedPointer<const NoteStore> notes() const;
+
+    /**
+     * Drop the notes to save memory while the document is not viewed,
+     * together with their note cache entry, which would keep them alive.
+     * Updates of the document are ignored until restoreNotes() is called.
+     */
+    void evictNotes();
+    void restoreNotes();
+    bool isEvicted() const;
+
+    /**
+     * Whether some view of the document is visible.
+     */
+    bool isVisible() const;
+
+    /**
+     * Describes the passes that were limited or disabled for this document
+     * because they exceeded their time budget, empty if there are none.
+     */
+    QString degradationDescription() const;
+
+    /**
+     * Lists the heap allocations in the most deeply nested loops, empty if
+     * there are none.
+     */
+    QString allocationSummary() const;
+
+    bool isRebuilding() const;
+    int noteCount() const;
+
+    /**
+     * Use the given lines instead of the ones shown in the views, for
+     * documents without views.
+     */
+    void setVisibleLinesOverride(const KTextEditor::Range& lines);
+
+Q_SIGNALS:
+    void memoryUsageChanged();
+    void degradationChanged();
+    void allocationsChanged();
+
+    /**
+     * Complete notes for the current revision are shown.
+     *
+     * \param latencyUs time since the rebuild started
+     * \param fromCache the notes were taken from the note cache
+     */
+    void rebuildFinished(KTextEditor::Document* document, qint64 latencyUs, bool fromCache);
 
 private Q_SLOT:
     void configChanged();
+    void continueRebuild();
+    void visibleLinesChanged();
+    void rebuildVisibleLines();
+    void notesScanned(quint32 id, const QVector<ScannedNote>& notes);
+    void scanFinished(quint32 id, bool succeeded);
 
 private:
     void registerToView(KTextEditor::Document* /*document*/, KTextEditor::View* view);
 
-    void deleteNotes();
     void rebuildNotes();
+    void startBuild(const KDevelop::IndexedString& url, const KTextEditor::Range& priorityLines, const QVector<NoteBuilder::PassMode>& passModes, bool incremental);
+    void cancelRebuild();
+    void finishRebuild();
+    void publishNotes(QSharedPointer<const NoteStore> notes);
+    void updatePassModes();
 
-    void walkContext(KDevelop::DUContext* ctx, KDevelop::TopDUContext* top);
+    KTextEditor::Range visibleLines() const;
 
 private:
     KTextEditor::Document* m_document;
-
-    QMap<KTextEditor::Cursor, const InlineNoteBase *> m_notes; // TODO: Differently?
+    DocumentTextSource m_text;
+
+    QSharedPointer<const NoteStore> m_notes;
+    bool m_evicted = false;
+
+    // Rebuild in progress, one step per event loop iteration
+    // Shared with the background task while gathering in parallel
+    QSharedPointer<NoteBuilder> m_builder;
+    QSharedPointer<QAtomicInt> m_parallelGatherState;
+    QTimer m_rebuildTimer;
+    uint m_rebuildGeneration = 0;
+    bool m_partialNotesPublished = false;
+    QElapsedTimer m_lastPublish;
+    QElapsedTimer m_rebuildStarted;
+    quint32 m_scanRequest = 0; // Request of the gathered builder waiting for the scan worker, 0 if none
+    bool m_incrementalBuild = false; // The builder only adds the limited passes on newly visible lines to m_degraded
+
+    KTextEditor::Range m_visibleLinesOverride = KTextEditor::Range::invalid();
+
+    // Result of the last build with some pass over its budget, valid for its revision and pass modes
+    struct DegradedNotes {
+        QSharedPointer<const NoteStore> notes;
+        KDevelop::ModificationRevision revision;
+        QVector<NoteBuilder::PassMode> passModes;
+        QVector<KTextEditor::Range> lines; // The limited passes ran on these lines
+
+        bool covers(const KTextEditor::Range& visible) const;
+    };
+    DegradedNotes m_degraded;
+
+    // Passes that exceeded their budget stay degraded for this document
+    QVector<NoteBuilder::PassMode> m_passModes;
+    QVector<qint64> m_passCostsUs; // Cost when the pass got degraded
+    QTimer m_scrollRebuildTimer;
 
     QSharedPointer<SourceInfoConfig> m_config;
+    QSharedPointer<TypeStringCache> m_typeStrings;
+    QSharedPointer<NoteCache> m_noteCache;
+    ScanWorker* m_scanWorker;
 };
 
 #endif // SOURCEINFOINLINENOTEPROVIDER_H
@@ -20,16 +20,33 @@
 #include "sourceinfoplugin.h"
 #include "sourceinfoinlinenoteprovider.h"
 #include "sourceinfotoolview.h"
-
+#include "argumentscanner.h"
+#include "cachewarmer.h"
+#include "notebuilder.h"
+#include "builddataindexer.h"
+#include "coveragedata.h"
+#include "notecache.h"
+#include "optremarkdata.h"
+#include "profiledata.h"
+#include "profileloader.h"
+#include "scanworker.h"
+#include "symbolsizedata.h"
+#include "tracerecorder.h"
+#include "tracereplayer.h"
+
+#include <QElapsedTimer>
+#include <QThreadPool>
 #include <QUrl>
 
 #include <KConfigGroup>
 #include <KLocalizedString>
 #include <KPluginFactory>
+#include <KTextEditor/Document>
 
 #include <interfaces/icore.h>
 #include <interfaces/idocument.h>
 #include <interfaces/idocumentcontroller.h>
+#include <interfaces/iprojectcontroller.h>
 #include <interfaces/iuicontroller.h>
 
 #include <debug.h>
@@ -40,11 +57,11 @@ using namespace KDevelop;
 class SourceInfoToolViewFactory: public KDevelop::IToolViewFactory
 {
 public:
-    explicit SourceInfoToolViewFactory(QSharedPointer<SourceInfoConfig> config): m_config(config) {}
+    SourceInfoToolViewFactory(SourceInfoPlugin* plugin, QSharedPointer<SourceInfoConfig> config): m_plugin(plugin), m_config(config) {}
 
     QWidget* create(QWidget *parent = nullptr) override
     {
-        SourceInfoToolView *view = new SourceInfoToolView(m_config, parent);
+        SourceInfoToolView *view = new SourceInfoToolView(m_plugin, m_config, parent);
         return view;
     }
 
@@ -59,27 +76,73 @@ public:
     }
 
 private:
+    SourceInfoPlugin* m_plugin;
     QSharedPointer<SourceInfoConfig> m_config;
 };
 
 //KPluginFactory stuff to load the plugin dynamically at runtime
 K_PLUGIN_FACTORY_WITH_JSON(KDevExecuteFactory, "kdevsourceinfo.json", registerPlugin<SourceInfoPlugin>();)
 
+constexpr int SourceInfoPlugin::CONFIG_APPLY_DELAY_MS;
+
 SourceInfoPlugin::SourceInfoPlugin(QObject *parent, const QVariantList&)
     : KDevelop::IPlugin("kdevsourceinfo", parent)
     , m_config(QSharedPointer<SourceInfoConfig>::create())
-    , m_viewFactory(new SourceInfoToolViewFactory(m_config))
+    , m_typeStrings(QSharedPointer<TypeStringCache>::create())
+    , m_noteCache(QSharedPointer<NoteCache>::create(size_t(m_config->noteCacheBudgetMiB) * 1024 * 1024))
+    , m_cacheWarmer(new CacheWarmer(m_config, m_typeStrings, m_noteCache, this))
+    , m_traceRecorder(new TraceRecorder(this))
+    , m_scanWorker(new ScanWorker(this))
+    , m_profileLoader(new ProfileLoader(this))
+    , m_coverageIndexer(new BuildDataIndexer(&CoverageData::scan, this))
+    , m_optRemarkIndexer(new BuildDataIndexer(&OptRemarkData::scan, this))
+    , m_symbolIndexer(new BuildDataIndexer(&SymbolSizeData::scan, this))
+    , m_viewFactory(new SourceInfoToolViewFactory(this, m_config))
 {
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+
     core()->uiController()->addToolView(i18n("Source Info"), m_viewFactory);
 
+    connect(m_profileLoader, &ProfileLoader::progressChanged, this, &SourceInfoPlugin::profileLoadProgress);
+    connect(m_profileLoader, &ProfileLoader::loaded, this, &SourceInfoPlugin::profileLoaded);
+    connect(m_profileLoader, &ProfileLoader::failed, this, &SourceInfoPlugin::profileLoadFailed);
+    connect(m_coverageIndexer, &BuildDataIndexer::indexed, this, &SourceInfoPlugin::coverageIndexed);
+    connect(m_coverageIndexer, &BuildDataIndexer::failed, this, &SourceInfoPlugin::coverageIndexFailed);
+    connect(m_optRemarkIndexer, &BuildDataIndexer::indexed, this, &SourceInfoPlugin::optRemarksIndexed);
+    connect(m_optRemarkIndexer, &BuildDataIndexer::failed, this, &SourceInfoPlugin::optRemarkIndexFailed);
+    connect(m_symbolIndexer, &BuildDataIndexer::indexed, this, &SourceInfoPlugin::symbolsIndexed);
+    connect(m_symbolIndexer, &BuildDataIndexer::failed, this, &SourceInfoPlugin::symbolIndexFailed);
+
+    NoteBuilder::gatherPool().setMaxThreadCount(qMax(m_config->parallelGatherThreads, 1));
+
+    // Connected before any provider exists, so that the cache is cleared before the providers rebuild their notes
+    m_noteSettings = *m_config;
+    m_appliedSettings = *m_config;
+    connect(m_config.data(), &SourceInfoConfig::changed, this, &SourceInfoPlugin::configChanged);
+
+    m_configTimer.setSingleShot(true);
+    m_configTimer.setInterval(CONFIG_APPLY_DELAY_MS);
+    connect(&m_configTimer, &QTimer::timeout, this, &SourceInfoPlugin::applyConfig);
+
     auto docController = ICore::self()->documentController();
 
-    for (auto *document : docController->openDocuments()) {
+    // Documents restored with the session only get their notes once they are shown
+    const auto openDocuments = docController->openDocuments();
+    for (auto *document : openDocuments) {
         documentOpened(document);
     }
 
     connect(docController, &IDocumentController::textDocumentCreated, this, &SourceInfoPlugin::documentOpened);
     connect(docController, &IDocumentController::documentClosed, this, &SourceInfoPlugin::documentClosed);
+    connect(docController, &IDocumentController::documentActivated, this, &SourceInfoPlugin::documentActivated);
+
+    auto projectController = ICore::self()->projectController();
+    connect(projectController, &IProjectController::projectOpened, this, &SourceInfoPlugin::projectOpened);
+    connect(projectController, &IProjectController::projectClosing, this, &SourceInfoPlugin::projectClosing);
+
+    qCDebug(KDEV_SOURCEINFO) << "Plugin loaded in" << loadTimer.nsecsElapsed() / 1000 << "us, notes set up for"
+                             << m_documentToProviderMap.size() << "of" << openDocuments.size() << "open documents";
 }
 
 SourceInfoPlugin::~SourceInfoPlugin()
@@ -90,6 +153,18 @@ void SourceInfoPlugin::unload()
 {
     core()->uiController()->removeToolView(m_viewFactory);
 
+    m_configTimer.stop();
+    m_cacheWarmer->stop();
+    m_traceRecorder->stop();
+    m_profileLoader->cancel();
+    m_coverageIndexer->clear();
+    m_optRemarkIndexer->clear();
+    m_symbolIndexer->clear();
+    NoteBuilder::gatherPool().waitForDone();
+
+    qCDebug(KDEV_SOURCEINFO) << "DUChain read lock hold times:" << NoteBuilder::lockHoldHistogram().toString();
+    qCDebug(KDEV_SOURCEINFO) << "Argument scanner throughput:" << ArgumentScanner::throughput();
+
     auto docController = ICore::self()->documentController();
     for (auto *document : docController->openDocuments()) {
         documentClosed(document);
@@ -101,23 +176,416 @@ void SourceInfoPlugin::documentOpened(KDevelop::IDocument* document)
     if (document->isTextDocument()) {
         auto textDocument = document->textDocument();
 
-        auto *provider = new SourceInfoInlineNoteProvider(m_config, textDocument);
+        // Documents that are not shown, like the inactive tabs of a restored session, cost nothing until they are
+        if (textDocument->views().isEmpty()) {
+            connect(textDocument, &KTextEditor::Document::viewCreated, this, &SourceInfoPlugin::documentViewCreated, Qt::UniqueConnection);
+            return;
+        }
+
+        createProvider(textDocument);
+    }
+}
+
+void SourceInfoPlugin::documentViewCreated(KTextEditor::Document* document, KTextEditor::View* /*view*/)
+{
+    disconnect(document, &KTextEditor::Document::viewCreated, this, &SourceInfoPlugin::documentViewCreated);
 
-        m_documentToProviderMap.insert(textDocument, provider);
+    // The view is already known to the document, the provider registers to it
+    if (!m_documentToProviderMap.contains(document)) {
+        createProvider(document);
     }
 }
 
+void SourceInfoPlugin::createProvider(KTextEditor::Document* document)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    auto *provider = new SourceInfoInlineNoteProvider(m_config, m_typeStrings, m_noteCache, m_scanWorker, document);
+    connect(provider, &SourceInfoInlineNoteProvider::memoryUsageChanged, this, &SourceInfoPlugin::enforceMemoryBudget);
+    connect(provider, &SourceInfoInlineNoteProvider::degradationChanged, this, &SourceInfoPlugin::degradationChanged);
+    connect(provider, &SourceInfoInlineNoteProvider::allocationsChanged, this, &SourceInfoPlugin::allocationsChanged);
+
+    m_documentToProviderMap.insert(document, provider);
+    m_viewOrder.append(document);
+
+    m_traceRecorder->addDocument(document);
+
+    enforceMemoryBudget();
+
+    qCDebug(KDEV_SOURCEINFO) << "Set up notes of" << document->url() << "in" << timer.nsecsElapsed() / 1000 << "us";
+}
+
 void SourceInfoPlugin::documentClosed(KDevelop::IDocument* document)
 {
     if (document->isTextDocument()) {
         auto textDocument = document->textDocument();
+        disconnect(textDocument, &KTextEditor::Document::viewCreated, this, &SourceInfoPlugin::documentViewCreated);
 
         auto provider = m_documentToProviderMap.find(textDocument);
         if (provider != m_documentToProviderMap.end()) {
             delete *provider;
             m_documentToProviderMap.erase(provider);
         }
+        m_viewOrder.removeOne(textDocument);
+        m_traceRecorder->removeDocument(textDocument);
+
+        emit memoryUsageChanged();
+        emit degradationChanged();
+        emit allocationsChanged();
+    }
+}
+
+void SourceInfoPlugin::documentActivated(KDevelop::IDocument* document)
+{
+    if (!document->isTextDocument()) return;
+
+    auto textDocument = document->textDocument();
+    if (!m_viewOrder.removeOne(textDocument)) return;
+    m_viewOrder.append(textDocument);
+
+    if (auto *provider = m_documentToProviderMap.value(textDocument)) {
+        provider->restoreNotes();
+    }
+
+    enforceMemoryBudget();
+    emit degradationChanged();
+    emit allocationsChanged();
+}
+
+void SourceInfoPlugin::enforceMemoryBudget()
+{
+    const size_t budget = notesMemoryBudget();
+    size_t usage = notesMemoryUsage();
+
+    // Evict the least recently viewed documents first, but never the last viewed one or the ones visible in other views
+    for (int i = 0; i < m_viewOrder.size() - 1 && usage > budget; i++) {
+        auto *provider = m_documentToProviderMap.value(m_viewOrder.at(i));
+        if (!provider || provider->isEvicted() || provider->isVisible()) continue;
+
+        // Other documents may show the same notes, then evicting them frees nothing
+        const auto notes = provider->notes();
+        bool shared = false;
+        for (const auto *other : qAsConst(m_documentToProviderMap)) {
+            if (other != provider && notes && other->notes() == notes) shared = true;
+        }
+
+        provider->evictNotes();
+        if (!shared) {
+            usage -= notes ? notes->memoryUsage() : 0;
+        }
+    }
+
+    emit memoryUsageChanged();
+}
+
+QSet<const NoteStore*> SourceInfoPlugin::shownNotes() const
+{
+    QSet<const NoteStore*> notes;
+    for (const auto *provider : m_documentToProviderMap) {
+        if (const auto shown = provider->notes()) {
+            notes.insert(shown.data());
+        }
+    }
+    return notes;
+}
+
+size_t SourceInfoPlugin::notesMemoryUsage() const
+{
+    // Documents of the same file share their notes, count them once
+    size_t usage = 0;
+    for (const auto *notes : shownNotes()) {
+        usage += notes->memoryUsage();
+    }
+    return usage;
+}
+
+size_t SourceInfoPlugin::notesMemoryBudget() const
+{
+    return size_t(m_config->openDocumentsBudgetMiB) * 1024 * 1024;
+}
+
+int SourceInfoPlugin::evictedDocumentsCount() const
+{
+    int count = 0;
+    for (const auto *provider : m_documentToProviderMap) {
+        if (provider->isEvicted()) count++;
+    }
+    return count;
+}
+
+size_t SourceInfoPlugin::cacheMemoryUsage() const
+{
+    // The notes shown in the open documents are counted there
+    return m_noteCache->memoryUsage(shownNotes());
+}
+
+size_t SourceInfoPlugin::cacheMemoryBudget() const
+{
+    return m_noteCache->budget();
+}
+
+QString SourceInfoPlugin::activeDocumentDegradation() const
+{
+    if (m_viewOrder.isEmpty()) return QString();
+
+    const auto *provider = m_documentToProviderMap.value(m_viewOrder.last());
+    return provider ? provider->degradationDescription() : QString();
+}
+
+QString SourceInfoPlugin::activeDocumentAllocations() const
+{
+    if (m_viewOrder.isEmpty()) return QString();
+
+    const auto *provider = m_documentToProviderMap.value(m_viewOrder.last());
+    return provider ? provider->allocationSummary() : QString();
+}
+
+bool SourceInfoPlugin::startTraceRecording(const QString& path)
+{
+    if (!m_traceRecorder->start(path)) return false;
+
+    for (auto *document : m_documentToProviderMap.keys()) {
+        m_traceRecorder->addDocument(document);
+    }
+    return true;
+}
+
+void SourceInfoPlugin::stopTraceRecording()
+{
+    m_traceRecorder->stop();
+}
+
+bool SourceInfoPlugin::replayTrace(const QString& path, QString* error)
+{
+    auto *replayer = new TraceReplayer(m_config, this);
+    if (!replayer->load(path, error)) {
+        delete replayer;
+        return false;
+    }
+
+    connect(replayer, &TraceReplayer::finished, this, &SourceInfoPlugin::traceReplayFinished);
+    connect(replayer, &TraceReplayer::finished, replayer, &QObject::deleteLater);
+    replayer->start();
+    return true;
+}
+
+void SourceInfoPlugin::loadProfile(const QString& path)
+{
+    m_profileLoader->load(path);
+    m_profilePath = path;
+    m_profileStatus = i18n("Loading %1...", path);
+    emit profileStatusChanged();
+}
+
+void SourceInfoPlugin::clearProfile()
+{
+    m_profileLoader->cancel();
+    m_profileStatus.clear();
+    emit profileStatusChanged();
+
+    if (m_config->profile) {
+        m_config->profile.reset();
+        emit m_config->changed();
+    }
+}
+
+QString SourceInfoPlugin::profileStatus() const
+{
+    return m_profileStatus;
+}
+
+void SourceInfoPlugin::profileLoadProgress(int percent)
+{
+    m_profileStatus = i18n("Loading %1... %2%", m_profilePath, percent);
+    emit profileStatusChanged();
+}
+
+void SourceInfoPlugin::profileLoaded(QSharedPointer<const ProfileData> profile)
+{
+    m_profileStatus = i18np("%2: samples in 1 file", "%2: samples in %1 files", profile->fileCount(), profile->path());
+    emit profileStatusChanged();
+
+    // Recomputes the notes of the open documents
+    m_config->profile = profile;
+    emit m_config->changed();
+}
+
+void SourceInfoPlugin::profileLoadFailed(const QString& error)
+{
+    m_profileStatus = error;
+    emit profileStatusChanged();
+}
+
+void SourceInfoPlugin::setCoverageDirectory(const QString& directory)
+{
+    m_coverageIndexer->setDirectory(directory);
+    m_coverageStatus = i18n("Indexing %1...", directory);
+    emit coverageStatusChanged();
+}
+
+void SourceInfoPlugin::clearCoverage()
+{
+    m_coverageIndexer->clear();
+    m_coverageStatus.clear();
+    emit coverageStatusChanged();
+
+    if (m_config->coverage) {
+        m_config->coverage.reset();
+        emit m_config->changed();
+    }
+}
+
+QString SourceInfoPlugin::coverageStatus() const
+{
+    return m_coverageStatus;
+}
+
+void SourceInfoPlugin::coverageIndexed(QSharedPointer<const BuildDataIndex> index)
+{
+    const auto coverage = qSharedPointerCast<const CoverageData>(index);
+    m_coverageStatus = i18np("%2: counts for 1 file", "%2: counts for %1 files", coverage->fileCount(), coverage->directory());
+    emit coverageStatusChanged();
+
+    // Also after every refresh, the counts of any open document may have changed
+    m_config->coverage = coverage;
+    emit m_config->changed();
+}
+
+void SourceInfoPlugin::coverageIndexFailed(const QString& error)
+{
+    m_coverageStatus = error;
+    emit coverageStatusChanged();
+}
+
+void SourceInfoPlugin::setOptRemarkDirectory(const QString& directory)
+{
+    m_optRemarkIndexer->setDirectory(directory);
+    m_optRemarkStatus = i18n("Indexing %1...", directory);
+    emit optRemarkStatusChanged();
+}
+
+void SourceInfoPlugin::clearOptRemarks()
+{
+    m_optRemarkIndexer->clear();
+    m_optRemarkStatus.clear();
+    emit optRemarkStatusChanged();
+
+    if (m_config->optRemarks) {
+        m_config->optRemarks.reset();
+        emit m_config->changed();
+    }
+}
+
+QString SourceInfoPlugin::optRemarkStatus() const
+{
+    return m_optRemarkStatus;
+}
+
+void SourceInfoPlugin::optRemarksIndexed(QSharedPointer<const BuildDataIndex> index)
+{
+    const auto optRemarks = qSharedPointerCast<const OptRemarkData>(index);
+    m_optRemarkStatus = i18np("%2: remarks from 1 translation unit", "%2: remarks from %1 translation units",
+                              optRemarks->translationUnitCount(), optRemarks->directory());
+    emit optRemarkStatusChanged();
+
+    m_config->optRemarks = optRemarks;
+    emit m_config->changed();
+}
+
+void SourceInfoPlugin::optRemarkIndexFailed(const QString& error)
+{
+    m_optRemarkStatus = error;
+    emit optRemarkStatusChanged();
+}
+
+void SourceInfoPlugin::setSymbolDirectory(const QString& directory)
+{
+    m_symbolIndexer->setDirectory(directory);
+    m_symbolStatus = i18n("Indexing %1...", directory);
+    emit symbolStatusChanged();
+}
+
+void SourceInfoPlugin::clearSymbols()
+{
+    m_symbolIndexer->clear();
+    m_symbolStatus.clear();
+    emit symbolStatusChanged();
+
+    if (m_config->symbolSizes) {
+        m_config->symbolSizes.reset();
+        emit m_config->changed();
+    }
+}
+
+QString SourceInfoPlugin::symbolStatus() const
+{
+    return m_symbolStatus;
+}
+
+void SourceInfoPlugin::symbolsIndexed(QSharedPointer<const BuildDataIndex> index)
+{
+    const auto symbolSizes = qSharedPointerCast<const SymbolSizeData>(index);
+    m_symbolStatus = i18np("%2: %3 functions from 1 build artifact", "%2: %3 functions from %1 build artifacts",
+                           symbolSizes->artifactCount(), symbolSizes->directory(), symbolSizes->functionCount());
+    emit symbolStatusChanged();
+
+    m_config->symbolSizes = symbolSizes;
+    emit m_config->changed();
+}
+
+void SourceInfoPlugin::symbolIndexFailed(const QString& error)
+{
+    m_symbolStatus = error;
+    emit symbolStatusChanged();
+}
+
+void SourceInfoPlugin::projectOpened(KDevelop::IProject* project)
+{
+    if (m_config->warmCacheOnProjectLoad) {
+        m_cacheWarmer->warmProject(project);
+    }
+}
+
+void SourceInfoPlugin::projectClosing(KDevelop::IProject* project)
+{
+    m_cacheWarmer->forgetProject(project);
+}
+
+void SourceInfoPlugin::configChanged()
+{
+    // The providers rebuild right away, they must not find notes computed with the old settings
+    if (!m_noteSettings.hasSameNotes(*m_config)) {
+        m_cacheWarmer->cancel();
+        m_noteCache->clear();
+        m_noteSettings = *m_config;
+        m_rewarmPending = true;
+    }
+
+    m_configTimer.start();
+}
+
+void SourceInfoPlugin::applyConfig()
+{
+    // A new thread count applies to the pending files as they are scheduled, only switching the warming needs a restart
+    const bool warmingChanged = m_config->warmCacheOnProjectLoad != m_appliedSettings.warmCacheOnProjectLoad;
+    m_appliedSettings = *m_config;
+
+    m_noteCache->setBudget(size_t(m_config->noteCacheBudgetMiB) * 1024 * 1024);
+    m_cacheWarmer->setMaxThreadCount(m_config->warmCacheMaxThreads);
+    NoteBuilder::gatherPool().setMaxThreadCount(qMax(m_config->parallelGatherThreads, 1));
+
+    if (warmingChanged || m_rewarmPending) {
+        m_rewarmPending = false;
+        m_cacheWarmer->cancel();
+        if (m_config->warmCacheOnProjectLoad) {
+            for (auto *project : ICore::self()->projectController()->projects()) {
+                m_cacheWarmer->warmProject(project);
+            }
+        }
     }
+
+    enforceMemoryBudget();
 }
 
 
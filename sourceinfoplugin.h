@@ -21,6 +21,8 @@
 #define SOURCEINFOPLUGIN_H
 
 #include <QMap>
+#include <QSet>
+#include <QTimer>
 #include <QVariant>
 
 #include <interfaces/iplugin.h>
@@ -33,34 +35,188 @@ class KJob;
 
 namespace KDevelop {
 class IDocument;
+class IProject;
 }
 
 namespace KTextEditor {
 class Document;
 class InlineNoteProvider;
+class View;
 }
 
+class CacheWarmer;
+class BuildDataIndex;
+class BuildDataIndexer;
+class NoteCache;
+class ProfileData;
+class ProfileLoader;
+class ScanWorker;
 class SourceInfoToolViewFactory;
+class TraceRecorder;
 
 
 class SourceInfoPlugin : public KDevelop::IPlugin
 {
     Q_OBJECT
 
+    // Settings changed in quick succession, like the ticks of a spin box, are applied to the cache warming once
+    static constexpr int CONFIG_APPLY_DELAY_MS = 300;
+
   public:
     SourceInfoPlugin(QObject *parent, const QVariantList & = QVariantList() );
     ~SourceInfoPlugin() override;
 
     void unload() override;
 
+    size_t notesMemoryUsage() const;
+    size_t notesMemoryBudget() const;
+    int evictedDocumentsCount() const;
+
+    /**
+     * Memory of the cached notes not shown in any open document, those are
+     * counted by notesMemoryUsage().
+     */
+    size_t cacheMemoryUsage() const;
+    size_t cacheMemoryBudget() const;
+
+    /**
+     * See SourceInfoInlineNoteProvider::degradationDescription(), for the
+     * last viewed document.
+     */
+    QString activeDocumentDegradation() const;
+
+    /**
+     * See SourceInfoInlineNoteProvider::allocationSummary(), for the last
+     * viewed document.
+     */
+    QString activeDocumentAllocations() const;
+
+    /**
+     * Record the events driving the notes of the open documents, see
+     * TraceRecorder.
+     */
+    bool startTraceRecording(const QString& path);
+    void stopTraceRecording();
+
+    /**
+     * Replay a recorded trace, the result is reported by
+     * traceReplayFinished().
+     *
+     * \return false with the reason in error if the trace can not be loaded
+     */
+    bool replayTrace(const QString& path, QString* error);
+
+    /**
+     * Load the profile shown by the profile notes in background, replacing
+     * the current one once it is ready.
+     */
+    void loadProfile(const QString& path);
+    void clearProfile();
+
+    /**
+     * The loaded profile or the progress of loading one, for the tool view.
+     */
+    QString profileStatus() const;
+
+    /**
+     * Index the coverage data in the build directory for the coverage notes,
+     * following changes to it until cleared.
+     */
+    void setCoverageDirectory(const QString& directory);
+    void clearCoverage();
+
+    QString coverageStatus() const;
+
+    /**
+     * Index the optimization records in the build directory for the
+     * optimization remark notes, following changes to them until cleared.
+     */
+    void setOptRemarkDirectory(const QString& directory);
+    void clearOptRemarks();
+
+    QString optRemarkStatus() const;
+
+    /**
+     * Index the symbols of the object files and shared libraries in the
+     * build directory for the code size notes, following changes to them
+     * until cleared.
+     */
+    void setSymbolDirectory(const QString& directory);
+    void clearSymbols();
+
+    QString symbolStatus() const;
+
+Q_SIGNALS:
+    void memoryUsageChanged();
+    void degradationChanged();
+    void allocationsChanged();
+    void traceReplayFinished(const QString& report);
+    void profileStatusChanged();
+    void coverageStatusChanged();
+    void optRemarkStatusChanged();
+    void symbolStatusChanged();
+
 private Q_SLOTS:
     void documentOpened(KDevelop::IDocument* document);
     void documentClosed(KDevelop::IDocument* document);
+    void documentActivated(KDevelop::IDocument* document);
+    void documentViewCreated(KTextEditor::Document* document, KTextEditor::View* view);
+
+    void enforceMemoryBudget();
+
+    void projectOpened(KDevelop::IProject* project);
+    void projectClosing(KDevelop::IProject* project);
+
+    void configChanged();
+    void applyConfig();
+
+    void profileLoadProgress(int percent);
+    void profileLoaded(QSharedPointer<const ProfileData> profile);
+    void profileLoadFailed(const QString& error);
+
+    void coverageIndexed(QSharedPointer<const BuildDataIndex> index);
+    void coverageIndexFailed(const QString& error);
+
+    void optRemarksIndexed(QSharedPointer<const BuildDataIndex> index);
+    void optRemarkIndexFailed(const QString& error);
+
+    void symbolsIndexed(QSharedPointer<const BuildDataIndex> index);
+    void symbolIndexFailed(const QString& error);
+
+private:
+    /**
+     * Set up the notes of the document, once it is shown for the first time.
+     */
+    void createProvider(KTextEditor::Document* document);
+
+    /**
+     * The distinct notes shown in the open documents.
+     */
+    QSet<const NoteStore*> shownNotes() const;
 
 private:
-    QMap<KTextEditor::Document*, KTextEditor::InlineNoteProvider*> m_documentToProviderMap;
+    QMap<KTextEditor::Document*, SourceInfoInlineNoteProvider*> m_documentToProviderMap;
+    QList<KTextEditor::Document*> m_viewOrder; // Least recently viewed first
 
     QSharedPointer<SourceInfoConfig> m_config;
+    SourceInfoSettings m_noteSettings;    // The cached notes were computed with these
+    SourceInfoSettings m_appliedSettings; // Last applied to the cache warming and the budgets
+    bool m_rewarmPending = false;
+    QTimer m_configTimer;
+    QSharedPointer<TypeStringCache> m_typeStrings;
+    QSharedPointer<NoteCache> m_noteCache;
+    CacheWarmer* m_cacheWarmer;
+    TraceRecorder* m_traceRecorder;
+    ScanWorker* m_scanWorker;
+    ProfileLoader* m_profileLoader;
+    QString m_profilePath;
+    QString m_profileStatus;
+    BuildDataIndexer* m_coverageIndexer;
+    QString m_coverageStatus;
+    BuildDataIndexer* m_optRemarkIndexer;
+    QString m_optRemarkStatus;
+    BuildDataIndexer* m_symbolIndexer;
+    QString m_symbolStatus;
     SourceInfoToolViewFactory* m_viewFactory;
 };
 
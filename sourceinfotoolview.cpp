@@ -20,24 +20,119 @@
 #include "sourceinfotoolview.h"
 #include "sourceinfoplugin.h"
 
+#include <KLocalizedString>
 
-SourceInfoToolView::SourceInfoToolView(QSharedPointer<SourceInfoConfig> config, QWidget* parent)
+#include <QFileDialog>
+#include <QSignalBlocker>
+
+
+namespace {
+
+QString formatMiB(size_t bytes)
+{
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1);
+}
+
+}
+
+
+SourceInfoToolView::SourceInfoToolView(SourceInfoPlugin* plugin, QSharedPointer<SourceInfoConfig> config, QWidget* parent)
     : QWidget(parent)
+    , m_plugin(plugin)
     , m_config(config)
 {
     Ui::SourceInfoToolView::setupUi(this);
 
     functionArgumentNamesCheck->setChecked(m_config->showFunctionArgumentNames);
     functionDefaultValuesCheck->setChecked(m_config->showFunctionArgumentDefaultValues);
+    virtualCallCheck->setChecked(m_config->showVirtualCalls);
+    calleeSizeCheck->setChecked(m_config->showCalleeSize);
+    loopAllocationCheck->setChecked(m_config->showLoopAllocations);
+    argumentCopyCheck->setChecked(m_config->showArgumentCopies);
+    argumentCopyThresholdSpin->setValue(m_config->argumentCopyThresholdBytes);
     structFieldSizeCheck->setChecked(m_config->showStructFieldSize);
     autoTypeCheck->setChecked(m_config->showAutoType);
+    autoTypeAbbreviateCheck->setChecked(m_config->abbreviateAutoType);
+    autoTypeMaxDepthSpin->setValue(m_config->autoTypeMaxDepth);
+    autoTypeSizeCheck->setChecked(m_config->showAutoTypeSize);
+    autoTypeSizeHighlightSpin->setValue(m_config->autoTypeSizeHighlightBytes);
     enumValueCheck->setChecked(m_config->showEnumConstValues);
+    warmCacheCheck->setChecked(m_config->warmCacheOnProjectLoad);
+    warmCacheMaxThreadsSpin->setValue(m_config->warmCacheMaxThreads);
+    noteCacheBudgetSpin->setValue(m_config->noteCacheBudgetMiB);
+    openDocumentsBudgetSpin->setValue(m_config->openDocumentsBudgetMiB);
+    rebuildStepBudgetSpin->setValue(m_config->rebuildStepBudgetUs);
+    passBudgetSpin->setValue(m_config->passBudgetMs);
+    parallelGatherThreadsSpin->setValue(m_config->parallelGatherThreads);
+    outOfProcessScanningCheck->setChecked(m_config->outOfProcessScanning);
+    profileCheck->setChecked(m_config->showProfile);
+    coverageCheck->setChecked(m_config->showCoverage);
+    optRemarksCheck->setChecked(m_config->showOptRemarks);
+    passedOptRemarksCheck->setChecked(m_config->showPassedOptRemarks);
+    optRemarkPassesEdit->setText(m_config->optRemarkPasses.join(QStringLiteral(", ")));
+    symbolSizeCheck->setChecked(m_config->showSymbolSizes);
 
     connect(functionArgumentNamesCheck, &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
     connect(functionDefaultValuesCheck, &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(virtualCallCheck,           &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(calleeSizeCheck,            &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(loopAllocationCheck,        &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(argumentCopyCheck,          &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(argumentCopyThresholdSpin,  QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
     connect(structFieldSizeCheck,       &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
     connect(autoTypeCheck,              &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(autoTypeAbbreviateCheck,    &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(autoTypeMaxDepthSpin,       QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
+    connect(autoTypeSizeCheck,          &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(autoTypeSizeHighlightSpin,  QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
     connect(enumValueCheck,             &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(warmCacheCheck,             &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(warmCacheMaxThreadsSpin,    QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
+    connect(noteCacheBudgetSpin,        QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
+    connect(openDocumentsBudgetSpin,    QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
+    connect(rebuildStepBudgetSpin,      QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
+    connect(passBudgetSpin,             QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
+    connect(parallelGatherThreadsSpin,  QOverload<int>::of(&QSpinBox::valueChanged), this, &SourceInfoToolView::uiStateChanged);
+    connect(outOfProcessScanningCheck,  &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(profileCheck,               &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(coverageCheck,              &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(optRemarksCheck,            &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(passedOptRemarksCheck,      &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+    connect(optRemarkPassesEdit,        &QLineEdit::editingFinished, this, &SourceInfoToolView::uiStateChanged);
+    connect(symbolSizeCheck,            &QCheckBox::stateChanged, this, &SourceInfoToolView::uiStateChanged);
+
+    connect(m_plugin, &SourceInfoPlugin::memoryUsageChanged, this, &SourceInfoToolView::updateMemoryUsage);
+    updateMemoryUsage();
+
+    connect(m_plugin, &SourceInfoPlugin::degradationChanged, this, &SourceInfoToolView::updateDegradation);
+    updateDegradation();
+
+    connect(m_plugin, &SourceInfoPlugin::allocationsChanged, this, &SourceInfoToolView::updateAllocations);
+    updateAllocations();
+
+    connect(recordTraceButton, &QPushButton::toggled, this, &SourceInfoToolView::recordTraceToggled);
+    connect(replayTraceButton, &QPushButton::clicked, this, &SourceInfoToolView::replayTraceClicked);
+    connect(m_plugin, &SourceInfoPlugin::traceReplayFinished, this, &SourceInfoToolView::traceReplayFinished);
+
+    connect(loadProfileButton, &QPushButton::clicked, this, &SourceInfoToolView::loadProfileClicked);
+    connect(clearProfileButton, &QPushButton::clicked, this, &SourceInfoToolView::clearProfileClicked);
+    connect(m_plugin, &SourceInfoPlugin::profileStatusChanged, this, &SourceInfoToolView::updateProfileStatus);
+    updateProfileStatus();
+
+    connect(coverageDirectoryButton, &QPushButton::clicked, this, &SourceInfoToolView::coverageDirectoryClicked);
+    connect(clearCoverageButton, &QPushButton::clicked, this, &SourceInfoToolView::clearCoverageClicked);
+    connect(m_plugin, &SourceInfoPlugin::coverageStatusChanged, this, &SourceInfoToolView::updateCoverageStatus);
+    updateCoverageStatus();
+
+    connect(optRemarkDirectoryButton, &QPushButton::clicked, this, &SourceInfoToolView::optRemarkDirectoryClicked);
+    connect(clearOptRemarksButton, &QPushButton::clicked, this, &SourceInfoToolView::clearOptRemarksClicked);
+    connect(m_plugin, &SourceInfoPlugin::optRemarkStatusChanged, this, &SourceInfoToolView::updateOptRemarkStatus);
+    updateOptRemarkStatus();
+
+    connect(symbolDirectoryButton, &QPushButton::clicked, this, &SourceInfoToolView::symbolDirectoryClicked);
+    connect(clearSymbolsButton, &QPushButton::clicked, this, &SourceInfoToolView::clearSymbolsClicked);
+    connect(m_plugin, &SourceInfoPlugin::symbolStatusChanged, this, &SourceInfoToolView::updateSymbolStatus);
+    updateSymbolStatus();
 }
 
 SourceInfoToolView::~SourceInfoToolView()
@@ -48,13 +143,184 @@ void SourceInfoToolView::uiStateChanged()
 {
     m_config->showFunctionArgumentNames = functionArgumentNamesCheck->isChecked();
     m_config->showFunctionArgumentDefaultValues = functionDefaultValuesCheck->isChecked();
+    m_config->showVirtualCalls = virtualCallCheck->isChecked();
+    m_config->showCalleeSize = calleeSizeCheck->isChecked();
+    m_config->showLoopAllocations = loopAllocationCheck->isChecked();
+    m_config->showArgumentCopies = argumentCopyCheck->isChecked();
+    m_config->argumentCopyThresholdBytes = argumentCopyThresholdSpin->value();
     m_config->showStructFieldSize = structFieldSizeCheck->isChecked();
     m_config->showAutoType = autoTypeCheck->isChecked();
+    m_config->abbreviateAutoType = autoTypeAbbreviateCheck->isChecked();
+    m_config->autoTypeMaxDepth = autoTypeMaxDepthSpin->value();
+    m_config->showAutoTypeSize = autoTypeSizeCheck->isChecked();
+    m_config->autoTypeSizeHighlightBytes = autoTypeSizeHighlightSpin->value();
     m_config->showEnumConstValues = enumValueCheck->isChecked();
+    m_config->warmCacheOnProjectLoad = warmCacheCheck->isChecked();
+    m_config->warmCacheMaxThreads = warmCacheMaxThreadsSpin->value();
+    m_config->noteCacheBudgetMiB = noteCacheBudgetSpin->value();
+    m_config->openDocumentsBudgetMiB = openDocumentsBudgetSpin->value();
+    m_config->rebuildStepBudgetUs = rebuildStepBudgetSpin->value();
+    m_config->passBudgetMs = passBudgetSpin->value();
+    m_config->parallelGatherThreads = parallelGatherThreadsSpin->value();
+    m_config->outOfProcessScanning = outOfProcessScanningCheck->isChecked();
+    m_config->showProfile = profileCheck->isChecked();
+    m_config->showCoverage = coverageCheck->isChecked();
+    m_config->showOptRemarks = optRemarksCheck->isChecked();
+    m_config->showPassedOptRemarks = passedOptRemarksCheck->isChecked();
+    m_config->showSymbolSizes = symbolSizeCheck->isChecked();
+
+    m_config->optRemarkPasses.clear();
+    for (const QString& pass : optRemarkPassesEdit->text().split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        m_config->optRemarkPasses.append(pass.trimmed());
+    }
 
     emit m_config->changed();
 }
 
+void SourceInfoToolView::updateMemoryUsage()
+{
+    memoryUsageLabel->setText(i18n("Open documents: %1 of %2 MiB (%3 evicted)\nCache: %4 of %5 MiB",
+                                   formatMiB(m_plugin->notesMemoryUsage()),
+                                   formatMiB(m_plugin->notesMemoryBudget()),
+                                   m_plugin->evictedDocumentsCount(),
+                                   formatMiB(m_plugin->cacheMemoryUsage()),
+                                   formatMiB(m_plugin->cacheMemoryBudget())));
+}
+
+void SourceInfoToolView::updateDegradation()
+{
+    const QString degradation = m_plugin->activeDocumentDegradation();
+    degradationLabel->setVisible(!degradation.isEmpty());
+    degradationLabel->setText(i18n("Some notes of this document exceeded the time budget:\n%1", degradation));
+}
+
+void SourceInfoToolView::updateAllocations()
+{
+    const QString allocations = m_plugin->activeDocumentAllocations();
+    allocationSummaryLabel->setVisible(!allocations.isEmpty());
+    allocationSummaryLabel->setText(i18n("Allocations in the deepest loops of this document:\n%1", allocations));
+}
+
+void SourceInfoToolView::recordTraceToggled(bool checked)
+{
+    if (!checked) {
+        m_plugin->stopTraceRecording();
+        traceReportLabel->setText(QString());
+        return;
+    }
+
+    const QString path = QFileDialog::getSaveFileName(this, i18n("Record Trace"), QString(), i18n("Traces (*.trace)"));
+    if (path.isEmpty() || !m_plugin->startTraceRecording(path)) {
+        QSignalBlocker blocker(recordTraceButton);
+        recordTraceButton->setChecked(false);
+        return;
+    }
+
+    traceReportLabel->setText(i18n("Recording to %1", path));
+}
+
+void SourceInfoToolView::replayTraceClicked()
+{
+    const QString path = QFileDialog::getOpenFileName(this, i18n("Replay Trace"), QString(), i18n("Traces (*.trace)"));
+    if (path.isEmpty()) return;
+
+    QString error;
+    if (!m_plugin->replayTrace(path, &error)) {
+        traceReportLabel->setText(i18n("Failed to load %1: %2", path, error));
+        return;
+    }
+
+    replayTraceButton->setEnabled(false);
+    traceReportLabel->setText(i18n("Replaying %1...", path));
+}
+
+void SourceInfoToolView::traceReplayFinished(const QString& report)
+{
+    replayTraceButton->setEnabled(true);
+    traceReportLabel->setText(report);
+}
+
+void SourceInfoToolView::loadProfileClicked()
+{
+    const QString path = QFileDialog::getOpenFileName(this, i18n("Load Profile"), QString(),
+                                                      i18n("Profiles (perf.script *.perf *.txt callgrind.out.* *.folded);;All Files (*)"));
+    if (path.isEmpty()) return;
+
+    m_plugin->loadProfile(path);
+}
+
+void SourceInfoToolView::clearProfileClicked()
+{
+    m_plugin->clearProfile();
+}
+
+void SourceInfoToolView::updateProfileStatus()
+{
+    const QString status = m_plugin->profileStatus();
+    profileStatusLabel->setVisible(!status.isEmpty());
+    profileStatusLabel->setText(status);
+}
+
+void SourceInfoToolView::coverageDirectoryClicked()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, i18n("Coverage Build Directory"));
+    if (directory.isEmpty()) return;
+
+    m_plugin->setCoverageDirectory(directory);
+}
+
+void SourceInfoToolView::clearCoverageClicked()
+{
+    m_plugin->clearCoverage();
+}
+
+void SourceInfoToolView::updateCoverageStatus()
+{
+    const QString status = m_plugin->coverageStatus();
+    coverageStatusLabel->setVisible(!status.isEmpty());
+    coverageStatusLabel->setText(status);
+}
+
+void SourceInfoToolView::optRemarkDirectoryClicked()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, i18n("Optimization Records Build Directory"));
+    if (directory.isEmpty()) return;
+
+    m_plugin->setOptRemarkDirectory(directory);
+}
+
+void SourceInfoToolView::clearOptRemarksClicked()
+{
+    m_plugin->clearOptRemarks();
+}
+
+void SourceInfoToolView::updateOptRemarkStatus()
+{
+    const QString status = m_plugin->optRemarkStatus();
+    optRemarkStatusLabel->setVisible(!status.isEmpty());
+    optRemarkStatusLabel->setText(status);
+}
+
+void SourceInfoToolView::symbolDirectoryClicked()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, i18n("Object Files Build Directory"));
+    if (directory.isEmpty()) return;
+
+    m_plugin->setSymbolDirectory(directory);
+}
+
+void SourceInfoToolView::clearSymbolsClicked()
+{
+    m_plugin->clearSymbols();
+}
+
+void SourceInfoToolView::updateSymbolStatus()
+{
+    const QString status = m_plugin->symbolStatus();
+    symbolStatusLabel->setVisible(!status.isEmpty());
+    symbolStatusLabel->setText(status);
+}
+
 void SourceInfoToolView::selectNextItem()
 {
     // TODO ?
@@ -37,7 +37,7 @@ class SourceInfoToolView : public QWidget, Ui::SourceInfoToolView, public KDevel
     Q_INTERFACES(KDevelop::IToolViewActionListener)
 
 public:
-    SourceInfoToolView(QSharedPointer<SourceInfoConfig> config, QWidget* parent);
+    SourceInfoToolView(SourceInfoPlugin* plugin, QSharedPointer<SourceInfoConfig> config, QWidget* parent);
     ~SourceInfoToolView() override;
 
 public Q_SLOTS:
@@ -46,8 +46,27 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void uiStateChanged();
+    void updateMemoryUsage();
+    void updateDegradation();
+    void updateAllocations();
+    void recordTraceToggled(bool checked);
+    void replayTraceClicked();
+    void traceReplayFinished(const QString& report);
+    void loadProfileClicked();
+    void clearProfileClicked();
+    void updateProfileStatus();
+    void coverageDirectoryClicked();
+    void clearCoverageClicked();
+    void updateCoverageStatus();
+    void optRemarkDirectoryClicked();
+    void clearOptRemarksClicked();
+    void updateOptRemarkStatus();
+    void symbolDirectoryClicked();
+    void clearSymbolsClicked();
+    void updateSymbolStatus();
 
 private:
+    SourceInfoPlugin* m_plugin;
     QSharedPointer<SourceInfoConfig> m_config;
 };
 
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QList>
+#include <QLocalSocket>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+
+#include "noterecords.h"
+#include "notescanner.h"
+#include "scanprotocol.h"
+#include "textsource.h"
+
+
+/**
+ * The kdevsourceinfo-worker process: connects to the local server given on
+ * the command line, identifies itself with the token read from the standard
+ * input and matches the records sent by ScanWorker with the text, see
+ * ScanProtocol.
+ *
+ * Requests are handled one at a time in the order they came. The notes are
+ * sent in batches, incoming messages are processed between the batches so
+ * that cancelled requests stop early.
+ */
+class Worker : public QObject
+{
+    Q_OBJECT
+
+    // Records matched per NotesReply
+    static constexpr int BATCH_RECORDS = 256;
+
+public:
+    Worker(const QString& serverName, const QByteArray& token);
+
+private Q_SLOTS:
+    void readyRead();
+    void processRequests();
+
+private:
+    void processRequest(const QByteArray& request);
+    void reply(ScanProtocol::MessageType type, quint32 id, const QVector<ScannedNote>& notes);
+
+private:
+    QLocalSocket m_socket;
+    QByteArray m_buffer;
+
+    QList<QByteArray> m_requests;
+    QSet<quint32> m_cancelled;
+    bool m_processing = false;
+};
+
+constexpr int Worker::BATCH_RECORDS;
+
+
+Worker::Worker(const QString& serverName, const QByteArray& token)
+{
+    connect(&m_socket, &QLocalSocket::readyRead, this, &Worker::readyRead);
+    connect(&m_socket, &QLocalSocket::disconnected, qApp, &QCoreApplication::quit);
+
+    m_socket.connectToServer(serverName);
+    if (!m_socket.waitForConnected()) {
+        QTimer::singleShot(0, qApp, &QCoreApplication::quit);
+        return;
+    }
+
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    stream.setVersion(ScanProtocol::STREAM_VERSION);
+    stream << quint8(ScanProtocol::Hello) << token;
+    ScanProtocol::writeMessage(&m_socket, message);
+    m_socket.flush();
+}
+
+void Worker::readyRead()
+{
+    m_buffer += m_socket.readAll();
+
+    QByteArray message;
+    while (ScanProtocol::takeMessage(m_buffer, message)) {
+        QDataStream stream(message);
+        stream.setVersion(ScanProtocol::STREAM_VERSION);
+
+        quint8 type;
+        quint32 id;
+        stream >> type >> id;
+
+        if (type == ScanProtocol::ScanRequest) {
+            m_requests.append(message);
+        } else if (type == ScanProtocol::CancelRequest) {
+            m_cancelled.insert(id);
+        }
+    }
+
+    if (!m_processing && !m_requests.isEmpty()) {
+        QTimer::singleShot(0, this, &Worker::processRequests);
+        m_processing = true;
+    }
+}
+
+void Worker::processRequests()
+{
+    while (!m_requests.isEmpty()) {
+        processRequest(m_requests.takeFirst());
+    }
+    m_cancelled.clear();
+    m_processing = false;
+}
+
+void Worker::processRequest(const QByteArray& request)
+{
+    QDataStream stream(request);
+    stream.setVersion(ScanProtocol::STREAM_VERSION);
+
+    quint8 type;
+    quint32 id;
+    bool showArgumentNames, showDefaultValues;
+    QString text;
+    QVector<EnumeratorRecord> enumerators;
+    QVector<CallSiteRecord> callSites;
+    stream >> type >> id >> showArgumentNames >> showDefaultValues >> text >> enumerators >> callSites;
+
+    FileTextSource source;
+    source.setText(text);
+
+    NoteScanner scanner(source, showArgumentNames, showDefaultValues);
+    scanner.setRecords(enumerators, callSites);
+
+    QVector<ScannedNote> notes;
+    while (!scanner.atEnd() && !m_cancelled.contains(id)) {
+        for (int i = 0; i < BATCH_RECORDS && !scanner.atEnd(); i++) {
+            scanner.scanNext(notes);
+        }
+        if (!notes.isEmpty()) {
+            reply(ScanProtocol::NotesReply, id, notes);
+            notes.clear();
+        }
+
+        // Receive cancellations and new requests, readyRead() only queues them
+        m_socket.flush();
+        QCoreApplication::processEvents();
+    }
+
+    // Also for cancelled requests, the plugin counts on every request being answered
+    reply(ScanProtocol::DoneReply, id, notes);
+}
+
+void Worker::reply(ScanProtocol::MessageType type, quint32 id, const QVector<ScannedNote>& notes)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    stream.setVersion(ScanProtocol::STREAM_VERSION);
+
+    stream << quint8(type) << id;
+    if (type == ScanProtocol::NotesReply) {
+        stream << notes;
+    }
+    ScanProtocol::writeMessage(&m_socket, message);
+    m_socket.flush();
+}
+
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    const QStringList arguments = app.arguments();
+    if (arguments.size() != 2) {
+        qWarning("Usage: %s <server name>", argv[0]);
+        return 1;
+    }
+
+    // Hex encoded on one line
+    QFile input;
+    if (!input.open(stdin, QIODevice::ReadOnly)) {
+        return 1;
+    }
+    const QByteArray token = QByteArray::fromHex(input.readLine().trimmed());
+
+    Worker worker(arguments.at(1), token);
+    return app.exec();
+}
+
+#include "sourceinfoworker.moc"
@@ -0,0 +1,384 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+
+#include <elf.h>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QPair>
+#include <QSet>
+#include <QSysInfo>
+
+#include <KLocalizedString>
+
+#include "demangle.h"
+#include "symbolsizedata.h"
+
+#include <debug.h>
+
+
+namespace {
+
+const QStringList ARTIFACT_PATTERNS = { QStringLiteral("*.o"), QStringLiteral("*.so"), QStringLiteral("*.so.*") };
+
+// Symbolic links to shared libraries point to files that are indexed anyway
+const QDir::Filters ARTIFACT_FILTERS = QDir::Files | QDir::Readable | QDir::NoSymLinks;
+
+// Only files in the byte order of the host are read
+const unsigned char HOST_BYTE_ORDER = QSysInfo::ByteOrder == QSysInfo::LittleEndian ? ELFDATA2LSB : ELFDATA2MSB;
+
+template<typename T>
+bool readStruct(const uchar* data, quint64 size, quint64 offset, T* result)
+{
+    if (offset > size || size - offset < sizeof(T)) return false;
+    std::memcpy(result, data + offset, sizeof(T));
+    return true;
+}
+
+// Sizes of the functions defined in the ELF file, by mangled name
+template<typename Ehdr, typename Shdr, typename Sym>
+QHash<QByteArray, quint64> readFunctionSymbols(const uchar* data, quint64 size)
+{
+    QHash<QByteArray, quint64> functions;
+
+    Ehdr header;
+    if (!readStruct(data, size, 0, &header)) return functions;
+    if (header.e_shoff == 0 || header.e_shentsize != sizeof(Shdr)) return functions;
+
+    // Files with too many sections for the header keep the count in the first section header
+    quint64 sectionCount = header.e_shnum;
+    if (sectionCount == 0) {
+        Shdr first;
+        if (!readStruct(data, size, header.e_shoff, &first)) return functions;
+        sectionCount = first.sh_size;
+    }
+
+    // The full symbol table of object files and unstripped libraries, the dynamic one of stripped libraries
+    Shdr symbolTable = Shdr();
+    bool found = false;
+    for (quint64 i = 0; i < sectionCount; i++) {
+        Shdr section;
+        if (!readStruct(data, size, header.e_shoff + i * sizeof(Shdr), &section)) return functions;
+        if (section.sh_type == SHT_SYMTAB || (section.sh_type == SHT_DYNSYM && !found)) {
+            symbolTable = section;
+            found = true;
+        }
+    }
+    if (!found || symbolTable.sh_entsize != sizeof(Sym) || symbolTable.sh_link >= sectionCount) return functions;
+
+    Shdr strings;
+    if (!readStruct(data, size, header.e_shoff + symbolTable.sh_link * sizeof(Shdr), &strings)) return functions;
+    if (strings.sh_offset > size || size - strings.sh_offset < strings.sh_size) return functions;
+    const char* stringData = reinterpret_cast<const char*>(data + strings.sh_offset);
+
+    // Aliases, like the complete and base object constructors, share the address and are counted once
+    QSet<QPair<quint32, quint64>> addresses;
+
+    const quint64 symbolCount = symbolTable.sh_size / sizeof(Sym);
+    for (quint64 i = 0; i < symbolCount; i++) {
+        Sym symbol;
+        if (!readStruct(data, size, symbolTable.sh_offset + i * sizeof(Sym), &symbol)) break;
+
+        const int type = symbol.st_info & 0xf;
+        if (type != STT_FUNC && type != STT_GNU_IFUNC) continue;
+        if (symbol.st_shndx == SHN_UNDEF || symbol.st_size == 0 || symbol.st_name >= strings.sh_size) continue;
+
+        const char* name = stringData + symbol.st_name;
+        const char* end = static_cast<const char*>(std::memchr(name, 0, strings.sh_size - symbol.st_name));
+        if (!end || end == name) continue;
+
+        const auto address = qMakePair(quint32(symbol.st_shndx), quint64(symbol.st_value));
+        if (addresses.contains(address)) continue;
+        addresses.insert(address);
+
+        const QByteArray mangled(name, end - name);
+        functions.insert(mangled, qMax(functions.value(mangled), quint64(symbol.st_size)));
+    }
+    return functions;
+}
+
+bool isIdentifierCharacter(const QChar c)
+{
+    return c.isLetterOrNumber() || c == '_';
+}
+
+bool isOperatorAt(const QString& text, int i)
+{
+    static const QLatin1String keyword("operator");
+    if (text.midRef(i, keyword.size()) != keyword) return false;
+    if (i > 0 && isIdentifierCharacter(text.at(i - 1))) return false;
+    return i + keyword.size() == text.size() || !isIdentifierCharacter(text.at(i + keyword.size()));
+}
+
+// End of the name of the operator starting at i, its symbol may contain brackets
+int operatorEnd(const QString& text, int i)
+{
+    static const QString symbols = QStringLiteral("+-*/%^&|~!=<>,[]");
+
+    int end = i + 8;
+    if (text.midRef(end, 2) == QLatin1String("()")) {
+        return end + 2;
+    }
+    if (end < text.size() && text.at(end) == ' ') {
+        // Like operator new[] or conversions, up to the parameters
+        while (end < text.size() && text.at(end) != '(') end++;
+        return end;
+    }
+    while (end < text.size() && symbols.contains(text.at(end))) end++;
+    return end;
+}
+
+int matchingParenthesis(const QString& text, int i)
+{
+    int depth = 0;
+    for (; i < text.size(); i++) {
+        if (text.at(i) == '(') depth++;
+        else if (text.at(i) == ')' && --depth == 0) return i;
+    }
+    return -1;
+}
+
+}
+
+
+QSharedPointer<BuildDataIndex> SymbolSizeData::scan(const QString& directory, const QAtomicInt& cancelled, QString* error)
+{
+    const QDir dir(directory);
+    if (!dir.exists() || !dir.isReadable()) {
+        if (error) *error = i18n("Can not read %1", directory);
+        return QSharedPointer<BuildDataIndex>();
+    }
+
+    auto data = QSharedPointer<SymbolSizeData>::create();
+    data->m_directory = dir.absolutePath();
+
+    QDirIterator iter(data->m_directory, ARTIFACT_PATTERNS, ARTIFACT_FILTERS, QDirIterator::Subdirectories);
+    while (iter.hasNext()) {
+        if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+        iter.next();
+        data->addArtifact(iter.fileInfo());
+    }
+    if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+    data->sumSizes();
+
+    qCDebug(KDEV_SOURCEINFO) << "Indexed symbols of" << data->m_artifacts.size() << "build artifacts with"
+                             << data->m_sizes.size() << "functions in" << data->m_directory;
+    return data;
+}
+
+QSharedPointer<BuildDataIndex> SymbolSizeData::refreshed(const QSet<QString>& directories, const QAtomicInt& cancelled) const
+{
+    auto data = QSharedPointer<SymbolSizeData>::create();
+    data->m_directory = m_directory;
+    data->m_artifacts = m_artifacts;
+    data->m_artifactsByDirectory = m_artifactsByDirectory;
+
+    int changed = 0;
+    for (const QString& directory : directories) {
+        if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+        QSet<QString> present;
+        const QFileInfoList entries = QDir(directory).entryInfoList(ARTIFACT_PATTERNS, ARTIFACT_FILTERS);
+        for (const QFileInfo& info : entries) {
+            const QString path = info.filePath();
+            present.insert(path);
+
+            auto known = data->m_artifacts.constFind(path);
+            if (known != data->m_artifacts.constEnd() && known->lastModified == info.lastModified()) continue;
+
+            data->removeArtifact(path);
+            data->addArtifact(info);
+            changed++;
+        }
+
+        // Deleted ones
+        const QSet<QString> known = data->m_artifactsByDirectory.value(directory);
+        for (const QString& path : known) {
+            if (!present.contains(path)) {
+                data->removeArtifact(path);
+                changed++;
+            }
+        }
+    }
+    if (cancelled.loadAcquire()) return QSharedPointer<BuildDataIndex>();
+
+    // Symbols move between the artifacts as the code changes, so the sums are done again from scratch
+    data->sumSizes();
+
+    qCDebug(KDEV_SOURCEINFO) << "Refreshed symbols of" << changed << "build artifacts in" << directories.size() << "directories";
+    return data;
+}
+
+void SymbolSizeData::addArtifact(const QFileInfo& info)
+{
+    Artifact artifact;
+    artifact.lastModified = info.lastModified();
+
+    // XXX: The build may truncate the file while it is mapped, which would crash us. The indexer only refreshes
+    //      after the files stopped changing for a while and the symbols are read right away, which makes it unlikely.
+    QFile file(info.filePath());
+    if (file.open(QIODevice::ReadOnly) && file.size() >= EI_NIDENT) {
+        const quint64 size = file.size();
+        if (const uchar* data = file.map(0, size)) {
+            QHash<QByteArray, quint64> functions;
+            if (std::memcmp(data, ELFMAG, SELFMAG) == 0 && data[EI_DATA] == HOST_BYTE_ORDER) {
+                if (data[EI_CLASS] == ELFCLASS64) {
+                    functions = readFunctionSymbols<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(data, size);
+                } else if (data[EI_CLASS] == ELFCLASS32) {
+                    functions = readFunctionSymbols<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>(data, size);
+                }
+            }
+            file.unmap(const_cast<uchar*>(data));
+
+            artifact.symbols.reserve(functions.size());
+            for (auto iter = functions.constBegin(); iter != functions.constEnd(); ++iter) {
+                artifact.symbols.append({ iter.key(), functionName(demangle(iter.key().constData())), iter.value() });
+            }
+        }
+    }
+
+    // Remembered even if it has no symbols, so it is not read again until it changes
+    const QString path = info.filePath();
+    m_artifactsByDirectory[info.path()].insert(path);
+    m_artifacts.insert(path, artifact);
+}
+
+void SymbolSizeData::removeArtifact(const QString& path)
+{
+    if (!m_artifacts.remove(path)) return;
+
+    const QString directory = QFileInfo(path).path();
+    QSet<QString>& inDirectory = m_artifactsByDirectory[directory];
+    inDirectory.remove(path);
+    if (inDirectory.isEmpty()) {
+        m_artifactsByDirectory.remove(directory);
+    }
+}
+
+void SymbolSizeData::sumSizes()
+{
+    // Symbols found in several artifacts are counted once
+    QHash<QByteArray, const Symbol*> unique;
+    const auto& artifacts = m_artifacts;
+    for (const Artifact& artifact : artifacts) {
+        for (const Symbol& symbol : artifact.symbols) {
+            const Symbol*& known = unique[symbol.mangled];
+            if (!known || known->size < symbol.size) {
+                known = &symbol;
+            }
+        }
+    }
+
+    m_sizes.clear();
+    for (const Symbol* symbol : unique) {
+        Size& size = m_sizes[symbol->function];
+        size.bytes += symbol->size;
+        size.symbols++;
+    }
+}
+
+QString SymbolSizeData::directory() const
+{
+    return m_directory;
+}
+
+QStringList SymbolSizeData::dataDirectories() const
+{
+    return m_artifactsByDirectory.keys();
+}
+
+SymbolSizeData::Size SymbolSizeData::size(const QString& qualifiedName) const
+{
+    return m_sizes.value(qualifiedName);
+}
+
+int SymbolSizeData::functionCount() const
+{
+    return m_sizes.size();
+}
+
+int SymbolSizeData::artifactCount() const
+{
+    return m_artifacts.size();
+}
+
+QString SymbolSizeData::functionName(const QString& demangled)
+{
+    QString text = demangled;
+
+    // Clones made by the optimizer, like "foo(int) [clone .constprop.0]"
+    const int clone = text.indexOf(QLatin1String(" [clone "));
+    if (clone >= 0) {
+        text.truncate(clone);
+    }
+    text.remove(QLatin1String("(anonymous namespace)::"));
+
+    // Everything in brackets is dropped, except for the parameters of functions that enclose local entities
+    QString name;
+    int depth = 0;
+    int i = 0;
+    while (i < text.size()) {
+        const QChar c = text.at(i);
+
+        if (depth == 0 && isOperatorAt(text, i)) {
+            const int end = operatorEnd(text, i);
+            name += text.midRef(i, end - i);
+            i = end;
+            continue;
+        }
+
+        if (depth == 0 && c == '(') {
+            const int end = matchingParenthesis(text, i);
+            if (end < 0 || text.midRef(end + 1, 2) != QLatin1String("::")) break; // The parameters of the function itself
+            i = end + 1;
+            continue;
+        }
+
+        if (c == '<' || c == '(' || c == '{' || c == '[') {
+            depth++;
+        } else if (c == '>' || c == ')' || c == '}' || c == ']') {
+            depth = qMax(0, depth - 1);
+        } else if (depth == 0) {
+            name += c;
+        }
+        i++;
+    }
+
+    // Function templates are prefixed with the return type
+    int operatorStart = name.size();
+    for (int k = 0; k < name.size(); k++) {
+        if (isOperatorAt(name, k)) {
+            operatorStart = k;
+            break;
+        }
+    }
+    if (operatorStart > 0) {
+        const int space = name.lastIndexOf(QLatin1Char(' '), operatorStart - 1);
+        if (space >= 0) {
+            name.remove(0, space + 1);
+        }
+    }
+
+    return name.trimmed();
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SYMBOLSIZEDATA_H
+#define SYMBOLSIZEDATA_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QVector>
+
+#include "builddataindex.h"
+
+
+/**
+ * Machine code size of functions, from the symbol tables of the object files
+ * and shared libraries in a build directory, for the code size notes.
+ *
+ * The ELF files are memory mapped and only their symbol tables are read.
+ * The symbols are demangled once when their file is read, and summed by
+ * function name, so that all template instantiations, overloads and clones
+ * made by the optimizer of one function add up. Symbols with the same
+ * mangled name in several files, like inline functions emitted into every
+ * object file that uses them or object files linked into a shared library,
+ * are counted once.
+ */
+class SymbolSizeData : public BuildDataIndex
+{
+public:
+    struct Size {
+        quint64 bytes = 0;
+        int symbols = 0; // Number of distinct symbols summed
+    };
+
+    /**
+     * Index the symbols in the directory, see BuildDataIndex::ScanFunction.
+     */
+    static QSharedPointer<BuildDataIndex> scan(const QString& directory, const QAtomicInt& cancelled, QString* error);
+
+    QSharedPointer<BuildDataIndex> refreshed(const QSet<QString>& directories, const QAtomicInt& cancelled) const override;
+    QString directory() const override;
+    QStringList dataDirectories() const override;
+
+    /**
+     * Size of the function with the given qualified name without template
+     * arguments and parameters, like "ns::Class::method".
+     */
+    Size size(const QString& qualifiedName) const;
+
+    int functionCount() const;
+    int artifactCount() const;
+
+    /**
+     * The name symbols are summed by: the qualified name of the function in
+     * a demangled symbol, without the return type, template arguments,
+     * parameters and anonymous namespaces.
+     */
+    static QString functionName(const QString& demangled);
+
+private:
+    struct Symbol {
+        QByteArray mangled;
+        QString function; // See functionName()
+        quint64 size;
+    };
+
+    struct Artifact {
+        QDateTime lastModified;
+        QVector<Symbol> symbols;
+    };
+
+    void addArtifact(const QFileInfo& info);
+    void removeArtifact(const QString& path);
+
+    // Sums the symbols of all artifacts into m_sizes
+    void sumSizes();
+
+    QString m_directory;
+
+    QHash<QString, Artifact> m_artifacts; // By path
+    QHash<QString, QSet<QString>> m_artifactsByDirectory;
+
+    QHash<QString, Size> m_sizes; // By function name
+};
+
+#endif // SYMBOLSIZEDATA_H
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QFile>
+
+#include <KTextEditor/Document>
+
+#include "textsource.h"
+
+
+namespace {
+
+// Cuts the range out of the lines returned by lineText, with the semantics of KTextEditor::Document::text()
+template<typename LineText>
+QString textOfRange(const KTextEditor::Range& range, int lineCount, LineText lineText)
+{
+    const int firstLine = qMax(range.start().line(), 0);
+    const int lastLine = qMin(range.end().line(), lineCount - 1);
+
+    QString result;
+    for (int line = firstLine; line <= lastLine; line++) {
+        const QString &text = lineText(line);
+        const int from = (line == range.start().line()) ? qMin(range.start().column(), text.size()) : 0;
+        const int to = (line == range.end().line()) ? qMin(range.end().column(), text.size()) : text.size();
+
+        if (line != firstLine) {
+            result += QLatin1Char('\n');
+        }
+        if (to > from) {
+            result += text.midRef(from, to - from);
+        }
+    }
+    return result;
+}
+
+}
+
+
+DocumentTextSource::DocumentTextSource(const KTextEditor::Document* document)
+    : m_document(document)
+{
+}
+
+QString DocumentTextSource::text(const KTextEditor::Range& range) const
+{
+    return m_document->text(range);
+}
+
+int DocumentTextSource::lineCount() const
+{
+    return m_document->lines();
+}
+
+QString DocumentTextSource::line(int line) const
+{
+    return m_document->line(line);
+}
+
+bool FileTextSource::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    setText(QString::fromUtf8(file.readAll()));
+    return true;
+}
+
+void FileTextSource::setText(const QString& text)
+{
+    m_lines = text.split(QLatin1Char('\n'));
+    for (auto &line : m_lines) {
+        if (line.endsWith(QLatin1Char('\r'))) {
+            line.chop(1);
+        }
+    }
+}
+
+void FileTextSource::replace(const KTextEditor::Range& range, const QString& text)
+{
+    if (m_lines.isEmpty()) {
+        m_lines.append(QString());
+    }
+
+    // Parts of the range outside of the text are ignored, like in text()
+    const int startLine = qBound(0, range.start().line(), m_lines.size() - 1);
+    const int endLine = qBound(startLine, range.end().line(), m_lines.size() - 1);
+    const QString head = m_lines.at(startLine).left(range.start().column());
+    const QString tail = (range.end().line() < m_lines.size()) ? m_lines.at(endLine).mid(range.end().column()) : QString();
+
+    QStringList inserted = text.split(QLatin1Char('\n'));
+    for (auto &line : inserted) {
+        if (line.endsWith(QLatin1Char('\r'))) {
+            line.chop(1);
+        }
+    }
+    inserted.first().prepend(head);
+    inserted.last().append(tail);
+
+    m_lines.erase(m_lines.begin() + startLine, m_lines.begin() + endLine + 1);
+    for (int i = 0; i < inserted.size(); i++) {
+        m_lines.insert(startLine + i, inserted.at(i));
+    }
+}
+
+QString FileTextSource::text(const KTextEditor::Range& range) const
+{
+    return textOfRange(range, m_lines.size(), [this](int line) -> const QString& { return m_lines.at(line); });
+}
+
+int FileTextSource::lineCount() const
+{
+    return m_lines.size();
+}
+
+QString FileTextSource::line(int line) const
+{
+    return m_lines.value(line);
+}
+
+TextStream::TextStream(const TextSource& source)
+    : m_source(source)
+    , m_lineCount(source.lineCount())
+{
+}
+
+QString TextStream::text(const KTextEditor::Range& range)
+{
+    Q_ASSERT(range.start().line() >= m_firstLine);
+
+    // Drop the lines no further range can start at
+    const int firstLine = qMax(range.start().line(), 0);
+    while (!m_lines.isEmpty() && m_firstLine < firstLine) {
+        m_lines.removeFirst();
+        m_firstLine++;
+    }
+    if (m_lines.isEmpty()) {
+        m_firstLine = firstLine;
+    }
+
+    // Fetch the lines that were not needed yet
+    const int lastLine = qMin(range.end().line(), m_lineCount - 1);
+    for (int line = m_firstLine + m_lines.size(); line <= lastLine; line++) {
+        m_lines.append(m_source.line(line));
+    }
+
+    return textOfRange(range, m_lineCount, [this](int line) -> const QString& { return m_lines.at(line - m_firstLine); });
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TEXTSOURCE_H
+#define TEXTSOURCE_H
+
+#include <QString>
+#include <QStringList>
+
+#include <KTextEditor/Range>
+
+
+namespace KTextEditor {
+class Document;
+}
+
+
+/**
+ * Source of the text the notes are computed for.
+ *
+ * Allows computing notes both for documents open in the editor and for files
+ * that are only on disk.
+ */
+class TextSource
+{
+public:
+    virtual ~TextSource() = default;
+
+    /**
+     * Text in the given range, lines separated by '\n'. Same semantics as
+     * KTextEditor::Document::text(), parts of the range outside of the text
+     * are ignored.
+     */
+    virtual QString text(const KTextEditor::Range& range) const = 0;
+
+    virtual int lineCount() const = 0;
+    virtual QString line(int line) const = 0;
+};
+
+
+class DocumentTextSource : public TextSource
+{
+public:
+    explicit DocumentTextSource(const KTextEditor::Document* document);
+
+    QString text(const KTextEditor::Range& range) const override;
+    int lineCount() const override;
+    QString line(int line) const override;
+
+private:
+    const KTextEditor::Document* m_document;
+};
+
+
+class FileTextSource : public TextSource
+{
+public:
+    /**
+     * Load the text from a local file. Returns false if it can not be read.
+     */
+    bool load(const QString& path);
+
+    void setText(const QString& text);
+
+    /**
+     * Replace the text in the range, for following the edits of a document
+     * without reloading it.
+     */
+    void replace(const KTextEditor::Range& range, const QString& text);
+
+    QString text(const KTextEditor::Range& range) const override;
+    int lineCount() const override;
+    QString line(int line) const override;
+
+private:
+    QStringList m_lines;
+};
+
+
+/**
+ * Reads the text of ranges in document order, fetching every line from the
+ * source only once.
+ *
+ * The start of every range must not precede the start of the previous one,
+ * lines before it are dropped.
+ */
+class TextStream
+{
+public:
+    explicit TextStream(const TextSource& source);
+
+    QString text(const KTextEditor::Range& range);
+
+private:
+    const TextSource& m_source;
+    const int m_lineCount;
+
+    int m_firstLine = 0;
+    QStringList m_lines; // Lines from m_firstLine on
+};
+
+#endif // TEXTSOURCE_H
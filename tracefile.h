@@ -0,0 +1,51 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <QtGlobal>
+
+
+/**
+ * Format of the trace files written by TraceRecorder and read by
+ * TraceReplayer.
+ *
+ * A QDataStream with a header (magic, version) followed by events. Every
+ * event starts with its type (quint8) and the time since the start of the
+ * recording in milliseconds (quint32). Files are referred to by small ids
+ * introduced by UrlEvent.
+ */
+namespace TraceFile {
+
+constexpr quint32 MAGIC = 0x4b534954; // "KSIT"
+constexpr quint16 VERSION = 1;
+
+enum EventType : quint8 {
+    UrlEvent,         // quint16 id, QString url
+    SnapshotEvent,    // quint16 id, QString text
+    InsertEvent,      // quint16 id, qint32 line, qint32 column, QString text
+    RemoveEvent,      // quint16 id, qint32 startLine, qint32 startColumn, qint32 endLine, qint32 endColumn
+    UpdateReadyEvent, // quint16 id
+    ScrollEvent,      // quint16 id, qint32 firstLine, qint32 lastLine
+};
+
+}
+
+#endif // TRACEFILE_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <language/duchain/duchain.h>
+#include <language/duchain/topducontext.h>
+#include <serialization/indexedstring.h>
+
+#include <KTextEditor/Document>
+#include <KTextEditor/View>
+
+#include "tracerecorder.h"
+
+#include <debug.h>
+
+
+using namespace KDevelop;
+
+
+TraceRecorder::TraceRecorder(QObject* parent)
+    : QObject(parent)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+bool TraceRecorder::start(const QString& path)
+{
+    stop();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCDebug(KDEV_SOURCEINFO) << "Failed to open trace file" << path << m_file.errorString();
+        return false;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_5_6);
+    m_stream << TraceFile::MAGIC << TraceFile::VERSION;
+    m_clock.start();
+
+    connect(DUChain::self(), &DUChain::updateReady, this, &TraceRecorder::updateReady);
+
+    qCDebug(KDEV_SOURCEINFO) << "Recording trace to" << path;
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    if (!isRecording()) return;
+
+    disconnect(DUChain::self(), &DUChain::updateReady, this, &TraceRecorder::updateReady);
+    for (auto *document : m_documents) {
+        disconnect(document, nullptr, this, nullptr);
+        for (auto *view : document->views()) {
+            disconnect(view, nullptr, this, nullptr);
+        }
+    }
+    m_documents.clear();
+    m_urlIds.clear();
+
+    m_stream.setDevice(nullptr);
+    m_file.close();
+}
+
+bool TraceRecorder::isRecording() const
+{
+    return m_file.isOpen();
+}
+
+void TraceRecorder::addDocument(KTextEditor::Document* document)
+{
+    if (!isRecording() || m_documents.contains(document)) return;
+
+    m_documents.append(document);
+
+    const quint16 id = urlId(document->url());
+    writeEvent(TraceFile::SnapshotEvent);
+    m_stream << id << document->text();
+
+    connect(document, &KTextEditor::Document::textInserted, this, &TraceRecorder::textInserted);
+    connect(document, &KTextEditor::Document::textRemoved, this, &TraceRecorder::textRemoved);
+    connect(document, &KTextEditor::Document::viewCreated, this, &TraceRecorder::viewCreated);
+    for (auto *view : document->views()) {
+        viewCreated(document, view);
+    }
+}
+
+void TraceRecorder::removeDocument(KTextEditor::Document* document)
+{
+    if (!m_documents.removeOne(document)) return;
+
+    disconnect(document, nullptr, this, nullptr);
+    for (auto *view : document->views()) {
+        disconnect(view, nullptr, this, nullptr);
+    }
+}
+
+void TraceRecorder::updateReady(const IndexedString& url, const ReferencedTopDUContext& /*topContext*/)
+{
+    // Updates of files that are not open trigger rebuilds too, so they are recorded as well
+    const quint16 id = urlId(url.toUrl());
+    writeEvent(TraceFile::UpdateReadyEvent);
+    m_stream << id;
+}
+
+void TraceRecorder::textInserted(KTextEditor::Document* document, const KTextEditor::Cursor& position, const QString& text)
+{
+    const quint16 id = urlId(document->url());
+    writeEvent(TraceFile::InsertEvent);
+    m_stream << id << qint32(position.line()) << qint32(position.column()) << text;
+}
+
+void TraceRecorder::textRemoved(KTextEditor::Document* document, const KTextEditor::Range& range, const QString& /*text*/)
+{
+    const quint16 id = urlId(document->url());
+    writeEvent(TraceFile::RemoveEvent);
+    m_stream << id << qint32(range.start().line()) << qint32(range.start().column())
+                   << qint32(range.end().line()) << qint32(range.end().column());
+}
+
+void TraceRecorder::viewCreated(KTextEditor::Document* /*document*/, KTextEditor::View* view)
+{
+    connect(view, &KTextEditor::View::verticalScrollPositionChanged, this, &TraceRecorder::scrolled);
+    scrolled(view);
+}
+
+void TraceRecorder::scrolled(KTextEditor::View* view)
+{
+    const quint16 id = urlId(view->document()->url());
+    writeEvent(TraceFile::ScrollEvent);
+    m_stream << id << qint32(view->firstDisplayedLine()) << qint32(view->lastDisplayedLine());
+}
+
+void TraceRecorder::writeEvent(TraceFile::EventType type)
+{
+    m_stream << quint8(type) << quint32(m_clock.elapsed());
+}
+
+quint16 TraceRecorder::urlId(const QUrl& url)
+{
+    auto iter = m_urlIds.constFind(url);
+    if (iter != m_urlIds.constEnd()) {
+        return *iter;
+    }
+
+    const quint16 id = m_urlIds.size();
+    m_urlIds.insert(url, id);
+
+    writeEvent(TraceFile::UrlEvent);
+    m_stream << id << url.toString();
+
+    return id;
+}
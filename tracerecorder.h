@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QUrl>
+
+#include "tracefile.h"
+
+
+namespace KDevelop {
+class IndexedString;
+class ReferencedTopDUContext;
+}
+
+namespace KTextEditor {
+class Cursor;
+class Document;
+class Range;
+class View;
+}
+
+
+/**
+ * Records the events that drive the note providers into a trace file:
+ * DUChain updates, edits and scrolling of the documents, together with a
+ * snapshot of every document when it starts being recorded.
+ *
+ * The trace can be attached to a bug report and replayed with
+ * TraceReplayer.
+ */
+class TraceRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TraceRecorder(QObject* parent = nullptr);
+    ~TraceRecorder() override;
+
+    bool start(const QString& path);
+    void stop();
+    bool isRecording() const;
+
+    /**
+     * Start recording the document, ignored while not recording.
+     */
+    void addDocument(KTextEditor::Document* document);
+    void removeDocument(KTextEditor::Document* document);
+
+private Q_SLOTS:
+    void updateReady(const KDevelop::IndexedString& url, const KDevelop::ReferencedTopDUContext& topContext);
+    void textInserted(KTextEditor::Document* document, const KTextEditor::Cursor& position, const QString& text);
+    void textRemoved(KTextEditor::Document* document, const KTextEditor::Range& range, const QString& text);
+    void viewCreated(KTextEditor::Document* document, KTextEditor::View* view);
+    void scrolled(KTextEditor::View* view);
+
+private:
+    void writeEvent(TraceFile::EventType type);
+    quint16 urlId(const QUrl& url);
+
+private:
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_clock;
+
+    QHash<QUrl, quint16> m_urlIds;
+    QList<KTextEditor::Document*> m_documents;
+};
+
+#endif // TRACERECORDER_H
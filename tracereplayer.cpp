@@ -0,0 +1,286 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QDataStream>
+#include <QFile>
+#include <QStringList>
+
+#include <interfaces/icore.h>
+#include <interfaces/ilanguagecontroller.h>
+#include <language/backgroundparser/backgroundparser.h>
+#include <language/duchain/duchain.h>
+#include <language/duchain/topducontext.h>
+#include <serialization/indexedstring.h>
+
+#include <KLocalizedString>
+#include <KTextEditor/Document>
+#include <KTextEditor/Editor>
+
+#include "tracereplayer.h"
+#include "notecache.h"
+#include "sourceinfoinlinenoteprovider.h"
+#include "typestringcache.h"
+
+#include <debug.h>
+
+
+using namespace KDevelop;
+
+
+constexpr int TraceReplayer::POLL_INTERVAL_MS;
+constexpr int TraceReplayer::UPDATE_TIMEOUT_MS;
+
+TraceReplayer::TraceReplayer(QSharedPointer<SourceInfoConfig> config, QObject* parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_typeStrings(QSharedPointer<TypeStringCache>::create())
+    , m_noteCache(QSharedPointer<NoteCache>::create(size_t(config->noteCacheBudgetMiB) * 1024 * 1024))
+{
+    m_stepTimer.setSingleShot(true);
+    connect(&m_stepTimer, &QTimer::timeout, this, &TraceReplayer::nextEvent);
+
+    // Connected before any provider exists, so the reparse is known to be done before the providers react to it
+    connect(DUChain::self(), &DUChain::updateReady, this, &TraceReplayer::updateReady);
+}
+
+TraceReplayer::~TraceReplayer()
+{
+    for (const auto &replayed : m_documents) {
+        delete replayed.provider;
+    }
+}
+
+bool TraceReplayer::load(const QString& path, QString* error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic;
+    quint16 version;
+    stream >> magic >> version;
+    if (magic != TraceFile::MAGIC || version != TraceFile::VERSION) {
+        *error = i18n("Not a trace file or unsupported version");
+        return false;
+    }
+
+    while (!stream.atEnd() && stream.status() == QDataStream::Ok) {
+        Event event;
+        quint8 type;
+        qint32 line, column, endLine, endColumn;
+
+        stream >> type >> event.time >> event.id;
+        event.type = TraceFile::EventType(type);
+
+        switch (event.type) {
+        case TraceFile::UrlEvent:
+        case TraceFile::SnapshotEvent:
+            stream >> event.text;
+            break;
+        case TraceFile::InsertEvent:
+            stream >> line >> column >> event.text;
+            event.range = KTextEditor::Range(line, column, line, column);
+            break;
+        case TraceFile::RemoveEvent:
+            stream >> line >> column >> endLine >> endColumn;
+            event.range = KTextEditor::Range(line, column, endLine, endColumn);
+            break;
+        case TraceFile::UpdateReadyEvent:
+            break;
+        case TraceFile::ScrollEvent:
+            stream >> line >> endLine;
+            event.range = KTextEditor::Range(line, 0, endLine, 0);
+            break;
+        default:
+            *error = i18n("Unknown event type %1", type);
+            return false;
+        }
+
+        m_events.append(event);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        *error = i18n("The trace file is truncated");
+        return false;
+    }
+
+    return true;
+}
+
+void TraceReplayer::start()
+{
+    qCDebug(KDEV_SOURCEINFO) << "Replaying" << m_events.size() << "events in" << m_directory.path();
+
+    m_clock.start();
+    m_stepTimer.start(0);
+}
+
+void TraceReplayer::nextEvent()
+{
+    if (isBusy()) {
+        if (!m_awaitedUpdate.isEmpty() && m_awaitedSince.elapsed() > UPDATE_TIMEOUT_MS) {
+            qCDebug(KDEV_SOURCEINFO) << "Timed out waiting for reparse of" << m_awaitedUpdate;
+            m_timedOutUpdates++;
+            m_awaitedUpdate.clear();
+        } else {
+            m_stepTimer.start(POLL_INTERVAL_MS);
+            return;
+        }
+    }
+
+    if (m_nextEvent >= m_events.size()) {
+        finish();
+        return;
+    }
+
+    replay(m_events.at(m_nextEvent++));
+    m_stepTimer.start(0);
+}
+
+void TraceReplayer::updateReady(const IndexedString& url, const ReferencedTopDUContext& /*topContext*/)
+{
+    if (url.toUrl() == m_awaitedUpdate) {
+        m_awaitedUpdate.clear();
+    }
+}
+
+void TraceReplayer::rebuildFinished(KTextEditor::Document* document, qint64 latencyUs, bool fromCache)
+{
+    for (auto &replayed : m_documents) {
+        if (replayed.document != document) continue;
+
+        replayed.rebuilds++;
+        if (fromCache) replayed.cacheHits++;
+        replayed.totalLatencyUs += latencyUs;
+        replayed.maxLatencyUs = qMax(replayed.maxLatencyUs, latencyUs);
+    }
+}
+
+bool TraceReplayer::isBusy() const
+{
+    if (!m_awaitedUpdate.isEmpty()) return true;
+
+    for (const auto &replayed : m_documents) {
+        if (replayed.provider->isRebuilding()) return true;
+    }
+    return false;
+}
+
+void TraceReplayer::replay(const Event& event)
+{
+    if (event.type == TraceFile::UrlEvent) {
+        m_urls.insert(event.id, QUrl(event.text));
+        return;
+    }
+
+    if (event.type == TraceFile::SnapshotEvent && !m_documents.contains(event.id)) {
+        openDocument(event.id, event.text);
+        return;
+    }
+
+    auto iter = m_documents.find(event.id);
+    if (iter == m_documents.end()) {
+        // Only updates of files that were not open can get here
+        m_skippedUpdates++;
+        return;
+    }
+    ReplayedDocument &replayed = *iter;
+
+    switch (event.type) {
+    case TraceFile::SnapshotEvent:
+        replayed.document->setText(event.text);
+        break;
+    case TraceFile::InsertEvent:
+        replayed.document->insertText(event.range.start(), event.text);
+        break;
+    case TraceFile::RemoveEvent:
+        replayed.document->removeText(event.range);
+        break;
+    case TraceFile::ScrollEvent:
+        replayed.provider->setVisibleLinesOverride(event.range);
+        break;
+    case TraceFile::UpdateReadyEvent:
+        // The parser reads the file from the disk, documents that are not open in KDevelop are not taken from the editor
+        replayed.document->documentSave();
+        m_awaitedUpdate = replayed.document->url();
+        m_awaitedSince.start();
+        ICore::self()->languageController()->backgroundParser()->addDocument(IndexedString(m_awaitedUpdate),
+                                                                             TopDUContext::AllDeclarationsContextsAndUses,
+                                                                             BackgroundParser::BestPriority);
+        break;
+    case TraceFile::UrlEvent:
+        break;
+    }
+}
+
+void TraceReplayer::openDocument(quint16 id, const QString& text)
+{
+    const QUrl originalUrl = m_urls.value(id);
+
+    // Keep the file name, the language support is chosen by the extension
+    const QString path = m_directory.filePath(QString::number(id) + QLatin1Char('-') + originalUrl.fileName());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(text.toUtf8()) < 0) {
+        qCDebug(KDEV_SOURCEINFO) << "Failed to write snapshot of" << originalUrl << "to" << path;
+        return;
+    }
+    file.close();
+
+    ReplayedDocument replayed;
+    replayed.originalUrl = originalUrl;
+    replayed.document = KTextEditor::Editor::instance()->createDocument(this);
+    replayed.document->openUrl(QUrl::fromLocalFile(path));
+    replayed.provider = new SourceInfoInlineNoteProvider(m_config, m_typeStrings, m_noteCache, nullptr, replayed.document);
+    connect(replayed.provider, &SourceInfoInlineNoteProvider::rebuildFinished, this, &TraceReplayer::rebuildFinished);
+
+    m_documents.insert(id, replayed);
+}
+
+void TraceReplayer::finish()
+{
+    QStringList report;
+    report.append(i18n("Replayed %1 events in %2 ms", m_events.size(), m_clock.elapsed()));
+
+    for (const auto &replayed : m_documents) {
+        const qint64 averageLatencyUs = replayed.rebuilds ? replayed.totalLatencyUs / replayed.rebuilds : 0;
+        report.append(i18n("%1: %2 rebuilds (%3 from cache), latency average %4 ms, maximum %5 ms, %6 notes",
+                           replayed.originalUrl.fileName(),
+                           replayed.rebuilds,
+                           replayed.cacheHits,
+                           QString::number(averageLatencyUs / 1000.0, 'f', 1),
+                           QString::number(replayed.maxLatencyUs / 1000.0, 'f', 1),
+                           replayed.provider->noteCount()));
+    }
+
+    if (m_skippedUpdates) {
+        report.append(i18n("Skipped %1 updates of files without snapshot", m_skippedUpdates));
+    }
+    if (m_timedOutUpdates) {
+        report.append(i18n("%1 reparses timed out", m_timedOutUpdates));
+    }
+
+    const QString text = report.join(QLatin1Char('\n'));
+    qCDebug(KDEV_SOURCEINFO).noquote() << text;
+    emit finished(text);
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TRACEREPLAYER_H
+#define TRACEREPLAYER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QUrl>
+#include <QVector>
+
+#include <KTextEditor/Range>
+
+#include "tracefile.h"
+
+
+namespace KDevelop {
+class IndexedString;
+class ReferencedTopDUContext;
+}
+
+namespace KTextEditor {
+class Document;
+}
+
+class NoteCache;
+class SourceInfoConfig;
+class SourceInfoInlineNoteProvider;
+class TypeStringCache;
+
+
+/**
+ * Drives note providers through the events of a trace recorded by
+ * TraceRecorder and reports how many rebuilds happened, how long they took
+ * and how many notes were shown at the end.
+ *
+ * The documents are recreated from their snapshots in a temporary directory
+ * and opened without views. Every recorded DUChain update of a document
+ * becomes a reparse of its replayed copy and the replay waits for it and
+ * for the resulting rebuild before continuing, so the sequence is the same
+ * no matter how fast the machine is. Updates of files without a snapshot
+ * are not replayed.
+ *
+ * Used from the tool view and by the kdevsourceinfo-replay command line
+ * tool, which replays a trace without the IDE, for bisecting.
+ */
+class TraceReplayer : public QObject
+{
+    Q_OBJECT
+
+    // How often it is checked whether the providers finished rebuilding
+    static constexpr int POLL_INTERVAL_MS = 1;
+
+    // Give up waiting for a reparse after this time
+    static constexpr int UPDATE_TIMEOUT_MS = 60000;
+
+public:
+    explicit TraceReplayer(QSharedPointer<SourceInfoConfig> config, QObject* parent = nullptr);
+    ~TraceReplayer() override;
+
+    bool load(const QString& path, QString* error);
+    void start();
+
+Q_SIGNALS:
+    void finished(const QString& report);
+
+private Q_SLOTS:
+    void nextEvent();
+    void updateReady(const KDevelop::IndexedString& url, const KDevelop::ReferencedTopDUContext& topContext);
+    void rebuildFinished(KTextEditor::Document* document, qint64 latencyUs, bool fromCache);
+
+private:
+    struct Event {
+        TraceFile::EventType type;
+        quint32 time;
+        quint16 id;
+        QString text;
+        KTextEditor::Range range;
+    };
+
+    struct ReplayedDocument {
+        QUrl originalUrl;
+        KTextEditor::Document* document = nullptr;
+        SourceInfoInlineNoteProvider* provider = nullptr;
+
+        int rebuilds = 0;
+        int cacheHits = 0;
+        qint64 totalLatencyUs = 0;
+        qint64 maxLatencyUs = 0;
+    };
+
+    bool isBusy() const;
+    void replay(const Event& event);
+    void openDocument(quint16 id, const QString& text);
+    void finish();
+
+private:
+    QSharedPointer<SourceInfoConfig> m_config;
+    QSharedPointer<TypeStringCache> m_typeStrings;
+    QSharedPointer<NoteCache> m_noteCache;
+
+    QVector<Event> m_events;
+    int m_nextEvent = 0;
+
+    QHash<quint16, QUrl> m_urls;
+    QHash<quint16, ReplayedDocument> m_documents;
+    QTemporaryDir m_directory;
+
+    QUrl m_awaitedUpdate; // Replayed url whose reparse is in progress
+    QElapsedTimer m_awaitedSince;
+    int m_skippedUpdates = 0;
+    int m_timedOutUpdates = 0;
+
+    QTimer m_stepTimer;
+    QElapsedTimer m_clock;
+};
+
+#endif // TRACEREPLAYER_H
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <QMutexLocker>
+#include <QStringList>
+#include <QVector>
+
+#include <language/duchain/types/abstracttype.h>
+#include <language/duchain/types/indexedtype.h>
+
+#include "typestringcache.h"
+
+
+using namespace KDevelop;
+
+
+namespace {
+
+struct DefaultArgumentRule {
+    const char* name;
+    int firstDefault;
+    QVector<const char*> defaults; // %1 and %2 stand for the first two template arguments
+};
+
+const QVector<DefaultArgumentRule>& defaultArgumentRules()
+{
+    static const QVector<DefaultArgumentRule> rules = {
+        { "std::vector",             1, { "std::allocator<%1>" } },
+        { "std::deque",              1, { "std::allocator<%1>" } },
+        { "std::list",               1, { "std::allocator<%1>" } },
+        { "std::forward_list",       1, { "std::allocator<%1>" } },
+        { "std::set",                1, { "std::less<%1>", "std::allocator<%1>" } },
+        { "std::multiset",           1, { "std::less<%1>", "std::allocator<%1>" } },
+        { "std::map",                2, { "std::less<%1>", "std::allocator<std::pair<const %1, %2>>" } },
+        { "std::multimap",           2, { "std::less<%1>", "std::allocator<std::pair<const %1, %2>>" } },
+        { "std::unordered_set",      1, { "std::hash<%1>", "std::equal_to<%1>", "std::allocator<%1>" } },
+        { "std::unordered_multiset", 1, { "std::hash<%1>", "std::equal_to<%1>", "std::allocator<%1>" } },
+        { "std::unordered_map",      2, { "std::hash<%1>", "std::equal_to<%1>", "std::allocator<std::pair<const %1, %2>>" } },
+        { "std::unordered_multimap", 2, { "std::hash<%1>", "std::equal_to<%1>", "std::allocator<std::pair<const %1, %2>>" } },
+        { "std::basic_string",       1, { "std::char_traits<%1>", "std::allocator<%1>" } },
+        { "std::unique_ptr",         1, { "std::default_delete<%1>" } },
+        { "std::stack",              1, { "std::deque<%1>" } },
+        { "std::queue",              1, { "std::deque<%1>" } },
+        { "std::priority_queue",     1, { "std::vector<%1>", "std::less<%1>" } },
+    };
+    return rules;
+}
+
+struct RenderedType {
+    QString full;  // With default arguments collapsed, used for comparing against the rules
+    QString shown; // Additionally with the deep nesting elided
+};
+
+QString withoutSpaces(const QString& text)
+{
+    QString result;
+    result.reserve(text.size());
+    for (const QChar c : text) {
+        if (!c.isSpace()) result += c;
+    }
+    return result;
+}
+
+int qualifiedNameLength(const QString& text)
+{
+    int i = text.size();
+    while (i > 0 && (text.at(i - 1).isLetterOrNumber() || text.at(i - 1) == '_' || text.at(i - 1) == ':')) {
+        i--;
+    }
+    return text.size() - i;
+}
+
+void dropDefaultArguments(const QString& name, QVector<RenderedType>& arguments)
+{
+    for (const auto& rule : defaultArgumentRules()) {
+        if (name != QLatin1String(rule.name)) continue;
+        if (arguments.size() <= rule.firstDefault) return;
+
+        const QString first = arguments[0].full;
+        const QString second = arguments.size() > 1 ? arguments[1].full : QString();
+
+        for (int i = arguments.size() - 1; i >= rule.firstDefault; i--) {
+            const int ruleIndex = i - rule.firstDefault;
+            if (ruleIndex >= rule.defaults.size()) return;
+
+            const QString defaultValue = QString::fromLatin1(rule.defaults[ruleIndex]).arg(first, second);
+            if (withoutSpaces(arguments[i].full) != withoutSpaces(defaultValue)) return;
+
+            arguments.removeLast();
+        }
+        return;
+    }
+}
+
+QString stringAlias(const QString& name, const QVector<RenderedType>& arguments)
+{
+    if (name != QLatin1String("std::basic_string") || arguments.size() != 1) return QString();
+
+    const QString& character = arguments[0].full;
+    if (character == QLatin1String("char"))     return QStringLiteral("std::string");
+    if (character == QLatin1String("wchar_t"))  return QStringLiteral("std::wstring");
+    if (character == QLatin1String("char16_t")) return QStringLiteral("std::u16string");
+    if (character == QLatin1String("char32_t")) return QStringLiteral("std::u32string");
+    return QString();
+}
+
+QString joinArguments(const QVector<RenderedType>& arguments, bool shown)
+{
+    QStringList parts;
+    for (const auto& argument : arguments) {
+        parts.append(shown ? argument.shown : argument.full);
+    }
+    return parts.join(QStringLiteral(", "));
+}
+
+// Parses one type (or template argument) starting at position i, stops at top level ',' or '>'
+RenderedType renderType(const QString& text, int& i, int depth, int maxDepth)
+{
+    RenderedType result;
+
+    while (i < text.size()) {
+        const QChar c = text.at(i);
+        if (c == ',' || c == '>') break;
+
+        if (c != '<') {
+            result.full += c;
+            result.shown += c;
+            i++;
+            continue;
+        }
+
+        // Template argument list of the name that precedes it
+        i++;
+        QVector<RenderedType> arguments;
+        while (i < text.size()) {
+            RenderedType argument = renderType(text, i, depth + 1, maxDepth);
+            argument.full = argument.full.trimmed();
+            argument.shown = argument.shown.trimmed();
+            arguments.append(argument);
+
+            if (i < text.size() && text.at(i) == ',') {
+                i++;
+                continue;
+            }
+            if (i < text.size() && text.at(i) == '>') {
+                i++;
+            }
+            break;
+        }
+
+        const int nameLength = qualifiedNameLength(result.full);
+        const QString name = result.full.right(nameLength);
+        result.full.chop(nameLength);
+        result.shown.chop(nameLength);
+
+        dropDefaultArguments(name, arguments);
+
+        const QString alias = stringAlias(name, arguments);
+        if (!alias.isEmpty()) {
+            result.full += alias;
+            result.shown += alias;
+            continue;
+        }
+
+        result.full += name + '<' + joinArguments(arguments, false) + '>';
+        if (maxDepth > 0 && depth >= maxDepth) {
+            result.shown += name + '<' + QChar(0x2026) + '>';
+        } else {
+            result.shown += name + '<' + joinArguments(arguments, true) + '>';
+        }
+    }
+
+    return result;
+}
+
+}
+
+
+TypeStringCache::Entry TypeStringCache::lookup(const IndexedType& type, bool abbreviate, int maxDepth)
+{
+    Shard &shard = m_shards[type.index() % SHARD_COUNT];
+
+    {
+        QMutexLocker lock(&shard.mutex);
+
+        if (abbreviate != shard.abbreviate || maxDepth != shard.maxDepth) {
+            shard.entries.clear();
+            shard.abbreviate = abbreviate;
+            shard.maxDepth = maxDepth;
+        }
+
+        auto iter = shard.entries.constFind(type.index());
+        if (iter != shard.entries.constEnd()) {
+            return *iter;
+        }
+    }
+
+    // Two threads may convert the same type at once, they get the same result
+    Entry entry;
+    if (const AbstractType::Ptr abstractType = type.abstractType()) {
+        entry.full = abstractType->toString();
+        entry.abbreviated = abbreviate ? abbreviateType(entry.full, maxDepth) : entry.full;
+        entry.sizeOf = abstractType->sizeOf();
+        entry.alignOf = abstractType->alignOf();
+    }
+
+    QMutexLocker lock(&shard.mutex);
+
+    // Someone else may have looked up with other settings in the meantime
+    if (abbreviate == shard.abbreviate && maxDepth == shard.maxDepth) {
+        if (shard.entries.size() >= MAX_ENTRIES / SHARD_COUNT) {
+            shard.entries.clear();
+        }
+        shard.entries.insert(type.index(), entry);
+    }
+
+    return entry;
+}
+
+void TypeStringCache::clear()
+{
+    for (Shard &shard : m_shards) {
+        QMutexLocker lock(&shard.mutex);
+        shard.entries.clear();
+    }
+}
+
+QString TypeStringCache::abbreviateType(const QString& type, int maxDepth)
+{
+    QString text = type;
+    text.replace(QLatin1String("std::__1::"), QLatin1String("std::"));
+    text.replace(QLatin1String("std::__cxx11::"), QLatin1String("std::"));
+
+    QString result;
+    int i = 0;
+    while (i < text.size()) {
+        result += renderType(text, i, 0, maxDepth).shown;
+
+        // Unbalanced input, keep the rest as it is
+        if (i < text.size()) {
+            result += text.at(i);
+            i++;
+        }
+    }
+    return result;
+}
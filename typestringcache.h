@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 Michal Srb <michalsrb@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TYPESTRINGCACHE_H
+#define TYPESTRINGCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+
+namespace KDevelop {
+class IndexedType;
+}
+
+
+/**
+ * Memoizes the string representation of types shown in the notes, along
+ * with their size and alignment.
+ *
+ * AbstractType::toString() builds the string recursively, which gets
+ * expensive for deeply nested template types, so every type is converted
+ * only once and then looked up by its IndexedType.
+ *
+ * Thread safe, but must be used with the DUChain read lock held. The
+ * entries are split into shards with separate locks and the conversion runs
+ * without holding any, so that the threads gathering one file in parallel
+ * do not wait for each other.
+ */
+class TypeStringCache
+{
+    static constexpr int MAX_ENTRIES = 10000;
+
+    static constexpr int SHARD_COUNT = 16;
+
+public:
+    struct Entry {
+        QString abbreviated;
+        QString full;
+        qint64 sizeOf = -1;  // In bytes, -1 if the DUChain does not know it
+        qint64 alignOf = -1;
+    };
+
+    /**
+     * Returns the (optionally abbreviated) string, size and alignment for the
+     * given type.
+     *
+     * \param maxDepth template nesting depth beyond which arguments are
+     *                 elided, 0 means unlimited
+     */
+    Entry lookup(const KDevelop::IndexedType& type, bool abbreviate, int maxDepth);
+
+    void clear();
+
+    /**
+     * Abbreviate a type string as produced by AbstractType::toString().
+     *
+     * Collapses default template arguments of the standard containers,
+     * inline namespaces of the standard library implementations and
+     * std::basic_string instantiations, then replaces template arguments
+     * nested deeper than maxDepth with an ellipsis.
+     */
+    static QString abbreviateType(const QString& type, int maxDepth);
+
+private:
+    struct Shard {
+        QMutex mutex;
+        QHash<uint, Entry> entries; // By type index
+
+        bool abbreviate = false;
+        int maxDepth = 0;
+    };
+
+    Shard m_shards[SHARD_COUNT];
+};
+
+#endif // TYPESTRINGCACHE_H